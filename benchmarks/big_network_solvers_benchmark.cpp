@@ -0,0 +1,137 @@
+// Compares the iterative and the direct engines for big EMU networks.
+// Run from the build directory, the models are searched in ../
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "modeller/modeller.h"
+#include "parser/maranas_parser.h"
+#include "parser/open_flux_parser/open_flux_parser.h"
+#include "simulator/generator.h"
+#include "simulator/simulator.h"
+
+using namespace khnum;
+
+namespace {
+const size_t total_points = 10;
+const size_t total_repeats = 20;
+
+Problem CreateProblem(IParser& parser) {
+    parser.Parse();
+
+    Modeller modeller(parser.GetResults());
+    modeller.CalculateInputSubstrateMids();
+    modeller.CreateEmuNetworks();
+    modeller.CreateNullspaceMatrix();
+    modeller.CalculateFluxBounds();
+    modeller.CalculateMeasurementsCount();
+    modeller.CheckModelForErrors();
+    return modeller.GetProblem();
+}
+
+// Random points in the box of the free fluxes bounds,
+// the ones with nonnegative dependent fluxes are preferred
+std::vector<Eigen::VectorXd> CreateFreeFluxes(const Problem& problem) {
+    std::mt19937 generator(42);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    std::vector<Eigen::VectorXd> points;
+    std::vector<Eigen::VectorXd> rejected_points;
+    for (int attempt = 0; attempt < 1000 && points.size() < total_points; ++attempt) {
+        Eigen::VectorXd free_fluxes(problem.nullspace.cols());
+        for (int i = 0; i < free_fluxes.size(); ++i) {
+            free_fluxes(i) = problem.lower_bounds[i] +
+                             uniform(generator) * (problem.upper_bounds[i] - problem.lower_bounds[i]);
+        }
+        const Eigen::VectorXd dependent_fluxes = -problem.nullspace * free_fluxes;
+        if (dependent_fluxes.minCoeff() >= 0.0) {
+            points.push_back(free_fluxes);
+        } else {
+            rejected_points.push_back(free_fluxes);
+        }
+    }
+    for (size_t i = 0; points.size() < total_points && i < rejected_points.size(); ++i) {
+        points.push_back(rejected_points[i]);
+    }
+    return points;
+}
+
+double MaxDifference(const SimulatorResult& lhs, const SimulatorResult& rhs) {
+    double difference = 0.0;
+    for (size_t i = 0; i < lhs.simulated_mids.size(); ++i) {
+        for (size_t mass_shift = 0; mass_shift < lhs.simulated_mids[i].mid.size(); ++mass_shift) {
+            difference = std::max(difference, std::abs(lhs.simulated_mids[i].mid[mass_shift] -
+                                                       rhs.simulated_mids[i].mid[mass_shift]));
+        }
+    }
+    for (size_t flux = 0; flux < lhs.diff_results.size(); ++flux) {
+        for (size_t i = 0; i < lhs.diff_results[flux].size(); ++i) {
+            const Mid& lhs_mid = lhs.diff_results[flux][i].mid;
+            const Mid& rhs_mid = rhs.diff_results[flux][i].mid;
+            for (size_t mass_shift = 0; mass_shift < lhs_mid.size(); ++mass_shift) {
+                difference = std::max(difference, std::abs(lhs_mid[mass_shift] - rhs_mid[mass_shift]));
+            }
+        }
+    }
+    return difference;
+}
+
+// Average time of one CalculateMids call in milliseconds
+double MeasureTime(Simulator& simulator, const std::vector<Eigen::VectorXd>& points, bool calculate_jacobian) {
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t repeat = 0; repeat < total_repeats; ++repeat) {
+        for (const Eigen::VectorXd& free_fluxes : points) {
+            simulator.CalculateMids(free_fluxes, calculate_jacobian);
+        }
+    }
+    const auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count() / (total_repeats * points.size());
+}
+
+void RunBenchmark(const std::string& name, IParser& parser) {
+    std::cout << name << std::endl;
+    try {
+        Problem problem = CreateProblem(parser);
+        const std::vector<Eigen::VectorXd> points = CreateFreeFluxes(problem);
+
+        problem.simulator_parameters_.big_network_solver = BigNetworkSolver::iterative;
+        SimulatorGenerator iterative_generator(problem.simulator_parameters_);
+        Simulator iterative_simulator = iterative_generator.Generate();
+
+        problem.simulator_parameters_.big_network_solver = BigNetworkSolver::direct;
+        SimulatorGenerator direct_generator(problem.simulator_parameters_);
+        Simulator direct_simulator = direct_generator.Generate();
+
+        double difference = 0.0;
+        for (const Eigen::VectorXd& free_fluxes : points) {
+            const SimulatorResult iterative_result = iterative_simulator.CalculateMids(free_fluxes, true);
+            const SimulatorResult& direct_result = direct_simulator.CalculateMids(free_fluxes, true);
+            difference = std::max(difference, MaxDifference(iterative_result, direct_result));
+        }
+
+        std::cout << "  iterative: mids " << MeasureTime(iterative_simulator, points, false) << " ms, "
+                  << "mids and jacobian " << MeasureTime(iterative_simulator, points, true) << " ms" << std::endl;
+        std::cout << "  direct:    mids " << MeasureTime(direct_simulator, points, false) << " ms, "
+                  << "mids and jacobian " << MeasureTime(direct_simulator, points, true) << " ms" << std::endl;
+        std::cout << "  max difference " << difference << std::endl;
+    } catch (std::exception& error) {
+        std::cout << "  skipped: " << error.what() << std::endl;
+    }
+}
+} // namespace
+
+int main() {
+    ParserOpenFlux big_parser("../modelBig");
+    RunBenchmark("modelBig", big_parser);
+
+    ParserOpenFlux last_parser("../modelLast");
+    RunBenchmark("modelLast", last_parser);
+
+    ParserMaranas maranas_parser("../modelMaranas/");
+    RunBenchmark("modelMaranas", maranas_parser);
+}
@@ -0,0 +1,143 @@
+// Compares the convolution kernels on mids of the lengths met in the models.
+// reference is the allocating branchy loop which operator* used before the vectorized kernel,
+// scalar is the plain loop over the masses of the inline kernel, left to the auto-vectorizer of this translation unit
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "utilities/emu_and_mid.h"
+
+using namespace khnum;
+
+namespace {
+const size_t total_repeats = 200000;
+const size_t chain_length = 3;
+
+Mid ReferenceConvolve(const Mid& lhs, const Mid& rhs) {
+    Mid result(lhs.size() + rhs.size() - 1, 0.0);
+    for (size_t mass_shift = 0; mass_shift < result.size(); ++mass_shift) {
+        for (size_t lhs_mass_shift = 0; lhs_mass_shift < lhs.size(); ++lhs_mass_shift) {
+            if (mass_shift >= lhs_mass_shift) {
+                size_t rhs_mass_shift = mass_shift - lhs_mass_shift;
+                if (rhs_mass_shift < rhs.size()) {
+                    result[mass_shift] += lhs[lhs_mass_shift] * rhs[rhs_mass_shift];
+                }
+            }
+        }
+    }
+    return result;
+}
+
+void ScalarConvolve(const double *lhs, size_t lhs_size, const double *rhs, size_t rhs_size, double *__restrict result) {
+    std::fill(result, result + lhs_size + rhs_size - 1, 0.0);
+    for (size_t lhs_mass_shift = 0; lhs_mass_shift < lhs_size; ++lhs_mass_shift) {
+        const double lhs_mass = lhs[lhs_mass_shift];
+        double *__restrict shifted_result = result + lhs_mass_shift;
+        for (size_t rhs_mass_shift = 0; rhs_mass_shift < rhs_size; ++rhs_mass_shift) {
+            shifted_result[rhs_mass_shift] += lhs_mass * rhs[rhs_mass_shift];
+        }
+    }
+}
+
+Mid CreateMid(size_t size, std::mt19937& generator) {
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    Mid mid(size);
+    for (double& mass : mid) {
+        mass = uniform(generator);
+    }
+    return Normalize(mid);
+}
+
+// Nanoseconds per convolution of the chain
+template <typename Function>
+double MeasureTime(Function convolve_chain) {
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t repeat = 0; repeat < total_repeats; ++repeat) {
+        convolve_chain();
+    }
+    const auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / (total_repeats * (chain_length - 1));
+}
+} // namespace
+
+int main() {
+    std::mt19937 generator(42);
+    std::cout << "length   reference   operator*   scalar   inline   (ns per convolution, chains of "
+              << chain_length << " mids)" << std::endl;
+    for (size_t total_length = 2; total_length <= 25; ++total_length) {
+        // the chain is convolved into a mid of total_length masses
+        std::vector<Mid> chain;
+        size_t remaining_length = total_length + chain_length - 1;
+        for (size_t element = 0; element < chain_length; ++element) {
+            const size_t elements_left = chain_length - element;
+            const size_t length = element + 1 == chain_length ? remaining_length
+                                                              : std::max<size_t>(1, remaining_length / elements_left);
+            chain.push_back(CreateMid(length, generator));
+            remaining_length -= length;
+        }
+
+        Mid reference_result;
+        const double reference_time = MeasureTime([&] {
+            reference_result = chain[0];
+            for (size_t element = 1; element < chain_length; ++element) {
+                reference_result = ReferenceConvolve(reference_result, chain[element]);
+            }
+        });
+
+        Mid operator_result;
+        const double operator_time = MeasureTime([&] {
+            operator_result = chain[0];
+            for (size_t element = 1; element < chain_length; ++element) {
+                operator_result = operator_result * chain[element];
+            }
+        });
+
+        InlineMid scalar_buffers[2];
+        InlineMid* scalar_result = &scalar_buffers[0];
+        const double scalar_time = MeasureTime([&] {
+            InlineMid* mid = &scalar_buffers[0];
+            InlineMid* next_mid = &scalar_buffers[1];
+            std::copy(chain[0].begin(), chain[0].end(), mid->masses.begin());
+            mid->size = chain[0].size();
+            for (size_t element = 1; element < chain_length; ++element) {
+                ScalarConvolve(mid->masses.data(), mid->size, chain[element].data(), chain[element].size(),
+                               next_mid->masses.data());
+                next_mid->size = mid->size + chain[element].size() - 1;
+                std::swap(mid, next_mid);
+            }
+            scalar_result = mid;
+        });
+
+        InlineMid buffers[2];
+        InlineMid* inline_result = &buffers[0];
+        const double inline_time = MeasureTime([&] {
+            InlineMid* mid = &buffers[0];
+            InlineMid* next_mid = &buffers[1];
+            std::copy(chain[0].begin(), chain[0].end(), mid->masses.begin());
+            mid->size = chain[0].size();
+            for (size_t element = 1; element < chain_length; ++element) {
+                Convolve(*mid, chain[element].data(), chain[element].size(), *next_mid);
+                std::swap(mid, next_mid);
+            }
+            inline_result = mid;
+        });
+
+        double difference = 0.0;
+        for (size_t mass_shift = 0; mass_shift < reference_result.size(); ++mass_shift) {
+            difference = std::max({difference,
+                                   std::abs(reference_result[mass_shift] - operator_result[mass_shift]),
+                                   std::abs(reference_result[mass_shift] - scalar_result->masses[mass_shift]),
+                                   std::abs(reference_result[mass_shift] - inline_result->masses[mass_shift])});
+        }
+
+        std::cout << std::setw(6) << total_length << std::setw(12) << std::fixed << std::setprecision(1)
+                  << reference_time << std::setw(12) << operator_time << std::setw(9) << scalar_time
+                  << std::setw(9) << inline_time
+                  << "   max difference " << std::scientific << std::setprecision(1) << difference << std::endl;
+    }
+}
@@ -0,0 +1,103 @@
+// Compares the alglib and the native least squares engines of the fit.
+// Run from the build directory, the models are searched in ../
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "modeller/modeller.h"
+#include "parser/open_flux_parser/open_flux_parser.h"
+#include "simulator/generator.h"
+#include "simulator/simulator.h"
+#include "solver/solver.h"
+#include "solver/start_points.h"
+
+using namespace khnum;
+
+namespace {
+const size_t total_starts = 10;
+
+Problem CreateProblem(IParser& parser) {
+    parser.Parse();
+
+    Modeller modeller(parser.GetResults());
+    modeller.CalculateInputSubstrateMids();
+    modeller.CreateEmuNetworks();
+    modeller.CreateNullspaceMatrix();
+    modeller.CalculateFluxBounds();
+    modeller.CalculateMeasurementsCount();
+    modeller.CheckModelForErrors();
+    return modeller.GetProblem();
+}
+
+double CalculateSSR(Simulator& simulator, const Problem& problem, const alglib::real_1d_array& solution) {
+    Eigen::VectorXd free_fluxes(solution.length());
+    for (int i = 0; i < free_fluxes.size(); ++i) {
+        free_fluxes[i] = solution[i];
+    }
+    const SimulatorResult& result = simulator.CalculateMids(free_fluxes, false);
+    double ssr = 0.0;
+    for (size_t isotope = 0; isotope < result.simulated_mids.size(); ++isotope) {
+        const Measurement& measurement = problem.measurements[isotope];
+        for (size_t mass_shift = 0; mass_shift < measurement.mid.size(); ++mass_shift) {
+            const double residual = (result.simulated_mids[isotope].mid[mass_shift] - measurement.mid[mass_shift]) /
+                                    measurement.errors[mass_shift];
+            ssr += residual * residual;
+        }
+    }
+    return ssr;
+}
+
+void RunEngine(const std::string& name, Problem& problem, LeastSquaresSolver engine,
+               const std::vector<Eigen::VectorXd>& start_points) {
+    problem.least_squares_solver = engine;
+    SimulatorGenerator generator(problem.simulator_parameters_);
+    Simulator simulator = generator.Generate();
+    Solver solver(problem, generator);
+
+    std::vector<double> ssrs;
+    int total_iterations = 0;
+    double total_milliseconds = 0.0;
+    for (const Eigen::VectorXd& start_point : start_points) {
+        const auto start = std::chrono::steady_clock::now();
+        const alglib::real_1d_array solution = solver.SolveFromPoint(start_point);
+        const auto end = std::chrono::steady_clock::now();
+        total_milliseconds += std::chrono::duration<double, std::milli>(end - start).count();
+        total_iterations += solver.GetLastIterationsCount();
+        ssrs.push_back(CalculateSSR(simulator, problem, solution));
+    }
+    std::sort(ssrs.begin(), ssrs.end());
+
+    std::cout << "  " << name << ": " << total_milliseconds / std::max(total_iterations, 1) << " ms per iteration, "
+              << static_cast<double>(total_iterations) / start_points.size() << " iterations per start, "
+              << total_milliseconds / start_points.size() << " ms per start, best SSR " << ssrs.front()
+              << ", median SSR " << ssrs[ssrs.size() / 2] << std::endl;
+}
+
+void RunBenchmark(const std::string& name, IParser& parser) {
+    std::cout << name << std::endl;
+    try {
+        Problem problem = CreateProblem(parser);
+        problem.use_analytic_jacobian = true;
+        const std::vector<Eigen::VectorXd> start_points = GenerateStartPoints(
+            problem.nullspace, problem.lower_bounds, problem.upper_bounds, total_starts,
+            StartPointsMethod::latin_hypercube, 0);
+
+        RunEngine("alglib", problem, LeastSquaresSolver::alglib, start_points);
+        RunEngine("native", problem, LeastSquaresSolver::native, start_points);
+    } catch (std::exception& error) {
+        std::cout << "  skipped: " << error.what() << std::endl;
+    }
+}
+} // namespace
+
+int main() {
+    ParserOpenFlux tca_parser("../modelTca");
+    RunBenchmark("modelTca", tca_parser);
+
+    ParserOpenFlux last_parser("../modelLast");
+    RunBenchmark("modelLast", last_parser);
+}
@@ -0,0 +1,94 @@
+// Measures the stages of the model construction before the fitting starts.
+// Run from the build directory, the models are searched in ../
+
+#include <chrono>
+#include <exception>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "compiled_model/compiled_model.h"
+#include "modeller/create_emu_reactions.h"
+#include "modeller/modeller.h"
+#include "parser/maranas_parser.h"
+#include "parser/open_flux_parser/open_flux_parser.h"
+#include "simulator/generator.h"
+
+using namespace khnum;
+
+namespace {
+const size_t total_repeats = 5;
+
+using Clock = std::chrono::steady_clock;
+
+double GetMilliseconds(Clock::time_point start, Clock::time_point end) {
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+void RunBenchmark(const std::string& name, IParser& parser) {
+    std::cout << name << std::endl;
+    try {
+        const auto parse_start = Clock::now();
+        parser.Parse();
+        const ParserResults parser_results = parser.GetResults();
+        std::cout << "  parse:         " << GetMilliseconds(parse_start, Clock::now()) << " ms" << std::endl;
+
+        double emu_reactions_time = 0.0;
+        double emu_networks_time = 0.0;
+        size_t total_emu_reactions = 0;
+        for (size_t repeat = 0; repeat < total_repeats; ++repeat) {
+            const auto emu_reactions_start = Clock::now();
+            total_emu_reactions = modelling_utills::CreateAllEmuReactions(parser_results.reactions,
+                                                                          parser_results.measured_isotopes).size();
+            emu_reactions_time += GetMilliseconds(emu_reactions_start, Clock::now());
+
+            Modeller modeller(parser_results);
+            modeller.CalculateInputSubstrateMids();
+            const auto emu_networks_start = Clock::now();
+            modeller.CreateEmuNetworks();
+            emu_networks_time += GetMilliseconds(emu_networks_start, Clock::now());
+        }
+        std::cout << "  emu reactions: " << emu_reactions_time / total_repeats << " ms, "
+                  << total_emu_reactions << " reactions" << std::endl;
+        std::cout << "  emu networks:  " << emu_networks_time / total_repeats << " ms" << std::endl;
+
+        Modeller modeller(parser_results);
+        modeller.CalculateInputSubstrateMids();
+        modeller.CreateEmuNetworks();
+        modeller.CreateNullspaceMatrix();
+        modeller.CalculateFluxBounds();
+        modeller.CalculateMeasurementsCount();
+        modeller.CheckModelForErrors();
+        const Problem problem = modeller.GetProblem();
+
+        const auto generator_start = Clock::now();
+        SimulatorGenerator generator(problem.simulator_parameters_);
+        generator.Generate();
+        std::cout << "  generator:     " << GetMilliseconds(generator_start, Clock::now()) << " ms" << std::endl;
+
+        const CompiledModel model{problem, generator.GetNetworkData(), generator.GetMidArenaLayout()};
+        const std::string path = (std::filesystem::temp_directory_path() / compiled_model_file_name).string();
+        SaveCompiledModel(path, model, 0);
+        const auto load_start = Clock::now();
+        SimulatorGenerator loaded_generator = CreateSimulatorGenerator(*LoadCompiledModel(path, 0));
+        loaded_generator.Generate();
+        std::cout << "  load compiled: " << GetMilliseconds(load_start, Clock::now()) << " ms, "
+                  << std::filesystem::file_size(path) << " bytes" << std::endl;
+        std::filesystem::remove(path);
+    } catch (std::exception& error) {
+        std::cout << "  stopped: " << error.what() << std::endl;
+    }
+}
+} // namespace
+
+int main() {
+    ParserOpenFlux big_parser("../modelBig");
+    RunBenchmark("modelBig", big_parser);
+
+    ParserOpenFlux last_parser("../modelLast");
+    RunBenchmark("modelLast", last_parser);
+
+    ParserMaranas maranas_parser("../modelMaranas/");
+    RunBenchmark("modelMaranas", maranas_parser);
+}
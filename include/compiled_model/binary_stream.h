@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "utilities/matrix.h"
+
+
+namespace khnum {
+// Binary encoding in the native byte order, the sizes are stored as 64-bit integers
+class BinaryWriter {
+public:
+    template <typename T>
+    void Write(const T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "only trivially copyable values are written as bytes");
+        WriteBytes(&value, sizeof(T));
+    }
+
+    // the values are written as one block of bytes
+    template <typename T>
+    void WriteArray(const std::vector<T>& values) {
+        static_assert(std::is_trivially_copyable<T>::value, "only trivially copyable values are written as bytes");
+        Write<std::uint64_t>(values.size());
+        WriteBytes(values.data(), values.size() * sizeof(T));
+    }
+
+    void Write(const std::string& value);
+    void Write(const Matrix& matrix);
+    void Write(const Eigen::VectorXd& vector);
+    void Write(const SparseMatrix& matrix);
+
+    void Append(const BinaryWriter& other);
+
+    const std::string& GetBuffer() const;
+
+private:
+    void WriteBytes(const void* data, size_t size);
+
+    std::string buffer_;
+};
+
+// Reads the encoding of BinaryWriter from the memory it doesn't own, throws if the data ends too early
+class BinaryReader {
+public:
+    BinaryReader(const char* data, size_t size);
+
+    template <typename T>
+    T Read() {
+        static_assert(std::is_trivially_copyable<T>::value, "only trivially copyable values are read as bytes");
+        T value;
+        ReadBytes(&value, sizeof(T));
+        return value;
+    }
+
+    template <typename T>
+    std::vector<T> ReadArray() {
+        static_assert(std::is_trivially_copyable<T>::value, "only trivially copyable values are read as bytes");
+        const size_t size = ReadSize(sizeof(T));
+        std::vector<T> values(size);
+        ReadBytes(values.data(), size * sizeof(T));
+        return values;
+    }
+
+    std::string ReadString();
+    Matrix ReadMatrix();
+    Eigen::VectorXd ReadVector();
+    SparseMatrix ReadSparseMatrix();
+
+    // the size of a sequence of elements of element_size bytes, throws if they can't fit into the rest of the data
+    size_t ReadSize(size_t element_size);
+
+    bool IsFinished() const;
+
+private:
+    void ReadBytes(void* destination, size_t size);
+
+    const char* data_;
+    size_t size_;
+    size_t position_ = 0;
+};
+} // namespace khnum
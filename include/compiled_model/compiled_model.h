@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "parser/parser.h"
+#include "simulator/generator.h"
+#include "utilities/problem.h"
+
+
+namespace khnum {
+// version of the binary format, increased on every change of the saved structures
+// or of the way they are computed
+const std::uint32_t compiled_model_version = 6;
+
+// suffix of the compiled model files, such files in the model directory are excluded from the hash of its files
+const std::string compiled_model_file_name = "compiled_model.bin";
+
+// Everything computed before the first simulation: the problem and the network data of its generator.
+// The network data depends on the generator parameters, so they shouldn't be changed after loading
+struct CompiledModel {
+    Problem problem;
+    std::vector<SimulatorNetworkData> networks;
+    MidArenaLayout mid_arena_layout;
+};
+
+// Settings of one run of the solvers. They aren't saved with the model, so a cached model
+// is run with the settings of the current run rather than of the run which compiled it
+struct RunSettings {
+    bool use_analytic_jacobian = false;
+    LeastSquaresSolver least_squares_solver = LeastSquaresSolver::native;
+    size_t jacobian_threads = 1;
+    size_t total_starts = 30;
+    size_t multistart_threads = 1;
+    unsigned int starts_seed = 0;
+    StartPointsMethod start_points_method = StartPointsMethod::latin_hypercube;
+    BigNetworkSolver big_network_solver = BigNetworkSolver::direct;
+    size_t total_threads = 1;
+};
+
+// Runs the parser, the modeller and the generator
+CompiledModel CompileModel(IParser& parser, const RunSettings& settings = {});
+
+void ApplyRunSettings(const RunSettings& settings, CompiledModel& model);
+
+SimulatorGenerator CreateSimulatorGenerator(const CompiledModel& model);
+
+// Hash of the build of the modeller, the names and the contents of the files in the model directory
+std::uint64_t HashModelFiles(const std::string& model_path);
+
+// The emus are saved with the metabolite names, so the model may be loaded by another process.
+// Only the data derived from the model files is saved, the run settings are applied after loading
+void SaveCompiledModel(const std::string& path, const CompiledModel& model, std::uint64_t input_hash);
+
+// Reads the whole file at once. std::nullopt if there is no file or it has another version or input hash,
+// throws if the file is corrupted: it ends early or its indices and sizes don't fit the buffers of the simulator
+std::optional<CompiledModel> LoadCompiledModel(const std::string& path, std::uint64_t input_hash);
+
+// The compiled models of all the model directories may share one cache directory,
+// the file is named after the model directory and the hash of its absolute path
+std::string GetCompiledModelPath(const std::string& model_path, const std::string& cache_directory);
+
+// Loads the compiled model from the cache directory, the model is compiled and saved there if its inputs changed
+// or the saved one is corrupted. The cache directory is created if needed, the model isn't saved if it isn't writable
+CompiledModel LoadOrCompileModel(IParser& parser,
+                                 const std::string& model_path,
+                                 const std::string& cache_directory,
+                                 const RunSettings& settings = {});
+} // namespace khnum
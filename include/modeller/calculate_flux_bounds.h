@@ -9,8 +9,9 @@
 namespace khnum {
 namespace modelling_utills {
 
-void CalculateFluxBounds(std::vector<Reaction>& reactions, const Matrix& stoichiometry_matrix);
-void PrepareLinearProblem(std::vector<Reaction>& reactions, const Matrix& stoichiometry_matrix, glp_prob* linear_problem);
+// The ranges of the fluxes are computed by total_threads threads, each of them solves its own copy of the problem
+void CalculateFluxBounds(std::vector<Reaction>& reactions, const SparseMatrix& stoichiometry_matrix, size_t total_threads = 1);
+void PrepareLinearProblem(std::vector<Reaction>& reactions, const SparseMatrix& stoichiometry_matrix, glp_prob* linear_problem);
 
 }
 }
\ No newline at end of file
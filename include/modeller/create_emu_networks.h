@@ -13,9 +13,5 @@ std::vector<EmuNetwork> CreateEmuNetworks(const std::vector<EmuReaction> &reacti
                                           const std::vector<Emu> &measured_isotopes);
 
 int FindLargestEmuSize(const std::vector<EmuReaction> &reactions);
-
-int GetEmuSize(const Emu &emu);
-
-bool IsEmuAlreadyChecked(const Emu &emu, const std::vector<Emu> &already_checked_emus);
 } // namespace modelling_utills
 } // namespace khnum
\ No newline at end of file
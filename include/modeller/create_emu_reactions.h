@@ -3,40 +3,65 @@
 #include <vector>
 #include <string>
 #include <queue>
-#include <set>
+#include <unordered_map>
 
 #include "utilities/reaction.h"
 #include "utilities/emu.h"
+#include "utilities/emu_index.h"
 
 
 namespace khnum {
 namespace modelling_utills {
+// Occurrence of a metabolite in the right side of a reaction with the sources of its atoms
+struct ProductTransitions {
+    SubstrateCoefficient coefficient;
+    // sources of the i'th atom of the product are transitions[atom_offsets[i]], ..., transitions[atom_offsets[i + 1] - 1]
+    std::vector<size_t> atom_offsets;
+    std::vector<AtomTransition> transitions;
+};
+
+// Reaction producing a metabolite, built once for all emus of the metabolite
+struct SynthesisReaction {
+    const Reaction* reaction;
+    std::vector<int> precursors; // metabolite ids of the left side
+    std::vector<ProductTransitions> products; // every occurrence of the metabolite in the right side
+};
+
+// Synthesis reactions of the metabolites by their ids, in the order of the reactions list
+using SynthesisIndex = std::unordered_map<int, std::vector<SynthesisReaction>>;
+
 // Creates all EMU reactions required for calculation MID of the measured_isotopes
 // Basically, it is a bfs algorithm
 std::vector<EmuReaction> CreateAllEmuReactions(const std::vector<Reaction> &reactions,
                                                const std::vector<Emu> &measured_isotopes);
 
-// Returns every reaction that produce the emu
-std::vector<Reaction> GetSynthesisReactions(const std::vector<Reaction> &reactions,
-                                            const Emu &emu);
+// The reactions must outlive the index
+SynthesisIndex CreateSynthesisIndex(const std::vector<Reaction> &reactions);
+
+// The reaction must outlive the result
+SynthesisReaction CreateSynthesisReaction(const Reaction &reaction, int metabolite);
 
 // Creates set of Emu reactions which are produce the emu
+std::vector<EmuReaction> CreateNewEmuReactions(const SynthesisReaction &reaction,
+                                               const Emu &emu);
+
 std::vector<EmuReaction> CreateNewEmuReactions(const Reaction &reaction,
                                                const Emu &emu);
 
-// Creates one Emu reaction from the reaction
-EmuReaction CreateOneEmuReaction(const Reaction &reaction,
-                                 const Substrate &substrate,
+// Creates one Emu reaction from the occurrence of the emu metabolite in the reaction
+EmuReaction CreateOneEmuReaction(const SynthesisReaction &reaction,
+                                 const ProductTransitions &product,
                                  const Emu &emu);
 
-EmuReaction CreateOneEmuReactionPrev(const Reaction &reaction,
+EmuReaction CreateOneEmuReaction(const Reaction &reaction,
                                  const Substrate &substrate,
                                  const Emu &emu);
 
+// Merges the equal reactions summing their rates
 std::vector<EmuReaction> SelectUniqueEmuReactions(const std::vector<EmuReaction> &emu_reactions);
 
 void AddNewEmusInQueue(std::queue<Emu> *queue,
-                       const std::set<Emu, decltype(&comparator)> &already_checked_emu,
+                       const EmuIndex<bool> &already_checked_emu,
                        const EmuReactionSide &reaction_side);
 } // namespace modelling_utills
-} // namespace khnum
\ No newline at end of file
+} // namespace khnum
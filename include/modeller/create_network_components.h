@@ -6,9 +6,15 @@
 
 namespace khnum {
     namespace modelling_utills {
-        std::vector<EmuNetwork> CreateNetworkComponents(const EmuNetwork &network);
+        // Strongly connected components of an emu network, its emus are connected by the reactions with one precursor
+        struct NetworkComponents {
+            // in topological order: the components producing the precursors of a component go before it
+            std::vector<EmuNetwork> components;
+            // dependencies[i] are the sorted positions of the components producing the precursors of components[i]
+            std::vector<std::vector<int>> dependencies;
+        };
 
-        void dfs1(int v, const EmuNetwork &network, std::vector<char> &visited, std::vector<size_t> &ordered_reactions, const std::vector<Emu> &all_emus);
-        void dfs2(int v, const EmuNetwork &emu_network, std::vector<char> &visited, std::vector<size_t> &component, const std::vector<Emu> &all_emus);
+        // Iterative Tarjan algorithm, linear in the size of the network
+        NetworkComponents CreateNetworkComponents(const EmuNetwork &network);
     }
-}
\ No newline at end of file
+}
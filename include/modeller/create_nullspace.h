@@ -6,10 +6,6 @@
 
 namespace khnum {
 namespace modelling_utills {
-Matrix GetNullspace(const Matrix& original_matrix, std::vector<Reaction> &reactions);
-
-bool ExchangeRowsToMakePivotNotNull(Matrix &matrix, const int column);
-
-int FindNotNullColumn(const Matrix &matrix, const int currentRow);
+Matrix GetNullspace(const SparseMatrix& stoichiometry_matrix, std::vector<Reaction> &reactions);
 } // namespace modelling_utills
-} // namespace khnum
\ No newline at end of file
+} // namespace khnum
@@ -1,11 +1,17 @@
 #pragma once
 
+#include <cstdint>
+
 #include "utilities/problem.h"
 #include "utilities/matrix.h"
 #include "parser/parser_results.h"
 
 
 namespace khnum {
+// identifies the results of the modeller, increased on every change of them,
+// the models compiled by the other versions are compiled again
+const std::uint32_t modeller_version = 1;
+
 class Modeller {
 public:
     Modeller(const ParserResults);
@@ -16,7 +22,8 @@ public:
 
     void CreateNullspaceMatrix();
 
-    void CalculateFluxBounds();
+    // Narrows the default bounds of the free fluxes by the flux variability analysis
+    void CalculateFluxBounds(size_t total_threads = 1);
 
     void CalculateMeasurementsCount();
 
@@ -36,7 +43,7 @@ private:
     std::vector<EmuReaction> all_emu_reactions_;
 
     Matrix nullspace_;
-    Matrix stoichiometry_matrix_;
+    SparseMatrix stoichiometry_matrix_;
     std::vector<EmuAndMid> input_substrate_mids_;
     std::vector<EmuNetwork> emu_networks_;
     std::vector<int> id_to_position_in_depended_fluxes_;
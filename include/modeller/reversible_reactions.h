@@ -0,0 +1,15 @@
+#pragma once
+
+#include <vector>
+
+#include "utilities/problem.h"
+#include "utilities/reaction.h"
+
+
+namespace khnum {
+namespace modelling_utills {
+// Pairs every backward reaction with the forward one with the reversed equation.
+// The forward reaction goes before the backward one in the models, so the nearest preceding one by id is taken
+std::vector<ReversibleReaction> FindReversibleReactions(const std::vector<Reaction>& reactions);
+} // namespace modelling_utills
+} // namespace khnum
@@ -1,7 +1,5 @@
 #pragma once
 
-#define PY_SSIZE_T_CLEAN
-#include <Python.h>
 #include <unordered_map>
 #include "parser/parser.h"
 
@@ -27,7 +25,6 @@ class ParserMaranas : public IParser {
 
   const std::string path_;
   std::unordered_map<std::string, int> substrate_sizes_;
-  Reaction ParseReaction(std::stringstream &stream);
 
   std::vector<Reaction> reactions_;
   std::vector<Emu> measured_isotopes_;
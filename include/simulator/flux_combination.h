@@ -21,21 +21,40 @@ struct SparseElement {
 struct FluxCombination {
     size_t i, j;
     std::vector<FluxAndCoefficient> fluxes;
+    // position of (i, j) in valuePtr() of the compressed pattern matrix, only for big networks
+    int value_position = -1;
 };
 
 
 bool compare(const FluxCombination& lhs, const FluxCombination& rhs);
 
+// Flux matrix as a linear function of the free fluxes:
+// stored values = coefficients * free_fluxes + offset
+// Column v of the coefficients is the derivative of the matrix by the v'th free flux
+struct FluxMatrixOperator {
+    SparseMatrix coefficients;
+    Eigen::VectorXd offset;
+
+    // row and column in the flux matrix of every stored value
+    std::vector<int> rows;
+    std::vector<int> cols;
+};
+
 
 // Yi contains of emus from the mids_Yi_[network][position]
 struct PositionOfSavedEmu {
     int network;
     int position;
+    // place of the mid in the mids arena of the simulator, assigned by the generator
+    int offset = -1;
+    int length = 0;
 };
 
 struct Convolution {
     std::vector<PositionOfSavedEmu> elements;
     int flux_id;
+    // the product of all the elements except the i'th is saved at others_offsets[i] of the network's others buffer
+    std::vector<int> others_offsets;
 };
 
 bool operator==(const Convolution& lhs, const Convolution& rhs);
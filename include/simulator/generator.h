@@ -1,5 +1,6 @@
 #pragma once
 
+#include "utilities/emu_index.h"
 #include "utilities/problem.h"
 #include "simulator/simulator.h"
 
@@ -8,14 +9,24 @@ class SimulatorGenerator {
 public:
     SimulatorGenerator(const GeneratorParameters& parameters);
 
+    // Uses the network data created by another generator with the same parameters, see compiled_model.h
+    SimulatorGenerator(const GeneratorParameters& parameters,
+                       std::vector<SimulatorNetworkData> simulator_network_data,
+                       MidArenaLayout mid_arena_layout);
+
     Simulator Generate() const;
 
+    const std::vector<SimulatorNetworkData>& GetNetworkData() const;
+
+    const MidArenaLayout& GetMidArenaLayout() const;
+
 private:
-    std::vector<NetworkEmu> InitializeInputEmus(const std::vector<EmuAndMid>& input_mids) const;
+    EmuIndex<NetworkEmu> InitializeInputEmus(const std::vector<EmuAndMid>& input_mids) const;
     SimulatorNetworkData FillSimulatorNetworkData(const GeneratorNetworkData& network_data, int network_size) const;
 
     GeneratorParameters parameters_;
 
     std::vector<SimulatorNetworkData> simulator_network_data_;
+    MidArenaLayout mid_arena_layout_;
 };
 }
\ No newline at end of file
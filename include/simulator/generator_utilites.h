@@ -5,6 +5,7 @@
 
 #include "utilities/matrix.h"
 #include "utilities/emu.h"
+#include "utilities/emu_index.h"
 #include "simulator/flux_combination.h"
 #include "simulator/simulation_data.h"
 #include "utilities/measurement.h"
@@ -13,43 +14,70 @@
 namespace khnum {
 namespace generator_utilites {
 void FillEmuLists(const std::vector<EmuReaction>& reactions,
-                  std::vector<NetworkEmu>& all_known_emus,
+                  EmuIndex<NetworkEmu>& all_known_emus,
                   GeneratorNetworkData& network_data,
                   std::vector<std::vector<int>>& usefull_emus);
 
 void CheckAndInsertEmu(const Emu &emu,
-                       std::vector<NetworkEmu>& all_known_emus,
+                       EmuIndex<NetworkEmu>& all_known_emus,
                        GeneratorNetworkData& network_data,
                        std::vector<std::vector<int>>& usefull_emus);
 
 
 Convolution ConvolveReaction(const EmuReaction& reaction,
-                             std::vector<NetworkEmu>& all_known_emus,
+                             EmuIndex<NetworkEmu>& all_known_emus,
                              std::vector<std::vector<int>>& usefull_emus);
 
 void CreateSymbolicMatrices(const std::vector<EmuReaction>& reactions,
                             GeneratorNetworkData& network_data);
 
-int FindUnknownEmuPosition(const Emu &emu,
-                           const std::vector<Emu>& unknown_emus);
+// Positions of the emus in the list, the first one is kept for the repeated emus
+EmuIndex<int> CreatePositionIndex(const std::vector<Emu>& emus);
 
-int FindKnownEmuPosition(const Emu &emu,
-                         const std::vector<Emu>& known_emus);
+// returns -1 if the emu is not in the index
+int FindEmuPosition(const Emu &emu,
+                    const EmuIndex<int>& positions);
 
 void ConvertToSparseMatrix(const std::vector<std::vector<FluxCombination>>& dense_matrix,
                            std::vector<FluxCombination>& sparse_matrix);
 
+// measurement_positions is the position index of the measured emus
 void FillFinalEmu(const std::vector<Measurement>& measured_isotopes,
+                  const EmuIndex<int>& measurement_positions,
                   GeneratorNetworkData& network_data);
 
 void InsertIntoAllKnownEmus(const std::vector<Emu>& unknown_emus,
                             int network_num,
-                            std::vector<NetworkEmu>& all_known_emus);
+                            EmuIndex<NetworkEmu>& all_known_emus);
 
 int FindNetworkSize(const std::vector<EmuReaction>& reactions);
 
-std::vector<Triplet> GenerateDiffFluxMatrix(const std::vector<FluxCombination>& symbolic_matrix,
-                              int rows, int cols, int id, int position, const std::vector<int>& id_to_pos,
-                              const Matrix& nullspace);
+// Builds the compressed pattern of the symbolic matrix and remembers where each value lives in it
+SparseMatrix CreatePatternMatrix(std::vector<FluxCombination>& symbolic_matrix,
+                                 size_t rows, size_t cols);
+
+// Composes the symbolic matrix with the dependence of all fluxes on the free ones:
+// isotopomer balance fluxes are fixed to 1 and depended fluxes are -nullspace * free_fluxes
+FluxMatrixOperator CreateFluxMatrixOperator(const std::vector<FluxCombination>& symbolic_matrix,
+                                            NetworkSize size, size_t rows, size_t cols,
+                                            const std::vector<int>& free_fluxes_id,
+                                            const std::vector<int>& id_to_pos,
+                                            const Matrix& nullspace);
+
+// Networks whose emus are used in Y of the network (directly or in convolutions), sorted
+std::vector<int> FindNetworkDependencies(const std::vector<PositionOfSavedEmu>& Y_data,
+                                         const std::vector<Convolution>& convolutions);
+
+// Free fluxes present in the flux matrices of the network or in diff_free_fluxes of its dependencies
+std::vector<int> FindDiffFreeFluxes(const SimulatorNetworkData& network,
+                                    const std::vector<SimulatorNetworkData>& previous_networks);
+
+// Places the input mids and the usefull emus of the networks into the mids arena
+// and fills the offsets of the emus used in Y and in the convolutions
+MidArenaLayout CreateMidArenaLayout(const std::vector<EmuAndMid>& input_mids,
+                                    std::vector<SimulatorNetworkData>& networks);
+
+// Places the products of the other elements of the network's convolutions, the emus must be in the arena
+void PlaceConvolutionOthers(SimulatorNetworkData& network);
 }
 }
\ No newline at end of file
@@ -1,10 +1,12 @@
 #pragma once
 
+#include <memory>
 #include <vector>
 
 #include "utilities/matrix.h"
 #include "utilities/emu_and_mid.h"
 #include "simulator/flux_combination.h"
+#include "simulator/small_network_solver.h"
 
 namespace khnum {
 
@@ -16,15 +18,12 @@ struct SimulatorResult {
     std::vector<std::vector<EmuAndMid>> diff_results;
 };
 
-struct DerivativeData {
-    Matrix dA_small;
-    Matrix dB_small;
-    SparseMatrix dA_big;
-    SparseMatrix dB_big;
-};
-
 enum class NetworkSize {small, big};
 
+// How A * X = BY is solved for big networks:
+// iterative is BiCGSTAB with incomplete LU, direct is sparse LU with the ordering computed once
+enum class BigNetworkSolver {iterative, direct};
+
 struct SimulatorNetworkData {
     NetworkSize size;
     std::vector<FluxCombination> symbolic_A;
@@ -33,13 +32,77 @@ struct SimulatorNetworkData {
     std::vector<Convolution> convolutions;
     std::vector<int> usefull_emus;
     std::vector<FinalEmu> final_emus;
+    // previous networks whose emus are needed to fill Y, the edges of the networks dependency DAG
+    std::vector<int> dependencies;
+    // free fluxes which may change the network emus: they are in A or B or change the dependencies, sorted.
+    // Derivatives by the other free fluxes are structurally zero
+    std::vector<int> diff_free_fluxes;
+    // the usefull emus are saved one after another to the mids arena, the i'th starts at saved_mids_offset + i * Y_cols
+    size_t saved_mids_offset;
+    // size of the buffer with the products of the other convolution elements
+    size_t convolution_others_size;
     size_t A_rows;
     size_t A_cols;
     size_t B_rows;
     size_t B_cols;
     size_t Y_rows;
     size_t Y_cols;
-    std::vector<DerivativeData> derivatives;
+    // values of A and B are dense column-major storage for small networks and valuePtr() of the patterns for big
+    FluxMatrixOperator A_operator;
+    FluxMatrixOperator B_operator;
+
+    // sparsity patterns of A and B for big networks, the values are filled by the simulator
+    SparseMatrix A_pattern;
+    SparseMatrix B_pattern;
+};
+
+// All the mids passed between the networks live in one contiguous buffer of the simulator:
+// the input mids go first and then the usefull emus of every network.
+// The derivatives by a free flux and the adjoints are stored in buffers of the same layout
+struct MidArenaLayout {
+    std::vector<int> input_offsets;
+    size_t size = 0;
+};
+
+// Buffers of one network, allocated once by the simulator and reused on every call
+// scratch space for the convolutions
+struct ConvolutionBuffers {
+    InlineMid mid_buffer;
+    InlineMid second_mid_buffer;
+    InlineMid third_mid_buffer;
+};
+
+struct NetworkWorkspace {
+    Matrix A;
+    Matrix B;
+    SparseMatrix sparse_A;
+    SparseMatrix sparse_B;
+    std::unique_ptr<ISmallNetworkSolver> small_solver;
+    Matrix Y;
+    Matrix BY;
+    Matrix X;
+
+    // derivatives by the free fluxes of diff_free_fluxes are stacked horizontally to be solved at once,
+    // the free flux at position p occupies columns [p * Y_cols, (p + 1) * Y_cols)
+    Matrix dY;
+    Matrix right_part;
+    Matrix dX;
+
+    // adjoint sweep: X_adjoint is d(loss) / dX, X_multiplier solves A^T * X_multiplier = X_adjoint
+    // and Y_adjoint = B^T * X_multiplier is d(loss) / dY
+    Matrix X_adjoint;
+    Matrix X_multiplier;
+    Matrix Y_adjoint;
+    SparseMatrix sparse_A_transposed;
+    // the k'th value of sparse_A_transposed is the A_transposed_positions[k]'th value of sparse_A
+    std::vector<int> A_transposed_positions;
+
+    // products of the other elements of every convolution, a convolution derivative is then one product per element
+    std::vector<double> convolution_others;
+
+    ConvolutionBuffers buffers;
+    // own buffers of every free fluxes chunk in the parallel jacobian
+    std::vector<ConvolutionBuffers> chunk_buffers;
 };
 
 struct GeneratorNetworkData {
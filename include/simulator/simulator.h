@@ -1,34 +1,117 @@
 #pragma once
 
+#include <atomic>
+#include <memory>
 #include <vector>
 
 #include "utilities/emu_and_mid.h"
 #include "utilities/matrix.h"
+#include "utilities/measurement.h"
 #include "utilities/reaction.h"
+#include "utilities/thread_pool.h"
 #include "simulator/flux_combination.h"
 #include "simulator/simulation_data.h"
 
 
 namespace khnum {
-
-
+using IterativeSolver = Eigen::BiCGSTAB<SparseMatrix, Eigen::IncompleteLUT<SparseMatrix::Scalar>>;
+using DirectSolver = Eigen::SparseLU<SparseMatrix, Eigen::COLAMDOrdering<SparseMatrix::StorageIndex>>;
 
 class Simulator {
 public:
     Simulator(const std::vector<SimulatorNetworkData>& networks,
               const std::vector<EmuAndMid>& input_mids,
-              const size_t total_mids_to_simulate);
+              const MidArenaLayout& mid_arena_layout,
+              const size_t total_mids_to_simulate,
+              BigNetworkSolver big_network_solver = BigNetworkSolver::direct,
+              size_t total_threads = 1);
+
+    // The result lives in the simulator and is overwritten by the next call
+    const SimulatorResult& CalculateMids(const Eigen::VectorXd &free_fluxes, bool calculate_jacobian);
+
+    // Splits the free fluxes into chunks whose derivatives are calculated concurrently
+    void SetJacobianThreads(size_t total_threads);
+
+    // J^T * weights, where J is the jacobian of the simulated mids by the free fluxes
+    // and weights have the layout of SimulatorResult::simulated_mids.
+    // Uses a backward (adjoint) sweep with one transposed solve per network whatever the number of free fluxes.
+    // The result lives in the simulator and is overwritten by the next call
+    const Eigen::VectorXd& CalculateTransposedJacobianProduct(const Eigen::VectorXd &free_fluxes,
+                                                              const std::vector<Mid> &weights);
 
-    SimulatorResult CalculateMids(const std::vector<Flux> &fluxes, bool calculate_jacobian);
+    // Gradient of SSR = sum(((simulated - measured) / error)^2) by the free fluxes,
+    // measurements are in the order of the simulated mids
+    const Eigen::VectorXd& CalculateSSRGradient(const Eigen::VectorXd &free_fluxes,
+                                                const std::vector<Measurement> &measurements);
 
 private:
+    void InitializeWorkspace();
+
+    void CreateThreadPool(size_t total_threads);
+
+    void CalculateNetwork(size_t network_num, const Eigen::VectorXd &free_fluxes, bool calculate_jacobian);
+
+    // Derivatives of the simulated network, the free fluxes chunks are calculated in the thread pool
+    void CalculateNetworkDiff(size_t network_num);
+
+    // Derivatives by the free fluxes at [first_position, end_position) of network.diff_free_fluxes,
+    // the factorization, X and Y are only read, so the ranges can be calculated concurrently
+    void CalculateNetworkDiff(size_t network_num, size_t first_position, size_t end_position,
+                              ConvolutionBuffers &buffers);
+
+    // Simulates the network and schedules the dependent networks which became ready
+    void RunNetworkTask(size_t network_num);
+
+    // Backward sweep over the networks using the state of the last CalculateMids call
+    const Eigen::VectorXd& RunAdjointSweep(const std::vector<Mid> &weights);
+
+    // Fills the stacked right parts of A * dX = dB * Y + B * dY - dA * X
+    // for the free fluxes at [first_position, end_position) of network.diff_free_fluxes
+    template <typename FluxMatrix>
+    void FillDiffRightPart(const SimulatorNetworkData& network, const FluxMatrix& B, NetworkWorkspace& workspace,
+                           size_t first_position, size_t end_position, ConvolutionBuffers& buffers);
+
+    void SaveNewDiffEmus(size_t network_num, size_t first_position, size_t end_position);
+
+    void FactorizeBigNetwork(size_t big_network, const SparseMatrix& A);
+
+    // result_inout contains the initial guess for the iterative solver
+    void SolveBigNetwork(size_t big_network, const Eigen::Ref<const Matrix>& right_part, Eigen::Ref<Matrix> result_inout);
+
     const size_t total_networks_;
     const size_t total_free_fluxes_;
     const size_t total_mids_to_simulate_;
     const std::vector<EmuAndMid> &input_mids_;
+    const MidArenaLayout &mid_arena_layout_;
     const std::vector<SimulatorNetworkData> &networks_;
-    std::vector<Eigen::BiCGSTAB<SparseMatrix, Eigen::IncompleteLUT<SparseMatrix::Scalar>>> solvers_;
+    const BigNetworkSolver big_network_solver_;
+    std::vector<IterativeSolver> solvers_;
+    std::vector<DirectSolver> direct_solvers_;
+    // A^T of big networks for the adjoint sweep, SparseLU can't solve with the transposed factors
+    std::vector<DirectSolver> transposed_solvers_;
+    // position of the network's solver in the solver vectors, -1 for small networks
+    std::vector<int> solver_positions_;
+
+    // networks are scheduled by the dependency DAG only when more than one thread is used
+    std::unique_ptr<ThreadPool> thread_pool_;
+    std::vector<std::vector<size_t>> dependent_networks_;
+    std::vector<std::atomic<size_t>> remaining_dependencies_;
+    const Eigen::VectorXd *current_free_fluxes_ = nullptr;
+    bool current_calculate_jacobian_ = false;
+    size_t jacobian_chunks_ = 1;
 
     std::vector<Matrix> corrections;
+
+    std::vector<NetworkWorkspace> workspaces_;
+    SimulatorResult result_;
+    std::vector<double> sums_;
+    // the mids arena, the input mids are copied once
+    std::vector<double> saved_mids_;
+    // arenas of the derivatives by every free flux one after another, the input mids parts stay zero
+    std::vector<double> saved_diff_mids_;
+    // d(loss) / d(saved mid) in the arena layout for the adjoint sweep
+    std::vector<double> saved_adjoint_mids_;
+    std::vector<Mid> ssr_weights_;
+    Eigen::VectorXd gradient_;
 };
 } // namespace khnum
\ No newline at end of file
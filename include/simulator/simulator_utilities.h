@@ -4,56 +4,97 @@
 
 #include "utilities/matrix.h"
 #include "simulator/flux_combination.h"
+#include "simulator/simulation_data.h"
 
 namespace khnum {
 namespace simulator_utilities {
-void FillSmallFluxMatrix(const std::vector<FluxCombination> &symbolic_matrix,
-                         const std::vector<Flux> &fluxes,
-                         Matrix &matrix_out);
+// values_out is the dense storage of A (or B) for small networks and valuePtr() of the pattern for big ones
+void FillFluxMatrix(const FluxMatrixOperator &flux_operator,
+                    const Eigen::VectorXd &free_fluxes,
+                    double *values_out);
 
-void FillBigFluxMatrix(const std::vector<FluxCombination> &symbolic_matrix,
-                       const std::vector<Flux> &fluxes,
-                       std::vector<Triplet> &triplet_out);
+// result_out += factor * (d matrix / d free_flux) * multiplier
+void AddDiffFluxMatrixProduct(const FluxMatrixOperator &flux_operator,
+                              size_t free_flux,
+                              double factor,
+                              const Matrix &multiplier,
+                              Eigen::Ref<Matrix> result_out);
 
+// mids is the mids arena, the emus are read at their offsets
 void FillYMatrix(const std::vector<PositionOfSavedEmu> &Y_data,
-                 const std::vector<EmuAndMid> &input_mids,
-                 const std::vector<std::vector<Mid>> &saved_mids,
+                 const double *mids,
                  const std::vector<Convolution> &convolutions,
+                 ConvolutionBuffers &buffers,
                  Matrix &Y_out);
 
+// saved_mids_out points to the place of the network in the mids arena
 void SaveNewEmus(const Matrix& X,
                  const std::vector<int>& usefull_emus,
                  const std::vector<FinalEmu>& final_emus,
-                 std::vector<Mid>& saved_mids_out,
+                 double* saved_mids_out,
                  std::vector<EmuAndMid>& result_out,
                  std::vector<double>& sums_out);
 
-void SaveNewDiffEmus(const Matrix& X,
+void SaveNewDiffEmus(const Eigen::Ref<const Matrix>& X,
                      const std::vector<int>& usefull_emus,
                      const std::vector<FinalEmu>& final_emus,
                      const std::vector<EmuAndMid> &result,
                      const std::vector<double>& sums,
-                     std::vector<Mid>& saved_mids_out,
+                     double* saved_mids_out,
                      std::vector<EmuAndMid>& diff_result_out);
 
-Matrix GetCorrectedDiffMid(const Matrix& correction_matrix,
-                           Matrix mid,
-                           const Matrix& diff_mid,
-                           double sum);
+void GetCorrectedDiffMid(const Matrix& correction_matrix,
+                         const Mid& mid,
+                         const Eigen::Ref<const Matrix>& diff_X,
+                         int row,
+                         double sum,
+                         Mid& corrected_diff_mid_out);
 
-Mid ConvolvePartialDiff(const Convolution& convolution,
-                        const std::vector<std::vector<Mid>>& known_d_mids,
-                        const std::vector<EmuAndMid>& input_mids,
-                        const std::vector<std::vector<Mid>>& saved_mids,
-                        size_t mid_size,
-                        size_t diff_position);
+// Convolves the elements one after another in the two buffers and returns the one with the result
+const InlineMid& ConvolveElements(const Convolution& convolution,
+                                  const double* mids,
+                                  ConvolutionBuffers& buffers);
 
+// Fills the products of all the elements but one for every element of the convolutions.
+// They are built from the prefix and the suffix products, so a k-way convolution costs O(k) products
+void FillConvolutionOthers(const std::vector<Convolution>& convolutions,
+                           const double* mids,
+                           ConvolutionBuffers& buffers,
+                           double* others_out);
+
+// known_d_mids is the arena of the derivatives by the free flux,
+// convolution_others are filled by FillConvolutionOthers for the current mids
 void FillDiffYMatrix(const std::vector<PositionOfSavedEmu>& Y_data,
-                     const std::vector<std::vector<Mid>>& known_d_mids,
+                     const double* known_d_mids,
                      const std::vector<Convolution>& convolutions,
-                     const std::vector<EmuAndMid>& input_mids,
-                     const std::vector<std::vector<Mid>>& saved_mids,
-                     Matrix& Y_out);
+                     const double* convolution_others,
+                     ConvolutionBuffers &buffers,
+                     Eigen::Ref<Matrix> Y_out);
+
+// gradient_out(v) += factor * <left, (d matrix / d v'th free flux) * right>, where <, > is the elementwise product sum
+void AddDiffFluxMatrixInnerProducts(const FluxMatrixOperator& flux_operator,
+                                    double factor,
+                                    const Matrix& left,
+                                    const Matrix& right,
+                                    Eigen::VectorXd& gradient_out);
+
+// X_adjoint_out += d(sum of weights * simulated mids) / dX for the final emus of the network
+void AddFinalEmusAdjoint(const std::vector<FinalEmu>& final_emus,
+                         const std::vector<EmuAndMid>& result,
+                         const std::vector<double>& sums,
+                         const std::vector<Mid>& weights,
+                         Matrix& X_adjoint_out);
 
+// X_adjoint_out += adjoints of the emus saved for the next networks
+void AddSavedEmusAdjoint(const std::vector<int>& usefull_emus,
+                         const double* adjoint_mids,
+                         Matrix& X_adjoint_out);
+
+// Passes the adjoint of Y to the saved mids which Y is made of, the input mids are constant
+void AddYMatrixAdjoint(const std::vector<PositionOfSavedEmu>& Y_data,
+                       const std::vector<Convolution>& convolutions,
+                       const double* convolution_others,
+                       const Matrix& Y_adjoint,
+                       double* adjoint_mids_out);
+}
 }
-}
\ No newline at end of file
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <memory>
+
+#include "utilities/matrix.h"
+
+
+namespace khnum {
+// Dense LU of A for the small networks
+class ISmallNetworkSolver {
+public:
+    virtual void Factorize(const Matrix& A) = 0;
+
+    // result_out = A^-1 * right_part
+    virtual void Solve(const Eigen::Ref<const Matrix>& right_part, Eigen::Ref<Matrix> result_out) const = 0;
+
+    // result_out = A^-T * right_part
+    virtual void SolveTransposed(const Eigen::Ref<const Matrix>& right_part, Eigen::Ref<Matrix> result_out) const = 0;
+
+    virtual ~ISmallNetworkSolver() {};
+};
+
+// Networks up to this size are solved with compile-time fixed-size matrices
+const size_t max_fixed_network_size = 16;
+
+// Picks the fixed-size solver of the network size from a dispatch table or the dynamic-size one for bigger networks
+std::unique_ptr<ISmallNetworkSolver> CreateSmallNetworkSolver(size_t network_size);
+} // namespace khnum
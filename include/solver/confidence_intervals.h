@@ -0,0 +1,68 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "alglib/ap.h"
+#include "utilities/problem.h"
+#include "simulator/generator.h"
+
+
+namespace khnum {
+struct ConfidenceIntervalsParameters {
+    // increase of the SSR at the interval ends, the chi-square quantile with 1 degree of freedom, 95%
+    double ssr_threshold = 3.841459;
+    size_t total_threads = 1;
+    // fits along the flux in one direction before the threshold is bracketed
+    int max_steps = 30;
+    // the first step along the flux as a share of its feasible range, the step doubles while the SSR grows slowly
+    double initial_step_share = 0.02;
+    // regula falsi fits locating the threshold in the bracket
+    int refinement_steps = 3;
+};
+
+// The reversible reactions are profiled as their net and exchange fluxes
+enum class ProfiledFluxType {
+    single,   // flux of a reaction which isn't reversible
+    net,      // forward minus backward flux of a reversible reaction
+    exchange  // min(forward, backward) flux of a reversible reaction
+};
+
+struct FluxConfidenceInterval {
+    // the forward reaction for the net and the exchange fluxes
+    int reaction_id;
+    std::string name;
+    ProfiledFluxType type = ProfiledFluxType::single;
+    double best_value;
+    double lower;
+    double upper;
+    // the interval reaches the end of the feasible range of the flux, the SSR there stays below the threshold
+    bool is_lower_feasible_limit = false;
+    bool is_upper_feasible_limit = false;
+    // constrained fits of the profile
+    int total_fits = 0;
+};
+
+// Profile likelihood confidence intervals of the dependent and the free fluxes,
+// the net and the exchange fluxes of the reversible reactions.
+// The flux is fixed with an equality constraint and stepped away from the best fit, every step is a fit
+// of the other free fluxes warm-started from the previous one, until the SSR rises by the threshold.
+// Fluxes are profiled in parallel: the compiled model in the generator is shared read-only,
+// every worker has its own simulator and Levenberg-Marquardt buffers and takes the fluxes from a common queue
+class ConfidenceIntervalsCalculator {
+public:
+    ConfidenceIntervalsCalculator(const Problem &problem, const SimulatorGenerator &generator,
+                                  const ConfidenceIntervalsParameters &parameters = ConfidenceIntervalsParameters());
+
+    // Intervals around the solution with the smallest SSR, in the order of problem.reactions.
+    // Every reversible pair is replaced by its net and exchange fluxes at the position of its first reaction
+    std::vector<FluxConfidenceInterval> Calculate(const std::vector<alglib::real_1d_array> &solutions);
+
+private:
+    const Problem &problem_;
+    const SimulatorGenerator &generator_;
+    ConfidenceIntervalsParameters parameters_;
+};
+
+void PrintConfidenceIntervals(const std::vector<FluxConfidenceInterval> &intervals);
+} // namespace khnum
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include "utilities/matrix.h"
+
+
+namespace khnum {
+// Engine of the least squares fit
+enum class LeastSquaresSolver {
+    alglib, ///< alglib minlm with the generic linear constraints
+    native  ///< LevenbergMarquardt below, works on the Eigen buffers of the simulator
+};
+
+struct LevenbergMarquardtParameters {
+    // accepted steps
+    int max_iterations = 500;
+    // stops when the accepted step is shorter
+    double step_tolerance = 1e-4;
+    // stops when the gradient projected on the free directions is smaller by the max norm
+    double gradient_tolerance = 1e-10;
+    // step of the forward differences when the jacobian isn't calculated by the function
+    double difference_step = 1e-3;
+};
+
+enum class LevenbergMarquardtStatus {step_tolerance, gradient_tolerance, max_iterations, no_progress};
+
+struct LevenbergMarquardtReport {
+    int iterations = 0;
+    int rejected_steps = 0;
+    int residual_evaluations = 0;
+    int jacobian_evaluations = 0;
+    // sums of the squared residuals
+    double initial_ssr = 0.0;
+    double final_ssr = 0.0;
+    LevenbergMarquardtStatus status = LevenbergMarquardtStatus::max_iterations;
+};
+
+// Minimizes |r(x)|^2 subject to lower <= x <= upper, inequalities * x <= inequality_bounds
+// and the optional equalities * x = equality_bounds.
+// The constraints are kept with an active set: a step stops at the first constraint it reaches,
+// the constraint stays active while its Lagrange multiplier is nonnegative. The equalities are always active.
+// The damped Gauss-Newton step is solved in the nullspace of the active constraints, so the iterates are feasible.
+// An infeasible start point is projected on the feasible set first.
+// The buffers are reused, so one object is meant for many minimizations of the same size
+class LevenbergMarquardt {
+public:
+    // Fills the residuals in x and the jacobian if the pointer isn't null
+    using ResidualFunction = std::function<void(const Eigen::VectorXd& x, Eigen::VectorXd& residuals,
+                                                Matrix* jacobian)>;
+
+    LevenbergMarquardt(int total_residuals,
+                       const Eigen::VectorXd& lower_bounds,
+                       const Eigen::VectorXd& upper_bounds,
+                       const Matrix& inequalities,
+                       const Eigen::VectorXd& inequality_bounds,
+                       const LevenbergMarquardtParameters& parameters = LevenbergMarquardtParameters());
+
+    // Equalities of the next minimizations, an empty matrix removes them.
+    // The zero rows are skipped, throws if the bound of a zero row isn't zero
+    void SetEqualities(const Matrix& equalities, const Eigen::VectorXd& equality_bounds);
+
+    // With has_jacobian the function calculates the jacobian in every trial point,
+    // otherwise it is approximated with forward differences in the accepted points
+    const Eigen::VectorXd& Minimize(const ResidualFunction& function, bool has_jacobian, const Eigen::VectorXd& start);
+
+    const LevenbergMarquardtReport& GetReport() const;
+
+private:
+    // The constraints are numbered: lower bounds, upper bounds, rows of the inequalities, rows of the equalities
+    double GetSlack(int constraint, const Eigen::VectorXd& x) const;
+
+    double GetNormalProduct(int constraint, const Eigen::VectorXd& direction) const;
+
+    Eigen::VectorXd GetNormal(int constraint) const;
+
+    // Dykstra's alternating projections on the box, the half-spaces and the hyperplanes
+    void ProjectOnFeasibleSet(Eigen::VectorXd& x) const;
+
+    // Active constraints with the nonnegative multipliers in the point x_
+    void UpdateWorkingSet();
+
+    // Orthonormal basis of the directions keeping the working set active
+    void UpdateFreeDirections();
+
+    // Returns the longest step share in [0, 1] along the direction, the blocking constraint or -1
+    double GetMaxStep(const Eigen::VectorXd& direction, int& blocking_constraint) const;
+
+    void CalculateJacobian(const ResidualFunction& function, bool has_jacobian);
+
+    int total_variables_;
+    int total_residuals_;
+    Eigen::VectorXd lower_bounds_;
+    Eigen::VectorXd upper_bounds_;
+    // rows are normalized, zero rows are removed
+    Matrix inequalities_;
+    Eigen::VectorXd inequality_bounds_;
+    // rows are normalized
+    Matrix equalities_;
+    Eigen::VectorXd equality_bounds_;
+    LevenbergMarquardtParameters parameters_;
+    LevenbergMarquardtReport report_;
+
+    std::vector<int> working_set_;
+    Matrix free_directions_;
+
+    Eigen::VectorXd x_;
+    Eigen::VectorXd residuals_;
+    Matrix jacobian_;
+    Eigen::VectorXd trial_x_;
+    Eigen::VectorXd trial_residuals_;
+    Matrix trial_jacobian_;
+    Eigen::VectorXd difference_residuals_;
+    Matrix normal_matrix_;
+    Eigen::VectorXd gradient_;
+    // Marquardt scaling, the largest diagonal of the normal matrix seen so far
+    Eigen::VectorXd scaling_;
+};
+} // namespace khnum
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <vector>
+
+#include "alglib/ap.h"
+#include "utilities/problem.h"
+#include "simulator/generator.h"
+
+
+namespace khnum {
+// Runs problem.total_starts optimizations on problem.multistart_threads threads.
+// The compiled model in the generator is shared read-only, every worker has its own Solver:
+// a simulator workspace and a Levenberg-Marquardt state.
+// Workers take the starts from a common queue, so slow and fast fits are balanced.
+// The start points are generated before the workers start, so the solutions don't depend on the threads count
+class MultistartSolver {
+public:
+    MultistartSolver(const Problem &problem, const SimulatorGenerator &generator);
+
+    // Solutions in the order of the starts
+    std::vector<alglib::real_1d_array> Solve();
+
+private:
+    const Problem &problem_;
+    const SimulatorGenerator &generator_;
+};
+} // namespace khnum
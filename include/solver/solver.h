@@ -1,12 +1,13 @@
 #pragma once
 
 #include "alglib/ap.h"
-#include <random>
 
 #include "alglib/optimization.h"
 #include "utilities/problem.h"
 #include "simulator/simulator.h"
 #include "simulator/generator.h"
+#include "solver/levenberg_marquardt.h"
+#include "solver/start_points.h"
 
 
 namespace khnum {
@@ -17,32 +18,40 @@ class Solver {
 public:
     Solver(const Problem &problem, const SimulatorGenerator &generator);
 
+    // Runs problem.total_starts optimizations from the points of GenerateStartPoints
     void Solve();
 
+    // Runs the optimization from the free fluxes
+    alglib::real_1d_array SolveFromPoint(const Eigen::VectorXd &start_point);
+
     std::vector<alglib::real_1d_array> GetResult();
 
+    // Accepted steps of the last optimization
+    int GetLastIterationsCount() const;
+
 private:
     void SetOptimizationParameters();
 
     // Set constraints so the fluxes always > 0
     void SetConstraints();
 
-    void GenerateInitialPoints(std::mt19937 &random_source);
-
     void PrintStartMessage();
 
     alglib::real_1d_array RunOptimization();
 
+    alglib::real_1d_array RunNativeOptimization(const Eigen::VectorXd &start_point);
+
     void CalculateResidual(const alglib::real_1d_array &free_fluxes,
                            alglib::real_1d_array &residuals);
 
-    std::vector<Flux> CalculateAllFluxesFromFree(const alglib::real_1d_array &free_fluxes_alglib);
+    // The residuals and the jacobian straight from the simulator result, for the native solver
+    void CalculateResidual(const Eigen::VectorXd &free_fluxes, Eigen::VectorXd &residuals, Matrix *jacobian);
 
     void Fillf0Array(alglib::real_1d_array &residuals, const std::vector<EmuAndMid> &simulated_mids);
 
     double GetSSR(const alglib::real_1d_array &residuals);
 
-    void PrintFinalMessage(const alglib::real_1d_array &free_fluxes);
+    void PrintFinalMessage(double ssr, int iterations);
 
     friend void AlglibCallback(const alglib::real_1d_array &free_fluxes,
                                alglib::real_1d_array &residuals, void *ptr);
@@ -55,10 +64,12 @@ private:
 
 public:
     bool in_jacobian = false;
+    bool is_state_created_ = false;
     int iteration_;
     alglib::real_1d_array free_fluxes_;
     alglib::minlmstate state_;
     alglib::minlmreport report_;
+    std::optional<LevenbergMarquardt> native_solver_;
     std::vector<alglib::real_1d_array> all_solutions_;
     std::optional<Simulator> new_simulator_;
     std::vector<std::vector<EmuAndMid>> diff_results_;
@@ -67,11 +78,15 @@ public:
     int reactions_num_;
     int measurements_count_;
     int iteration_total_;
+    unsigned int starts_seed_;
+    StartPointsMethod start_points_method_;
     bool use_analytic_gradient_ = false;
-    std::vector<ReactionsName> reactions_;
+    LeastSquaresSolver least_squares_solver_;
+    // the problem is shared between the solvers of a multistart, so it isn't copied
+    const std::vector<ReactionsName>& reactions_;
 
-    Matrix nullspace_;
-    std::vector<Measurement> measured_mids_;
+    const Matrix& nullspace_;
+    const std::vector<Measurement>& measured_mids_;
 
     alglib::real_1d_array lower_bounds_;
     alglib::real_1d_array upper_bounds_;
@@ -83,4 +98,8 @@ void AlglibCallback(const alglib::real_1d_array &free_fluxes,
 void JacobianCallback(const alglib::real_1d_array &free_fluxes,
                       alglib::real_1d_array &fi,
                       alglib::real_2d_array &jac, void *ptr);
+
+// Weighted residuals (simulated - measured) / error and their derivatives by the free fluxes if jacobian isn't null
+void FillResiduals(const SimulatorResult &result, const std::vector<Measurement> &measurements,
+                   Eigen::VectorXd &residuals, Matrix *jacobian);
 } // namespace khnum
\ No newline at end of file
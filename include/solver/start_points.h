@@ -0,0 +1,28 @@
+#pragma once
+
+#include <vector>
+
+#include "utilities/matrix.h"
+
+
+namespace khnum {
+// How the start points of the multistart are chosen
+enum class StartPointsMethod {
+    uniform,         ///< uniform in the box of the bounds, the i'th point uses the seed + i, may be infeasible
+    latin_hypercube, ///< latin hypercube in the box, infeasible points are moved towards the interior point
+    hit_and_run      ///< hit-and-run chain in the polytope started from the interior point
+};
+
+// Start points in the polytope of the free fluxes:
+// lower_bounds <= v_free <= upper_bounds and nullspace * v_free <= 0, so the dependent fluxes are nonnegative.
+// The fluxes with equal bounds are fixed, the sampling works in the box scaled to the unit cube.
+// The interior point is the center of the biggest ball in the scaled polytope, if the polytope has no interior
+// the points are uniform in the box.
+// The points depend only on the arguments
+std::vector<Eigen::VectorXd> GenerateStartPoints(const Matrix& nullspace,
+                                                 const std::vector<double>& lower_bounds,
+                                                 const std::vector<double>& upper_bounds,
+                                                 size_t total_points,
+                                                 StartPointsMethod method,
+                                                 unsigned int seed);
+} // namespace khnum
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <array>
+#include <cstdint>
 #include <vector>
 #include <string>
 
@@ -8,9 +10,52 @@
 namespace khnum {
 using AtomStates = std::vector<char>; // like a vector<bool> but iterable
 
+// the i'th bit is set if the i'th atom of the metabolite is in the emu
+const size_t max_metabolite_atoms = 256;
+using AtomsMask = std::array<std::uint64_t, max_metabolite_atoms / 64>;
+
+// Trivially copyable emu: the metabolite is an id in the global table of the metabolite names,
+// the names are materialized only for parsing and printing
 struct Emu {
-    std::string name;
-    AtomStates atom_states;
+    int metabolite = -1;
+    int total_atoms = 0;
+    AtomsMask atoms{};
+};
+
+// Id of the metabolite in the global table, the new names are added to it. Thread-safe
+int GetMetaboliteId(const std::string& name);
+
+const std::string& GetMetaboliteName(int metabolite);
+
+// Emu without atoms, throws if the metabolite has more than max_metabolite_atoms atoms
+Emu CreateEmu(int metabolite, int total_atoms);
+
+Emu CreateEmu(const std::string& name, const AtomStates& atom_states);
+
+inline bool IsAtomIncluded(const Emu& emu, int atom) {
+    return (emu.atoms[atom / 64] >> (atom % 64)) & 1u;
+}
+
+inline void IncludeAtom(Emu& emu, int atom) {
+    emu.atoms[atom / 64] |= std::uint64_t{1} << (atom % 64);
+}
+
+// number of the included atoms
+inline int GetEmuSize(const Emu& emu) {
+    int size = 0;
+    for (std::uint64_t word : emu.atoms) {
+        size += __builtin_popcountll(word);
+    }
+    return size;
+}
+
+AtomStates GetAtomStates(const Emu& emu);
+
+// for example, "PYR:110"
+std::string GetEmuName(const Emu& emu);
+
+struct EmuHash {
+    size_t operator()(const Emu& emu) const;
 };
 
 
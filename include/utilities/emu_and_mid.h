@@ -2,12 +2,22 @@
 
 #include "utilities/emu.h"
 
+#include <array>
 #include <vector>
 
 
 namespace khnum {
 using Mid = std::vector<double>;
 
+// mids of the emus with up to max_inline_mid_size - 1 atoms fit into InlineMid
+const size_t max_inline_mid_size = 64;
+
+// Mid with the masses stored in place, the convolutions of the simulator work on it without allocations
+struct InlineMid {
+    std::array<double, max_inline_mid_size> masses;
+    size_t size = 0;
+};
+
 struct EmuAndMid {
     Emu emu;
     Mid mid;
@@ -16,6 +26,19 @@ struct EmuAndMid {
 // convolution
 Mid operator*(const Mid &lhs, const Mid &rhs);
 
+// convolution into the preallocated result, result must not alias lhs or rhs
+void Convolve(const Mid &lhs, const Mid &rhs, Mid &result);
+
+// the same with rhs_size masses starting at rhs
+void Convolve(const Mid &lhs, const double *rhs, size_t rhs_size, Mid &result);
+
+// result = lhs (*) rhs, where result has lhs_size + rhs_size - 1 masses and doesn't alias the operands.
+// Every mass of lhs adds a scaled rhs to the result with Eigen packets
+void Convolve(const double *lhs, size_t lhs_size, const double *rhs, size_t rhs_size, double *result);
+
+// result must not alias lhs, the size of the result must fit into max_inline_mid_size
+void Convolve(const InlineMid &lhs, const double *rhs, size_t rhs_size, InlineMid &result);
+
 Mid Normalize(Mid mid);
 
 // need this for stl containers
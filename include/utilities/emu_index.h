@@ -0,0 +1,41 @@
+#pragma once
+
+#include <unordered_map>
+
+#include "utilities/emu.h"
+
+
+namespace khnum {
+// Hash map from emus to values.
+// Used instead of the linear searches over vectors of emus by the modeller and the generator
+template <typename Value>
+class EmuIndex {
+public:
+    // Keeps the old value if the emu is already in the index, returns the value of the emu
+    Value& Insert(const Emu& emu, const Value& value) {
+        return values_.emplace(emu, value).first->second;
+    }
+
+    // nullptr if there is no such emu
+    Value* Find(const Emu& emu) {
+        auto value = values_.find(emu);
+        return value == values_.end() ? nullptr : &value->second;
+    }
+
+    const Value* Find(const Emu& emu) const {
+        auto value = values_.find(emu);
+        return value == values_.end() ? nullptr : &value->second;
+    }
+
+    bool Contains(const Emu& emu) const {
+        return values_.count(emu) > 0;
+    }
+
+    size_t Size() const {
+        return values_.size();
+    }
+
+private:
+    std::unordered_map<Emu, Value, EmuHash> values_;
+};
+} // namespace khnum
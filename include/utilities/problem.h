@@ -6,6 +6,9 @@
 #include "emu.h"
 #include "measurement.h"
 #include "reaction.h"
+#include "simulator/simulation_data.h"
+#include "solver/levenberg_marquardt.h"
+#include "solver/start_points.h"
 
 
 namespace khnum {
@@ -14,6 +17,12 @@ struct ReactionsName {
     std::string name;
 };
 
+// Forward and backward reactions of a reversible reaction by their positions in Problem::reactions
+struct ReversibleReaction {
+    size_t forward;
+    size_t backward;
+};
+
 struct GeneratorParameters {
     std::vector<EmuNetwork> networks;
     std::vector<EmuAndMid> input_mids;
@@ -22,16 +31,31 @@ struct GeneratorParameters {
     Matrix nullspace;
     std::vector<int> free_flux_id_to_nullspace_position;
     std::vector<int> free_fluxes_id;
+    BigNetworkSolver big_network_solver = BigNetworkSolver::direct;
+    // threads of one simulator, independent networks are simulated concurrently
+    size_t total_threads = 1;
+    // networks with more unknown emus are solved with the sparse solvers,
+    // up to max_fixed_network_size dense LU of the fixed size is faster than sparse LU
+    size_t max_small_network_size = max_fixed_network_size;
 };
 
 struct Problem {
     std::vector<ReactionsName> reactions;
+    std::vector<ReversibleReaction> reversible_reactions;
     size_t reactions_total;
     std::vector<Emu> measured_isotopes;
     Matrix nullspace;
     std::vector<Measurement> measurements;
     int measurements_count;
     bool use_analytic_jacobian = false;
+    LeastSquaresSolver least_squares_solver = LeastSquaresSolver::native;
+    // threads calculating the analytic jacobian, the free fluxes are split between them
+    size_t jacobian_threads = 1;
+    // the start points of the multistart are generated together from starts_seed
+    size_t total_starts = 30;
+    size_t multistart_threads = 1;
+    unsigned int starts_seed = 0;
+    StartPointsMethod start_points_method = StartPointsMethod::latin_hypercube;
     std::vector<double> lower_bounds;
     std::vector<double> upper_bounds;
     GeneratorParameters simulator_parameters_;
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace khnum {
+// Work-stealing thread pool.
+// Every worker has its own queue: it takes the newest tasks from it and steals the oldest ones from the others.
+// Tasks may submit new tasks, Wait() returns when all of them are finished.
+class ThreadPool {
+public:
+    // Tasks which are waited for separately from the other tasks of the pool, so it can be done inside a task
+    class TaskGroup {
+    public:
+        explicit TaskGroup(ThreadPool& thread_pool);
+
+        void Submit(std::function<void()> task);
+
+        // Executes the pending tasks of the pool while waiting and sleeps when there are none.
+        // Rethrows the first exception thrown by a task of the group
+        void Wait();
+
+    private:
+        ThreadPool& thread_pool_;
+        // guarded by state_mutex_ of the pool, tasks_finished_ is notified when it reaches zero
+        size_t unfinished_tasks_ = 0;
+        std::mutex exception_mutex_;
+        std::exception_ptr exception_;
+    };
+
+    explicit ThreadPool(size_t total_threads);
+
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Tasks submitted from a worker go to its queue, the other ones are spread between the queues
+    void Submit(std::function<void()> task);
+
+    // The calling thread helps to execute the tasks while waiting.
+    // Rethrows the first exception thrown by a task
+    void Wait();
+
+    size_t GetThreadsCount() const;
+
+private:
+    struct TaskQueue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    void RunWorker(size_t worker);
+
+    // Runs one task from the queue of the worker or steals one, returns false if there is nothing to run
+    bool RunPendingTask(size_t worker);
+
+    void FinishTask();
+
+    // Own queue of a worker of this pool and queues_.size() for the other threads
+    size_t GetCurrentQueue() const;
+
+    std::vector<std::unique_ptr<TaskQueue>> queues_;
+    std::vector<std::thread> workers_;
+
+    std::mutex state_mutex_;
+    std::condition_variable task_submitted_;
+    std::condition_variable tasks_finished_;
+    size_t pending_tasks_ = 0;
+    size_t unfinished_tasks_ = 0;
+    bool stop_ = false;
+    std::exception_ptr exception_;
+
+    std::atomic<size_t> next_queue_{0};
+};
+} // namespace khnum
@@ -0,0 +1,124 @@
+#include "compiled_model/binary_stream.h"
+
+#include <cstring>
+#include <stdexcept>
+
+
+namespace khnum {
+void BinaryWriter::Write(const std::string& value) {
+    Write<std::uint64_t>(value.size());
+    WriteBytes(value.data(), value.size());
+}
+
+void BinaryWriter::Write(const Matrix& matrix) {
+    Write<std::int64_t>(matrix.rows());
+    Write<std::int64_t>(matrix.cols());
+    WriteBytes(matrix.data(), matrix.size() * sizeof(double));
+}
+
+void BinaryWriter::Write(const Eigen::VectorXd& vector) {
+    Write<std::int64_t>(vector.size());
+    WriteBytes(vector.data(), vector.size() * sizeof(double));
+}
+
+// the compressed storage is written as is, so the positions in valuePtr() stay valid
+void BinaryWriter::Write(const SparseMatrix& matrix) {
+    SparseMatrix compressed = matrix;
+    compressed.makeCompressed();
+    Write<std::int64_t>(compressed.rows());
+    Write<std::int64_t>(compressed.cols());
+    Write<std::int64_t>(compressed.nonZeros());
+    WriteBytes(compressed.outerIndexPtr(), (compressed.outerSize() + 1) * sizeof(SparseMatrix::StorageIndex));
+    WriteBytes(compressed.innerIndexPtr(), compressed.nonZeros() * sizeof(SparseMatrix::StorageIndex));
+    WriteBytes(compressed.valuePtr(), compressed.nonZeros() * sizeof(double));
+}
+
+void BinaryWriter::Append(const BinaryWriter& other) {
+    buffer_ += other.buffer_;
+}
+
+const std::string& BinaryWriter::GetBuffer() const {
+    return buffer_;
+}
+
+void BinaryWriter::WriteBytes(const void* data, size_t size) {
+    if (size > 0) {
+        buffer_.append(static_cast<const char*>(data), size);
+    }
+}
+
+BinaryReader::BinaryReader(const char* data, size_t size) : data_{data}, size_{size} {
+}
+
+std::string BinaryReader::ReadString() {
+    std::string value(ReadSize(1), '\0');
+    ReadBytes(&value[0], value.size());
+    return value;
+}
+
+Matrix BinaryReader::ReadMatrix() {
+    const std::int64_t rows = Read<std::int64_t>();
+    const std::int64_t cols = Read<std::int64_t>();
+    if (rows < 0 || cols < 0 || (rows > 0 && static_cast<size_t>(cols) > (size_ - position_) / sizeof(double) / rows)) {
+        throw std::runtime_error("The compiled model is corrupted");
+    }
+    Matrix matrix(rows, cols);
+    ReadBytes(matrix.data(), matrix.size() * sizeof(double));
+    return matrix;
+}
+
+Eigen::VectorXd BinaryReader::ReadVector() {
+    const size_t size = Read<std::int64_t>();
+    if (size > (size_ - position_) / sizeof(double)) {
+        throw std::runtime_error("The compiled model is corrupted");
+    }
+    Eigen::VectorXd vector(size);
+    ReadBytes(vector.data(), size * sizeof(double));
+    return vector;
+}
+
+SparseMatrix BinaryReader::ReadSparseMatrix() {
+    using StorageIndex = SparseMatrix::StorageIndex;
+    const std::int64_t rows = Read<std::int64_t>();
+    const std::int64_t cols = Read<std::int64_t>();
+    const std::int64_t non_zeros = Read<std::int64_t>();
+    const size_t rest = size_ - position_;
+    if (rows < 0 || cols < 0 || non_zeros < 0 ||
+        static_cast<size_t>(cols) + 1 > rest / sizeof(StorageIndex) ||
+        static_cast<size_t>(non_zeros) > rest / (sizeof(StorageIndex) + sizeof(double))) {
+        throw std::runtime_error("The compiled model is corrupted");
+    }
+
+    SparseMatrix matrix(rows, cols);
+    matrix.resizeNonZeros(non_zeros);
+    ReadBytes(matrix.outerIndexPtr(), (cols + 1) * sizeof(StorageIndex));
+    ReadBytes(matrix.innerIndexPtr(), non_zeros * sizeof(StorageIndex));
+    ReadBytes(matrix.valuePtr(), non_zeros * sizeof(double));
+    if (matrix.outerIndexPtr()[0] != 0 || matrix.outerIndexPtr()[cols] != non_zeros) {
+        throw std::runtime_error("The compiled model is corrupted");
+    }
+    return matrix;
+}
+
+size_t BinaryReader::ReadSize(size_t element_size) {
+    const std::uint64_t size = Read<std::uint64_t>();
+    if (element_size > 0 && size > (size_ - position_) / element_size) {
+        throw std::runtime_error("The compiled model is corrupted");
+    }
+    return size;
+}
+
+bool BinaryReader::IsFinished() const {
+    return position_ == size_;
+}
+
+void BinaryReader::ReadBytes(void* destination, size_t size) {
+    if (size > size_ - position_) {
+        throw std::runtime_error("The compiled model is corrupted");
+    }
+    if (size > 0) {
+        std::memcpy(destination, data_ + position_, size);
+        position_ += size;
+    }
+}
+} // namespace khnum
@@ -0,0 +1,627 @@
+#include "compiled_model/compiled_model.h"
+
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+#include <unordered_map>
+
+#include "compiled_model/binary_stream.h"
+#include "modeller/modeller.h"
+
+
+namespace khnum {
+namespace {
+using Magic = std::array<char, 8>;
+const Magic compiled_model_magic = {'K', 'H', 'N', 'U', 'M', 'C', 'M', '\0'};
+
+// Writes the structures of the compiled model field by field, the run settings are skipped.
+// The metabolites of the emus are replaced by their positions in the names table
+class ModelWriter {
+public:
+    template <typename T>
+    void Write(const std::vector<T>& values) {
+        writer_.Write<std::uint64_t>(values.size());
+        for (const T& value : values) {
+            Write(value);
+        }
+    }
+
+    void Write(const Emu& emu) {
+        auto metabolite = metabolites_.emplace(emu.metabolite, static_cast<int>(names_.size()));
+        if (metabolite.second) {
+            names_.push_back(GetMetaboliteName(emu.metabolite));
+        }
+        writer_.Write<std::int32_t>(metabolite.first->second);
+        writer_.Write<std::int32_t>(emu.total_atoms);
+        writer_.Write(emu.atoms);
+    }
+
+    void Write(const EmuSubstrate& substrate) {
+        Write(substrate.emu);
+        writer_.Write(substrate.coefficient);
+    }
+
+    void Write(const EmuReaction& reaction) {
+        writer_.Write<std::int32_t>(reaction.id);
+        Write(reaction.left);
+        Write(reaction.right);
+        writer_.Write(reaction.rate);
+    }
+
+    void Write(const EmuAndMid& emu_and_mid) {
+        Write(emu_and_mid.emu);
+        writer_.WriteArray(emu_and_mid.mid);
+    }
+
+    void Write(const Measurement& measurement) {
+        Write(measurement.emu);
+        writer_.WriteArray(measurement.mid);
+        writer_.WriteArray(measurement.errors);
+        writer_.Write(measurement.correction_matrix);
+    }
+
+    void Write(const ReactionsName& reaction) {
+        writer_.Write<std::int32_t>(reaction.id);
+        writer_.Write(reaction.name);
+    }
+
+    void Write(const ReversibleReaction& reaction) {
+        writer_.Write<std::uint64_t>(reaction.forward);
+        writer_.Write<std::uint64_t>(reaction.backward);
+    }
+
+    void Write(const FluxAndCoefficient& flux) {
+        writer_.Write<std::int32_t>(flux.id);
+        writer_.Write(flux.coefficient);
+    }
+
+    void Write(const FluxCombination& combination) {
+        writer_.Write<std::uint64_t>(combination.i);
+        writer_.Write<std::uint64_t>(combination.j);
+        Write(combination.fluxes);
+        writer_.Write<std::int32_t>(combination.value_position);
+    }
+
+    void Write(const Convolution& convolution) {
+        writer_.WriteArray(convolution.elements);
+        writer_.Write<std::int32_t>(convolution.flux_id);
+        writer_.WriteArray(convolution.others_offsets);
+    }
+
+    void Write(const FinalEmu& final_emu) {
+        Write(final_emu.emu);
+        writer_.Write<std::int32_t>(final_emu.order_in_X);
+        writer_.Write<std::int32_t>(final_emu.position_in_result);
+        writer_.Write(final_emu.correction_matrix);
+    }
+
+    void Write(const FluxMatrixOperator& flux_operator) {
+        writer_.Write(flux_operator.coefficients);
+        writer_.Write(flux_operator.offset);
+        writer_.WriteArray(flux_operator.rows);
+        writer_.WriteArray(flux_operator.cols);
+    }
+
+    void Write(const GeneratorParameters& parameters) {
+        Write(parameters.networks);
+        Write(parameters.input_mids);
+        Write(parameters.measured_isotopes);
+        Write(parameters.measurements);
+        writer_.Write(parameters.nullspace);
+        writer_.WriteArray(parameters.free_flux_id_to_nullspace_position);
+        writer_.WriteArray(parameters.free_fluxes_id);
+        writer_.Write<std::uint64_t>(parameters.max_small_network_size);
+    }
+
+    void Write(const Problem& problem) {
+        Write(problem.reactions);
+        Write(problem.reversible_reactions);
+        writer_.Write<std::uint64_t>(problem.reactions_total);
+        Write(problem.measured_isotopes);
+        writer_.Write(problem.nullspace);
+        Write(problem.measurements);
+        writer_.Write<std::int32_t>(problem.measurements_count);
+        writer_.WriteArray(problem.lower_bounds);
+        writer_.WriteArray(problem.upper_bounds);
+        Write(problem.simulator_parameters_);
+    }
+
+    void Write(const SimulatorNetworkData& network) {
+        writer_.Write<std::int32_t>(static_cast<std::int32_t>(network.size));
+        Write(network.symbolic_A);
+        Write(network.symbolic_B);
+        writer_.WriteArray(network.Y_data);
+        Write(network.convolutions);
+        writer_.WriteArray(network.usefull_emus);
+        Write(network.final_emus);
+        writer_.WriteArray(network.dependencies);
+        writer_.WriteArray(network.diff_free_fluxes);
+        for (size_t value : {network.saved_mids_offset, network.convolution_others_size,
+                             network.A_rows, network.A_cols, network.B_rows, network.B_cols,
+                             network.Y_rows, network.Y_cols}) {
+            writer_.Write<std::uint64_t>(value);
+        }
+        Write(network.A_operator);
+        Write(network.B_operator);
+        writer_.Write(network.A_pattern);
+        writer_.Write(network.B_pattern);
+    }
+
+    void Write(const MidArenaLayout& layout) {
+        writer_.WriteArray(layout.input_offsets);
+        writer_.Write<std::uint64_t>(layout.size);
+    }
+
+    // the names table goes before the structures, so the emus can be read in one pass
+    void WriteTo(BinaryWriter& output) const {
+        output.Write<std::uint64_t>(names_.size());
+        for (const std::string& name : names_) {
+            output.Write(name);
+        }
+        output.Append(writer_);
+    }
+
+private:
+    BinaryWriter writer_;
+    std::unordered_map<int, int> metabolites_;
+    std::vector<std::string> names_;
+};
+
+// Reads what ModelWriter wrote, the metabolite names are interned again
+class ModelReader {
+public:
+    explicit ModelReader(BinaryReader& reader) : reader_{reader} {
+        metabolites_.resize(reader_.ReadSize(sizeof(std::uint64_t)));
+        for (int& metabolite : metabolites_) {
+            metabolite = GetMetaboliteId(reader_.ReadString());
+        }
+    }
+
+    template <typename T>
+    void Read(std::vector<T>& values) {
+        values.resize(reader_.ReadSize(1));
+        for (T& value : values) {
+            Read(value);
+        }
+    }
+
+    void Read(Emu& emu) {
+        const std::int32_t metabolite = reader_.Read<std::int32_t>();
+        if (metabolite < 0 || metabolite >= static_cast<std::int32_t>(metabolites_.size())) {
+            throw std::runtime_error("The compiled model is corrupted");
+        }
+        emu.metabolite = metabolites_[metabolite];
+        emu.total_atoms = reader_.Read<std::int32_t>();
+        emu.atoms = reader_.Read<AtomsMask>();
+    }
+
+    void Read(EmuSubstrate& substrate) {
+        Read(substrate.emu);
+        substrate.coefficient = reader_.Read<EmuCoefficient>();
+    }
+
+    void Read(EmuReaction& reaction) {
+        reaction.id = reader_.Read<std::int32_t>();
+        Read(reaction.left);
+        Read(reaction.right);
+        reaction.rate = reader_.Read<Rate>();
+    }
+
+    void Read(EmuAndMid& emu_and_mid) {
+        Read(emu_and_mid.emu);
+        emu_and_mid.mid = reader_.ReadArray<double>();
+    }
+
+    void Read(Measurement& measurement) {
+        Read(measurement.emu);
+        measurement.mid = reader_.ReadArray<double>();
+        measurement.errors = reader_.ReadArray<double>();
+        measurement.correction_matrix = reader_.ReadMatrix();
+    }
+
+    void Read(ReactionsName& reaction) {
+        reaction.id = reader_.Read<std::int32_t>();
+        reaction.name = reader_.ReadString();
+    }
+
+    void Read(ReversibleReaction& reaction) {
+        reaction.forward = reader_.Read<std::uint64_t>();
+        reaction.backward = reader_.Read<std::uint64_t>();
+    }
+
+    void Read(FluxAndCoefficient& flux) {
+        flux.id = reader_.Read<std::int32_t>();
+        flux.coefficient = reader_.Read<double>();
+    }
+
+    void Read(FluxCombination& combination) {
+        combination.i = reader_.Read<std::uint64_t>();
+        combination.j = reader_.Read<std::uint64_t>();
+        Read(combination.fluxes);
+        combination.value_position = reader_.Read<std::int32_t>();
+    }
+
+    void Read(Convolution& convolution) {
+        convolution.elements = reader_.ReadArray<PositionOfSavedEmu>();
+        convolution.flux_id = reader_.Read<std::int32_t>();
+        convolution.others_offsets = reader_.ReadArray<int>();
+    }
+
+    void Read(FinalEmu& final_emu) {
+        Read(final_emu.emu);
+        final_emu.order_in_X = reader_.Read<std::int32_t>();
+        final_emu.position_in_result = reader_.Read<std::int32_t>();
+        final_emu.correction_matrix = reader_.ReadMatrix();
+    }
+
+    void Read(FluxMatrixOperator& flux_operator) {
+        flux_operator.coefficients = reader_.ReadSparseMatrix();
+        flux_operator.offset = reader_.ReadVector();
+        flux_operator.rows = reader_.ReadArray<int>();
+        flux_operator.cols = reader_.ReadArray<int>();
+    }
+
+    void Read(GeneratorParameters& parameters) {
+        Read(parameters.networks);
+        Read(parameters.input_mids);
+        Read(parameters.measured_isotopes);
+        Read(parameters.measurements);
+        parameters.nullspace = reader_.ReadMatrix();
+        parameters.free_flux_id_to_nullspace_position = reader_.ReadArray<int>();
+        parameters.free_fluxes_id = reader_.ReadArray<int>();
+        parameters.max_small_network_size = reader_.Read<std::uint64_t>();
+    }
+
+    void Read(Problem& problem) {
+        Read(problem.reactions);
+        Read(problem.reversible_reactions);
+        for (const ReversibleReaction& reaction : problem.reversible_reactions) {
+            if (reaction.forward >= problem.reactions.size() || reaction.backward >= problem.reactions.size()) {
+                throw std::runtime_error("The compiled model is corrupted");
+            }
+        }
+        problem.reactions_total = reader_.Read<std::uint64_t>();
+        Read(problem.measured_isotopes);
+        problem.nullspace = reader_.ReadMatrix();
+        Read(problem.measurements);
+        problem.measurements_count = reader_.Read<std::int32_t>();
+        problem.lower_bounds = reader_.ReadArray<double>();
+        problem.upper_bounds = reader_.ReadArray<double>();
+        Read(problem.simulator_parameters_);
+    }
+
+    void Read(SimulatorNetworkData& network) {
+        network.size = static_cast<NetworkSize>(reader_.Read<std::int32_t>());
+        Read(network.symbolic_A);
+        Read(network.symbolic_B);
+        network.Y_data = reader_.ReadArray<PositionOfSavedEmu>();
+        Read(network.convolutions);
+        network.usefull_emus = reader_.ReadArray<int>();
+        Read(network.final_emus);
+        network.dependencies = reader_.ReadArray<int>();
+        network.diff_free_fluxes = reader_.ReadArray<int>();
+        for (size_t* value : {&network.saved_mids_offset, &network.convolution_others_size,
+                              &network.A_rows, &network.A_cols, &network.B_rows, &network.B_cols,
+                              &network.Y_rows, &network.Y_cols}) {
+            *value = reader_.Read<std::uint64_t>();
+        }
+        Read(network.A_operator);
+        Read(network.B_operator);
+        network.A_pattern = reader_.ReadSparseMatrix();
+        network.B_pattern = reader_.ReadSparseMatrix();
+    }
+
+    void Read(MidArenaLayout& layout) {
+        layout.input_offsets = reader_.ReadArray<int>();
+        layout.size = reader_.Read<std::uint64_t>();
+    }
+
+private:
+    BinaryReader& reader_;
+    // ids of the metabolites of this process by their positions in the names table
+    std::vector<int> metabolites_;
+};
+
+void CheckModel(bool is_consistent) {
+    if (!is_consistent) {
+        throw std::runtime_error("The compiled model is corrupted");
+    }
+}
+
+bool IsInRange(long long value, size_t end) {
+    return value >= 0 && static_cast<size_t>(value) < end;
+}
+
+// [offset, offset + length) is in [0, end)
+bool IsSpanInRange(long long offset, long long length, size_t end) {
+    return offset >= 0 && length >= 0 && static_cast<size_t>(offset) <= end &&
+           static_cast<size_t>(length) <= end - static_cast<size_t>(offset);
+}
+
+void CheckFluxMatrixOperator(const FluxMatrixOperator& flux_operator, size_t total_values,
+                             size_t rows, size_t cols, size_t total_free_fluxes) {
+    CheckModel(static_cast<size_t>(flux_operator.coefficients.rows()) == total_values &&
+               static_cast<size_t>(flux_operator.coefficients.cols()) == total_free_fluxes &&
+               static_cast<size_t>(flux_operator.offset.size()) == total_values &&
+               flux_operator.rows.size() == total_values && flux_operator.cols.size() == total_values);
+    for (size_t value = 0; value < total_values; ++value) {
+        CheckModel(IsInRange(flux_operator.rows[value], rows) && IsInRange(flux_operator.cols[value], cols));
+    }
+}
+
+void CheckSavedEmu(const PositionOfSavedEmu& emu, size_t network_num, size_t mids_arena_size) {
+    CheckModel(emu.network == -1 || IsInRange(emu.network, network_num));
+    CheckModel(emu.length > 0 && IsSpanInRange(emu.offset, emu.length, mids_arena_size));
+}
+
+// The simulator indexes its buffers with the saved positions and sizes without checks,
+// so they are checked against each other before the loaded model is used
+void CheckNetworks(const CompiledModel& model) {
+    const GeneratorParameters& parameters = model.problem.simulator_parameters_;
+    const MidArenaLayout& layout = model.mid_arena_layout;
+    const size_t total_free_fluxes = model.problem.nullspace.cols();
+    CheckModel(!model.networks.empty() && layout.input_offsets.size() == parameters.input_mids.size());
+    for (size_t input = 0; input < layout.input_offsets.size(); ++input) {
+        CheckModel(IsSpanInRange(layout.input_offsets[input], parameters.input_mids[input].mid.size(), layout.size));
+    }
+
+    for (size_t network_num = 0; network_num < model.networks.size(); ++network_num) {
+        const SimulatorNetworkData& network = model.networks[network_num];
+        CheckModel(network.Y_cols > 0 && network.Y_cols <= max_inline_mid_size &&
+                   network.A_rows == network.A_cols && network.B_rows == network.A_rows &&
+                   network.Y_rows == network.Y_data.size() + network.convolutions.size() &&
+                   network.B_cols == network.Y_rows);
+
+        for (int dependency : network.dependencies) {
+            CheckModel(IsInRange(dependency, network_num));
+        }
+        for (int free_flux : network.diff_free_fluxes) {
+            CheckModel(IsInRange(free_flux, total_free_fluxes));
+        }
+
+        for (const PositionOfSavedEmu& known_emu : network.Y_data) {
+            CheckSavedEmu(known_emu, network_num, layout.size);
+            CheckModel(static_cast<size_t>(known_emu.length) <= network.Y_cols);
+        }
+        for (const Convolution& convolution : network.convolutions) {
+            CheckModel(!convolution.elements.empty() &&
+                       convolution.others_offsets.size() == convolution.elements.size());
+            size_t convolution_length = 1;
+            for (const PositionOfSavedEmu& emu : convolution.elements) {
+                CheckSavedEmu(emu, network_num, layout.size);
+                convolution_length += emu.length - 1;
+            }
+            CheckModel(convolution_length <= network.Y_cols);
+            for (size_t element = 0; element < convolution.elements.size(); ++element) {
+                CheckModel(IsSpanInRange(convolution.others_offsets[element],
+                                         convolution_length - convolution.elements[element].length + 1,
+                                         network.convolution_others_size));
+            }
+        }
+
+        CheckModel(network.saved_mids_offset <= layout.size &&
+                   network.usefull_emus.size() <= (layout.size - network.saved_mids_offset) / network.Y_cols);
+        for (int emu : network.usefull_emus) {
+            CheckModel(IsInRange(emu, network.A_rows));
+        }
+        for (const FinalEmu& final_emu : network.final_emus) {
+            CheckModel(IsInRange(final_emu.order_in_X, network.A_rows) &&
+                       IsInRange(final_emu.position_in_result, parameters.measured_isotopes.size()) &&
+                       (final_emu.correction_matrix.rows() == 0 ||
+                        static_cast<size_t>(final_emu.correction_matrix.cols()) == network.Y_cols));
+        }
+
+        size_t total_A_values = network.A_rows * network.A_cols;
+        size_t total_B_values = network.B_rows * network.B_cols;
+        if (network.size == NetworkSize::big) {
+            CheckModel(static_cast<size_t>(network.A_pattern.rows()) == network.A_rows &&
+                       static_cast<size_t>(network.A_pattern.cols()) == network.A_cols &&
+                       static_cast<size_t>(network.B_pattern.rows()) == network.B_rows &&
+                       static_cast<size_t>(network.B_pattern.cols()) == network.B_cols);
+            total_A_values = network.A_pattern.nonZeros();
+            total_B_values = network.B_pattern.nonZeros();
+        }
+        CheckFluxMatrixOperator(network.A_operator, total_A_values, network.A_rows, network.A_cols,
+                                total_free_fluxes);
+        CheckFluxMatrixOperator(network.B_operator, total_B_values, network.B_rows, network.B_cols,
+                                total_free_fluxes);
+    }
+}
+
+// FNV-1a, the hash starts from the offset basis
+const std::uint64_t hash_offset_basis = 0xcbf29ce484222325ull;
+
+void AddToHash(const char* data, size_t size, std::uint64_t& hash) {
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 0x100000001b3ull;
+    }
+}
+
+// the derived data depends on the modeller and on the floating point code of the compiler,
+// so the models compiled by another build aren't reused
+std::string GetBuildId() {
+#ifdef __VERSION__
+    const std::string compiler = __VERSION__;
+#else
+    const std::string compiler = "unknown compiler";
+#endif
+    return "khnum modeller " + std::to_string(modeller_version) + ", " + compiler;
+}
+}
+
+CompiledModel CompileModel(IParser& parser, const RunSettings& settings) {
+    parser.Parse();
+
+    Modeller modeller(parser.GetResults());
+    modeller.CalculateInputSubstrateMids();
+    modeller.CreateEmuNetworks();
+    modeller.CreateNullspaceMatrix();
+    modeller.CalculateFluxBounds(settings.total_threads);
+    modeller.CalculateMeasurementsCount();
+    modeller.CheckModelForErrors();
+
+    CompiledModel model;
+    model.problem = modeller.GetProblem();
+    SimulatorGenerator generator(model.problem.simulator_parameters_);
+    model.networks = generator.GetNetworkData();
+    model.mid_arena_layout = generator.GetMidArenaLayout();
+    ApplyRunSettings(settings, model);
+    return model;
+}
+
+void ApplyRunSettings(const RunSettings& settings, CompiledModel& model) {
+    Problem& problem = model.problem;
+    problem.use_analytic_jacobian = settings.use_analytic_jacobian;
+    problem.least_squares_solver = settings.least_squares_solver;
+    problem.jacobian_threads = settings.jacobian_threads;
+    problem.total_starts = settings.total_starts;
+    problem.multistart_threads = settings.multistart_threads;
+    problem.starts_seed = settings.starts_seed;
+    problem.start_points_method = settings.start_points_method;
+    problem.simulator_parameters_.big_network_solver = settings.big_network_solver;
+    problem.simulator_parameters_.total_threads = settings.total_threads;
+}
+
+SimulatorGenerator CreateSimulatorGenerator(const CompiledModel& model) {
+    return SimulatorGenerator(model.problem.simulator_parameters_, model.networks, model.mid_arena_layout);
+}
+
+std::uint64_t HashModelFiles(const std::string& model_path) {
+    namespace fs = std::filesystem;
+    if (!fs::is_directory(model_path)) {
+        throw std::runtime_error("There is no model directory " + model_path);
+    }
+
+    std::vector<fs::path> files;
+    for (const fs::directory_entry& entry : fs::recursive_directory_iterator(model_path)) {
+        const std::string name = entry.path().filename().string();
+        if (entry.is_regular_file() && name.compare(0, compiled_model_file_name.size(), compiled_model_file_name) != 0) {
+            files.push_back(fs::relative(entry.path(), model_path));
+        }
+    }
+    std::sort(files.begin(), files.end());
+
+    std::uint64_t hash = hash_offset_basis;
+    const std::string build_id = GetBuildId();
+    AddToHash(build_id.c_str(), build_id.size() + 1, hash);
+    for (const fs::path& file : files) {
+        const std::string name = file.generic_string();
+        AddToHash(name.c_str(), name.size() + 1, hash);
+
+        std::ifstream input(fs::path(model_path) / file, std::ios::binary);
+        const std::string content((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+        AddToHash(content.data(), content.size(), hash);
+    }
+    return hash;
+}
+
+void SaveCompiledModel(const std::string& path, const CompiledModel& model, std::uint64_t input_hash) {
+    ModelWriter model_writer;
+    model_writer.Write(model.problem);
+    model_writer.Write(model.networks);
+    model_writer.Write(model.mid_arena_layout);
+
+    BinaryWriter writer;
+    writer.Write(compiled_model_magic);
+    writer.Write(compiled_model_version);
+    writer.Write(input_hash);
+    model_writer.WriteTo(writer);
+
+    // the readers never see a partially written file
+    const std::string temporary_path = path + ".tmp";
+    {
+        std::ofstream output(temporary_path, std::ios::binary | std::ios::trunc);
+        output.write(writer.GetBuffer().data(), writer.GetBuffer().size());
+        if (!output) {
+            throw std::runtime_error("Can't write the compiled model to " + temporary_path);
+        }
+    }
+    std::filesystem::rename(temporary_path, path);
+}
+
+std::optional<CompiledModel> LoadCompiledModel(const std::string& path, std::uint64_t input_hash) {
+    std::ifstream input(path, std::ios::binary | std::ios::ate);
+    if (!input) {
+        return std::nullopt;
+    }
+    std::string buffer(static_cast<size_t>(input.tellg()), '\0');
+    input.seekg(0);
+    input.read(&buffer[0], buffer.size());
+    if (!input) {
+        throw std::runtime_error("Can't read the compiled model from " + path);
+    }
+
+    BinaryReader reader(buffer.data(), buffer.size());
+    if (reader.Read<Magic>() != compiled_model_magic) {
+        throw std::runtime_error(path + " isn't a compiled model");
+    }
+    if (reader.Read<std::uint32_t>() != compiled_model_version || reader.Read<std::uint64_t>() != input_hash) {
+        return std::nullopt;
+    }
+
+    CompiledModel model;
+    ModelReader model_reader(reader);
+    model_reader.Read(model.problem);
+    model_reader.Read(model.networks);
+    model_reader.Read(model.mid_arena_layout);
+    CheckModel(reader.IsFinished());
+    CheckNetworks(model);
+    return model;
+}
+
+std::string GetCompiledModelPath(const std::string& model_path, const std::string& cache_directory) {
+    namespace fs = std::filesystem;
+    fs::path model_directory = fs::absolute(model_path).lexically_normal();
+    if (!model_directory.has_filename()) {
+        model_directory = model_directory.parent_path();
+    }
+    std::uint64_t path_hash = hash_offset_basis;
+    const std::string path = model_directory.generic_string();
+    AddToHash(path.c_str(), path.size(), path_hash);
+
+    std::ostringstream name;
+    name << model_directory.filename().string() << "_" << std::hex << path_hash << "_" << compiled_model_file_name;
+    return (fs::path(cache_directory) / name.str()).string();
+}
+
+CompiledModel LoadOrCompileModel(IParser& parser,
+                                 const std::string& model_path,
+                                 const std::string& cache_directory,
+                                 const RunSettings& settings) {
+    const std::uint64_t input_hash = HashModelFiles(model_path);
+    const std::string compiled_model_path = GetCompiledModelPath(model_path, cache_directory);
+    // a corrupted model is compiled again like a stale one
+    std::optional<CompiledModel> loaded_model;
+    try {
+        loaded_model = LoadCompiledModel(compiled_model_path, input_hash);
+    } catch (const std::runtime_error& error) {
+        std::cerr << "The compiled model is compiled again: " << error.what() << std::endl;
+    }
+    if (loaded_model) {
+        ApplyRunSettings(settings, *loaded_model);
+        return std::move(*loaded_model);
+    }
+
+    CompiledModel model = CompileModel(parser, settings);
+    // the cache is optional, the model is run without it if it can't be saved
+    try {
+        std::filesystem::create_directories(cache_directory);
+        SaveCompiledModel(compiled_model_path, model, input_hash);
+    } catch (const std::runtime_error& error) {
+        const std::string temporary_path = compiled_model_path + ".tmp";
+        std::error_code ignored;
+        if (std::filesystem::is_regular_file(temporary_path, ignored)) {
+            std::filesystem::remove(temporary_path, ignored);
+        }
+        std::cerr << "The compiled model isn't saved: " << error.what() << std::endl;
+    }
+    return model;
+}
+} // namespace khnum
@@ -1,17 +1,20 @@
 #include "interface/cli.h"
 
+#include <algorithm>
 #include <iostream>
 #include <exception>
 #include <vector>
 #include <memory>
+#include <string>
 #include <thread>
 #include "alglib/ap.h"
 #include <chrono>
 
+#include "compiled_model/compiled_model.h"
 #include "simulator/generator.h"
-#include "modeller/modeller.h"
 #include "parser/open_flux_parser/open_flux_parser.h"
-#include "solver/solver.h"
+#include "solver/confidence_intervals.h"
+#include "solver/multistart_solver.h"
 #include "clusterizer/clusterizer.h"
 #include "parser/maranas_parser.h"
 
@@ -19,67 +22,31 @@
 namespace khnum {
 void RunCli() {
     try {
-        //std::unique_ptr<IParser> parser(new ParserOpenFlux("../modelLast"));
-        std::unique_ptr<IParser> parser(new ParserMaranas("../modelMaranas/"));
-        parser->Parse();
-
-        Modeller modeller(parser->GetResults());
-
-        modeller.CalculateInputSubstrateMids();
-        modeller.CreateEmuNetworks();
-        modeller.CreateNullspaceMatrix();
-        modeller.CalculateFluxBounds();
-        modeller.CalculateMeasurementsCount();
-        modeller.CheckModelForErrors();
-
-        Problem problem = modeller.GetProblem();
-        SimulatorGenerator generator(problem.simulator_parameters_);
-        std::vector<alglib::real_1d_array> allSolutions;
-
-        bool use_multithread = false;
-        if (use_multithread) {
-            const unsigned int num_threads = std::thread::hardware_concurrency();
-            std::cout << num_threads << std::endl;
-
-            std::vector<std::vector<alglib::real_1d_array>> one_thread_solutions(num_threads);
-            auto one_thread = [&generator](const Problem &problem, std::vector<alglib::real_1d_array> &result) {
-                Solver solver(problem, generator);
-                solver.Solve();
-                result = solver.GetResult();
-            };
-
-            std::vector<std::thread> threads;
-            for (int i = 0; i < num_threads; ++i) {
-                threads.push_back(std::thread(one_thread, std::ref(problem), std::ref(one_thread_solutions[i])));
-            }
-            std::chrono::time_point<std::chrono::system_clock> start, end;
-            start = std::chrono::system_clock::now();
-            for (std::thread &t : threads) {
-                t.join();
-            }
-            end = std::chrono::system_clock::now();
-            double elapsed_milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>
-                    (end-start).count();
-
-            elapsed_milliseconds /= 1000;
-            std::cout << "Average time: " << static_cast<double>(elapsed_milliseconds) / (num_threads * 30)
-                << " seconds per iteration" << std::endl;
-
-            for (const auto &vec : one_thread_solutions) {
-                for (const alglib::real_1d_array &solution : vec) {
-                    allSolutions.push_back(solution);
-                }
-            }
-
-        } else {
-            Solver solver(problem, generator);
-            solver.Solve();
-            allSolutions = solver.GetResult();
-        }
+        //const std::string model_path = "../modelLast";
+        //std::unique_ptr<IParser> parser(new ParserOpenFlux(model_path));
+        const std::string model_path = "../modelMaranas/";
+        std::unique_ptr<IParser> parser(new ParserMaranas(model_path));
+
+        // the model is parsed and compiled only if its files have changed since the last run,
+        // the settings of this run are applied to the loaded model.
+        // The compiled models are kept in the working directory, which is the build directory
+        const std::string cache_directory = "compiled_models";
+        RunSettings settings;
+        // the starts and the confidence intervals are run on every core, each start simulates on its own thread
+        settings.multistart_threads = std::max(1u, std::thread::hardware_concurrency());
+        CompiledModel model = LoadOrCompileModel(*parser, model_path, cache_directory, settings);
+        SimulatorGenerator generator = CreateSimulatorGenerator(model);
+        MultistartSolver solver(model.problem, generator);
+        std::vector<alglib::real_1d_array> allSolutions = solver.Solve();
 
         Clasterizer clusterizer(allSolutions);
         clusterizer.Start();
 
+        ConfidenceIntervalsParameters intervals_parameters;
+        intervals_parameters.total_threads = settings.multistart_threads;
+        ConfidenceIntervalsCalculator intervals_calculator(model.problem, generator, intervals_parameters);
+        PrintConfidenceIntervals(intervals_calculator.Calculate(allSolutions));
+
 /*
         reactions = SortReactionByID(reactions);
 
@@ -1,8 +1,10 @@
 #include "modeller/calculate_flux_bounds.h"
 
+#include <algorithm>
+#include <cmath>
 #include <vector>
+#include <thread>
 #include <glpk/glpk.h>
-#include <iostream>
 
 #include "utilities/reaction.h"
 #include "utilities/matrix.h"
@@ -10,17 +12,83 @@
 
 namespace khnum {
 namespace modelling_utills {
+namespace {
+struct FluxRange {
+    double min = 0.0;
+    double max = 0.0;
+    bool is_found = false;
+};
+
+// Returns false if there is no optimal solution, a singular basis is replaced by the standard one once
+bool SolveLinearProblem(glp_prob* linear_problem, const glp_smcp& parameters) {
+    if (glp_simplex(linear_problem, &parameters) != 0) {
+        glp_std_basis(linear_problem);
+        if (glp_simplex(linear_problem, &parameters) != 0) {
+            return false;
+        }
+    }
+    return glp_get_status(linear_problem) == GLP_OPT;
+}
+
+// Solves max and min of the fluxes [begin, end) on a copy of the problem.
+// Only one objective coefficient changes between the solves, so every simplex starts from the previous basis
+void CalculateFluxRanges(glp_prob* problem_template, int begin, int end, std::vector<FluxRange>* ranges) {
+    glp_term_out(GLP_OFF);
+    glp_prob* linear_problem = glp_create_prob();
+    glp_copy_prob(linear_problem, problem_template, GLP_OFF);
+
+    glp_smcp parameters;
+    glp_init_smcp(&parameters);
+    parameters.msg_lev = GLP_MSG_OFF;
+
+    for (int reaction = begin; reaction < end; ++reaction) {
+        FluxRange& range = (*ranges)[reaction];
+        glp_set_obj_coef(linear_problem, reaction + 1, 1.0);
+
+        glp_set_obj_dir(linear_problem, GLP_MAX);
+        const bool is_max_found = SolveLinearProblem(linear_problem, parameters);
+        range.max = glp_get_obj_val(linear_problem);
+
+        glp_set_obj_dir(linear_problem, GLP_MIN);
+        const bool is_min_found = SolveLinearProblem(linear_problem, parameters);
+        range.min = glp_get_obj_val(linear_problem);
+
+        range.is_found = is_max_found && is_min_found;
+        glp_set_obj_coef(linear_problem, reaction + 1, 0.0);
+    }
+
+    glp_delete_prob(linear_problem);
+}
+
+void SetDefaultBounds(Reaction& reaction) {
+    if (std::isnan(reaction.basis)) {
+        reaction.computed_upper_bound = reaction.setted_upper_bound ? *reaction.setted_upper_bound : 125;
+        reaction.computed_lower_bound = reaction.setted_lower_bound ? *reaction.setted_lower_bound : 0.001;
+    } else {
+        if (std::isnan(reaction.deviation)) {
+            reaction.computed_lower_bound = reaction.basis;
+            reaction.computed_upper_bound = reaction.basis;
+        } else {
+            reaction.computed_upper_bound = reaction.basis + reaction.deviation;
+            reaction.computed_lower_bound = reaction.basis - reaction.deviation;
+        }
+    }
+}
+}
 
 
-// We find upper bound for ith flux in such way:
+// Flux variability analysis, we find upper bound for ith flux in such way:
 
 // maximize w_i * x
 // subject to S * v = 0
-// where x > 0
+// where LB < x < UB
 // and w_i = (0, 0, ... 0, 1, 0, ... 0) with 1 in ith position
 
+// and the lower bound by minimization. The default bounds are narrowed to these ranges,
+// they are kept if the linear problem has no solution or the ranges don't intersect them.
+
 // First reactions in the vector are metabolic balance reactions, so we don't calculate bounds for them
-void CalculateFluxBounds(std::vector<Reaction>& reactions, const Matrix& stoichiometry_matrix) {
+void CalculateFluxBounds(std::vector<Reaction>& reactions, const SparseMatrix& stoichiometry_matrix, size_t total_threads) {
     glp_term_out(GLP_OFF);
     glp_prob* linear_problem = glp_create_prob();
 
@@ -28,48 +96,48 @@ void CalculateFluxBounds(std::vector<Reaction>& reactions, const Matrix& stoichi
 
     const int total_reactions_with_bounds = stoichiometry_matrix.cols();
     const int metabolite_balance_reactions_total = reactions.size() - total_reactions_with_bounds;
-    for (int reaction = 0; reaction < total_reactions_with_bounds; ++reaction) {
-        // Set w_i vector
-        for (int i = 0; i < total_reactions_with_bounds; ++i) {
-            if (i == reaction) {
-                glp_set_obj_coef(linear_problem, i + 1, 1.0);
-            } else {
-                glp_set_obj_coef(linear_problem, i + 1, 0.0);
-            }
+
+    // Every thread has its own glpk environment, which is freed when the thread is finished
+    std::vector<FluxRange> ranges(total_reactions_with_bounds);
+    const int total_workers = std::max(1, std::min<int>(total_threads, total_reactions_with_bounds));
+    if (total_workers == 1) {
+        CalculateFluxRanges(linear_problem, 0, total_reactions_with_bounds, &ranges);
+    } else {
+        // glp_copy_prob creates the factorization parameters of the source on the first call,
+        // after that the copies only read it
+        glp_bfcp factorization_parameters;
+        glp_get_bfcp(linear_problem, &factorization_parameters);
+
+        std::vector<std::thread> workers;
+        for (int worker = 0; worker < total_workers; ++worker) {
+            const int begin = total_reactions_with_bounds * worker / total_workers;
+            const int end = total_reactions_with_bounds * (worker + 1) / total_workers;
+            workers.emplace_back([linear_problem, begin, end, &ranges] {
+                CalculateFluxRanges(linear_problem, begin, end, &ranges);
+                glp_free_env();
+            });
         }
-        glp_set_obj_dir(linear_problem, GLP_MAX);
-        glp_simplex(linear_problem, NULL);
-        // reactions[reaction + metabolite_balance_reactions_total].computed_upper_bound = glp_get_obj_val(linear_problem);
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+    }
+    glp_delete_prob(linear_problem);
+
+    for (int reaction = 0; reaction < total_reactions_with_bounds; ++reaction) {
         Reaction& rea = reactions[reaction + metabolite_balance_reactions_total];
+        SetDefaultBounds(rea);
 
-        if (std::isnan(rea.basis)) {
-            double upper_bound = rea.setted_upper_bound ?
-                                 *rea.setted_upper_bound : 125;
-            double lower_bound = rea.setted_lower_bound ?
-                                 *rea.setted_lower_bound : 0.001;
-            rea.computed_upper_bound = upper_bound;
+        const FluxRange& range = ranges[reaction];
+        const double lower_bound = std::max(rea.computed_lower_bound, range.min);
+        const double upper_bound = std::min(rea.computed_upper_bound, range.max);
+        if (range.is_found && lower_bound <= upper_bound) {
             rea.computed_lower_bound = lower_bound;
-        } else {
-            if (std::isnan(rea.deviation)) {
-                rea.computed_lower_bound = rea.basis;
-                rea.computed_upper_bound = rea.basis;
-            } else {
-                double upper_bound  = rea.basis + rea.deviation;
-                double lower_bound = rea.basis - rea.deviation;
-                rea.computed_upper_bound = rea.basis + rea.deviation;
-                rea.computed_lower_bound = rea.basis - rea.deviation;
-            }
+            rea.computed_upper_bound = upper_bound;
         }
-
-        glp_set_obj_dir(linear_problem, GLP_MIN);
-        glp_simplex(linear_problem, NULL);
-        // reactions[reaction + metabolite_balance_reactions_total].computed_lower_bound = glp_get_obj_val(linear_problem);
     }
-
-    glp_delete_prob(linear_problem);
 }
 
-void PrepareLinearProblem(std::vector<Reaction>& reactions, const Matrix& stoichiometry_matrix, glp_prob* linear_problem) {
+void PrepareLinearProblem(std::vector<Reaction>& reactions, const SparseMatrix& stoichiometry_matrix, glp_prob* linear_problem) {
     // Set LB < xi < UB
     glp_add_cols(linear_problem, stoichiometry_matrix.cols());
     const int total_reactions_with_bounds = stoichiometry_matrix.cols();
@@ -99,15 +167,17 @@ void PrepareLinearProblem(std::vector<Reaction>& reactions, const Matrix& stoich
         glp_set_row_bnds(linear_problem, row + 1, GLP_FX, 0.0, 0.0);
     }
 
-    // Fill S matrix
+    // Fill S matrix row by row
+    const Eigen::SparseMatrix<double, Eigen::RowMajor> rows_matrix = stoichiometry_matrix;
     std::vector<int> row_index = {0};
     std::vector<int> col_index = {0};
     std::vector<double> coefficients = {0.0};
-    for (int row = 0; row < stoichiometry_matrix.rows(); ++row) {
-        for (int col = 0; col < stoichiometry_matrix.cols(); ++col) {
+    for (int row = 0; row < rows_matrix.rows(); ++row) {
+        for (Eigen::SparseMatrix<double, Eigen::RowMajor>::InnerIterator coefficient(rows_matrix, row);
+             coefficient; ++coefficient) {
             row_index.push_back(row + 1);
-            col_index.push_back(col + 1);
-            coefficients.push_back(stoichiometry_matrix(row, col));
+            col_index.push_back(coefficient.col() + 1);
+            coefficients.push_back(coefficient.value());
         }
     }
     glp_load_matrix(linear_problem, (coefficients.size() - 1), row_index.data(),
@@ -115,4 +185,4 @@ void PrepareLinearProblem(std::vector<Reaction>& reactions, const Matrix& stoich
                     coefficients.data());
 }
 }
-}
\ No newline at end of file
+}
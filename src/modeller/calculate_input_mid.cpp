@@ -15,10 +15,11 @@ std::vector<EmuAndMid> CalculateInputMid(const std::vector<InputSubstrate> &inpu
     std::vector<EmuAndMid> input_mids;
     for (const Emu &input_emu : input_emus) {
         // find input substrate with such name
+        const std::string& name = GetMetaboliteName(input_emu.metabolite);
         auto input_substrate_iterator = std::find_if(input_substrates.begin(),
                                                      input_substrates.end(),
-                                                     [input_emu](const InputSubstrate &input_substrate) {
-                                                         return input_substrate.name == input_emu.name;
+                                                     [&name](const InputSubstrate &input_substrate) {
+                                                         return input_substrate.name == name;
                                                      });
 
         EmuAndMid new_mid = CalculateOneMid(*input_substrate_iterator, input_emu);
@@ -39,8 +40,8 @@ EmuAndMid CalculateOneMid(const InputSubstrate &input_substrate,
     // Find atom positions included in input_emu
     // For our example included_atoms = [0, 2]
     std::vector<int> included_atoms;
-    for (size_t i = 0; i < input_emu.atom_states.size(); ++i) {
-        if (input_emu.atom_states[i]) {
+    for (int i = 0; i < input_emu.total_atoms; ++i) {
+        if (IsAtomIncluded(input_emu, i)) {
             included_atoms.push_back(i);
         }
     }
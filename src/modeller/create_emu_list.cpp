@@ -16,7 +16,7 @@ std::vector<Emu> CreateInputEmuList(const std::vector<EmuReaction> &reactions,
     for (const EmuReaction &reaction : reactions) {
         // check the left side
         for (const EmuSubstrate &emu_substrate : reaction.left) {
-            std::string emu_name = emu_substrate.emu.name;
+            const std::string& emu_name = GetMetaboliteName(emu_substrate.emu.metabolite);
             for (const InputSubstrate &input_substrate : input_substrates) {
                 if (input_substrate.name == emu_name) {
                     input_emu_list.push_back(emu_substrate.emu);
@@ -26,7 +26,7 @@ std::vector<Emu> CreateInputEmuList(const std::vector<EmuReaction> &reactions,
         }
 
         // check the right side
-        std::string emu_name = reaction.right.emu.name;
+        const std::string& emu_name = GetMetaboliteName(reaction.right.emu.metabolite);
         for (const InputSubstrate &input_substrate : input_substrates) {
             if (input_substrate.name == emu_name) {
                 input_emu_list.push_back(reaction.right.emu);
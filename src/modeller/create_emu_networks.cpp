@@ -7,6 +7,7 @@
 
 #include "utilities/emu.h"
 #include "utilities/emu_and_mid.h"
+#include "utilities/emu_index.h"
 #include "utilities/debug_utills/debug_prints.h"
 
 
@@ -26,9 +27,15 @@ std::vector<EmuNetwork> CreateEmuNetworks(const std::vector<EmuReaction> &reacti
         emus_to_check.push(measured_isotope);
     }
 
-    std::vector<Emu> already_checked_emus;
+    EmuIndex<bool> already_checked_emus;
     for (const Emu &emu : input_emu_list) {
-        already_checked_emus.push_back(emu);
+        already_checked_emus.Insert(emu, true);
+    }
+
+    // reactions producing the emu in the order of the reactions list
+    EmuIndex<std::vector<size_t>> synthesis_reactions;
+    for (size_t reaction = 0; reaction < reactions.size(); ++reaction) {
+        synthesis_reactions.Insert(reactions[reaction].right.emu, {}).push_back(reaction);
     }
 
     while (!emus_to_check.empty()) {
@@ -36,21 +43,23 @@ std::vector<EmuNetwork> CreateEmuNetworks(const std::vector<EmuReaction> &reacti
         emus_to_check.pop();
         int emu_size = GetEmuSize(next_emu);
 
-        if (IsEmuAlreadyChecked(next_emu, already_checked_emus)) {
+        if (already_checked_emus.Contains(next_emu)) {
             continue;
         }
 
-        for (const EmuReaction &emu_reaction : reactions) {
-            if (emu_reaction.right.emu == next_emu) {
+        const std::vector<size_t>* next_emu_reactions = synthesis_reactions.Find(next_emu);
+        if (next_emu_reactions) {
+            for (size_t reaction : *next_emu_reactions) {
+                const EmuReaction &emu_reaction = reactions[reaction];
                 emu_networks[emu_size - 1].push_back(emu_reaction);
                 for (const EmuSubstrate &emu_substrate : emu_reaction.left) {
-                    if (!IsEmuAlreadyChecked(emu_substrate.emu, already_checked_emus)) {
+                    if (!already_checked_emus.Contains(emu_substrate.emu)) {
                         emus_to_check.push(emu_substrate.emu);
                     }
                 }
             }
         }
-        already_checked_emus.push_back(next_emu);
+        already_checked_emus.Insert(next_emu, true);
     }
 
     // remove empty networks
@@ -78,25 +87,5 @@ int FindLargestEmuSize(const std::vector<EmuReaction> &reactions) {
     return max_size;
 }
 
-
-int GetEmuSize(const Emu &emu) {
-    int size = 0;
-    for (bool state : emu.atom_states) {
-        if (state) {
-            ++size;
-        }
-    }
-
-    return size;
-}
-
-
-bool IsEmuAlreadyChecked(const Emu &emu, const std::vector<Emu> &already_checked_emus) {
-    auto emu_position = find(already_checked_emus.begin(),
-                             already_checked_emus.end(),
-                             emu);
-    return emu_position != already_checked_emus.end();
-}
-
 } // namespace modelling_utills
 } // namespace khnum
\ No newline at end of file
@@ -4,163 +4,235 @@
 #include <string>
 #include <queue>
 #include <exception>
-#include <set>
 #include <algorithm>
 #include <iostream>
-#include <map>
+#include <numeric>
+#include <unordered_map>
 
 #include "utilities/emu.h"
+#include "utilities/emu_index.h"
 #include "utilities/reaction.h"
 #include "utilities/debug_utills/debug_prints.h"
 
 
 namespace khnum {
 namespace modelling_utills {
+namespace {
+// Groups the transitions to the product by its atoms keeping their order
+ProductTransitions CreateProductTransitions(const Reaction &reaction, size_t position) {
+    const ChemicalEquation &equation = reaction.chemical_equation;
+    const Substrate &product = equation.right[position];
+
+    // the equal substrates share the atom transitions of the first of them
+    const int transitions_position = std::find(equation.right.begin(), equation.right.end(), product) -
+                                     equation.right.begin();
+    auto is_product_transition = [transitions_position](const AtomTransition &transition) {
+        return transition.product_pos == transitions_position && transition.product_atom >= 0;
+    };
+
+    // the size of the substrates without atom transitions may be unknown, so the atoms are counted by the transitions
+    int total_atoms = 0;
+    for (const AtomTransition &transition : equation.atom_transitions) {
+        if (is_product_transition(transition)) {
+            total_atoms = std::max(total_atoms, transition.product_atom + 1);
+        }
+    }
+
+    ProductTransitions result;
+    result.coefficient = product.substrate_coefficient_;
+    result.atom_offsets.assign(total_atoms + 1, 0);
+    for (const AtomTransition &transition : equation.atom_transitions) {
+        if (is_product_transition(transition)) {
+            ++result.atom_offsets[transition.product_atom + 1];
+        }
+    }
+    std::partial_sum(result.atom_offsets.begin(), result.atom_offsets.end(), result.atom_offsets.begin());
+
+    result.transitions.resize(result.atom_offsets.back());
+    std::vector<size_t> next_transition(result.atom_offsets.begin(), result.atom_offsets.end() - 1);
+    for (const AtomTransition &transition : equation.atom_transitions) {
+        if (is_product_transition(transition)) {
+            result.transitions[next_transition[transition.product_atom]++] = transition;
+        }
+    }
+    return result;
+}
+
+std::vector<int> GetPrecursorIds(const Reaction &reaction) {
+    std::vector<int> precursors;
+    for (const Substrate &precursor : reaction.chemical_equation.left) {
+        precursors.push_back(GetMetaboliteId(precursor.name));
+    }
+    return precursors;
+}
+
+// the coefficients are compared with a tolerance, so only the emus are hashed
+size_t GetEmuReactionHash(const EmuReaction &reaction) {
+    const EmuHash emu_hash;
+    size_t hash = std::hash<int>()(reaction.id) ^ emu_hash(reaction.right.emu);
+    for (const EmuSubstrate &precursor : reaction.left) {
+        hash = hash * 31 + emu_hash(precursor.emu);
+    }
+    return hash;
+}
+}
+
 std::vector<EmuReaction> CreateAllEmuReactions(const std::vector<Reaction> &reactions,
                                                const std::vector<Emu> &measured_isotopes) {
     std::vector<EmuReaction> all_emu_reactions;
 
+    const SynthesisIndex synthesis_index = CreateSynthesisIndex(reactions);
+
     // contains all EMUs for finding their synthesis reactions
     std::queue<Emu> emu_to_check;
 
     // contains checked EMUs
-    std::set<Emu, decltype(&comparator)> already_checked_emu(&comparator);
+    EmuIndex<bool> already_checked_emu;
 
     for (const Emu &emu : measured_isotopes) { // initializing queue
         emu_to_check.push(emu);
     }
 
     while (!emu_to_check.empty()) {
-        Emu next_emu = emu_to_check.front();
+        const Emu next_emu = emu_to_check.front();
         emu_to_check.pop();
 
-        if (already_checked_emu.find(next_emu) == already_checked_emu.end()) {
-            // find all reactions which synthesize the next_emu
-            std::vector<Reaction> synthesis_reactions = GetSynthesisReactions(reactions, next_emu);
+        if (already_checked_emu.Contains(next_emu)) {
+            continue;
+        }
 
-            for (const Reaction &reaction : synthesis_reactions) {
-                std::vector<EmuReaction> new_emu_reactions = CreateNewEmuReactions(reaction, next_emu);
-                for (const EmuReaction &emu_reaction : new_emu_reactions) {
-                    all_emu_reactions.push_back(emu_reaction);
+        auto synthesis_reactions = synthesis_index.find(next_emu.metabolite);
+        if (synthesis_reactions != synthesis_index.end()) {
+            for (const SynthesisReaction &reaction : synthesis_reactions->second) {
+                for (EmuReaction &emu_reaction : CreateNewEmuReactions(reaction, next_emu)) {
                     AddNewEmusInQueue(&emu_to_check, already_checked_emu, emu_reaction.left);
+                    all_emu_reactions.push_back(std::move(emu_reaction));
                 }
             }
-            already_checked_emu.insert(next_emu);
         }
+        already_checked_emu.Insert(next_emu, true);
     }
     return all_emu_reactions;
 }
 
 
-std::vector<Reaction> GetSynthesisReactions(const std::vector<Reaction> &reactions,
-                                            const Emu &emu) {
-    std::vector<Reaction> synthesis_reactions;
+SynthesisIndex CreateSynthesisIndex(const std::vector<Reaction> &reactions) {
+    SynthesisIndex synthesis_index;
     for (const Reaction &reaction : reactions) {
-        if (reaction.type != ReactionType::MetaboliteBalance) {
-            bool is_reaction_produce_emu = false;
-            for (const Substrate &substrate : reaction.chemical_equation.right) {
-                if (substrate.name == emu.name) {
-                    is_reaction_produce_emu = true;
-                    break;
-                }
+        if (reaction.type == ReactionType::MetaboliteBalance) {
+            continue;
+        }
+        const std::vector<int> precursors = GetPrecursorIds(reaction);
+        const ChemicalEquationSide &right = reaction.chemical_equation.right;
+        for (size_t position = 0; position < right.size(); ++position) {
+            std::vector<SynthesisReaction> &synthesis_reactions = synthesis_index[GetMetaboliteId(right[position].name)];
+            if (synthesis_reactions.empty() || synthesis_reactions.back().reaction != &reaction) {
+                synthesis_reactions.push_back({&reaction, precursors, {}});
             }
+            synthesis_reactions.back().products.push_back(CreateProductTransitions(reaction, position));
+        }
+    }
+    return synthesis_index;
+}
 
-            if (is_reaction_produce_emu) {
-                synthesis_reactions.push_back(reaction);
-            }
+
+SynthesisReaction CreateSynthesisReaction(const Reaction &reaction, int metabolite) {
+    SynthesisReaction synthesis_reaction{&reaction, GetPrecursorIds(reaction), {}};
+    const ChemicalEquationSide &right = reaction.chemical_equation.right;
+    for (size_t position = 0; position < right.size(); ++position) {
+        if (GetMetaboliteId(right[position].name) == metabolite) {
+            synthesis_reaction.products.push_back(CreateProductTransitions(reaction, position));
         }
     }
-    return synthesis_reactions;
+    return synthesis_reaction;
 }
 
 
-std::vector<EmuReaction> CreateNewEmuReactions(const Reaction &reaction,
+std::vector<EmuReaction> CreateNewEmuReactions(const SynthesisReaction &reaction,
                                                const Emu &emu) {
     std::vector<EmuReaction> new_emu_reactions;
-
-    // find all occurrences of the emu in the reaction
-    for (const Substrate &substrate : reaction.chemical_equation.right) {
-        if (substrate.name == emu.name) {
-            new_emu_reactions.push_back(CreateOneEmuReaction(reaction, substrate, emu));
-        }
+    for (const ProductTransitions &product : reaction.products) {
+        new_emu_reactions.push_back(CreateOneEmuReaction(reaction, product, emu));
     }
 
-    std::vector<EmuReaction> unique_emu_reactions = SelectUniqueEmuReactions(new_emu_reactions);
-    return unique_emu_reactions;
+    if (new_emu_reactions.size() == 1) {
+        return new_emu_reactions;
+    }
+    return SelectUniqueEmuReactions(new_emu_reactions);
 }
 
 
-EmuReaction CreateOneEmuReaction(const Reaction &reaction,
-                                 const Substrate &substrate,
-                                 const Emu &emu) {
-    EmuReaction result_reaction;
-    result_reaction.id = reaction.id;
-    Rate rate = 1.0;
-
-    auto substrate_iterator = std::find(reaction.chemical_equation.right.begin(),
-                                        reaction.chemical_equation.right.end(), substrate);
+std::vector<EmuReaction> CreateNewEmuReactions(const Reaction &reaction,
+                                               const Emu &emu) {
+    return CreateNewEmuReactions(CreateSynthesisReaction(reaction, emu.metabolite), emu);
+}
 
-    const int substrate_pos = substrate_iterator - reaction.chemical_equation.right.begin();
 
-    // form right side
-    EmuSubstrate product;
-    product.emu = emu;
-    product.coefficient = substrate.substrate_coefficient_;
-    result_reaction.right = product;
-    rate *= product.coefficient;
+EmuReaction CreateOneEmuReaction(const SynthesisReaction &reaction,
+                                 const ProductTransitions &product,
+                                 const Emu &emu) {
+    const ChemicalEquationSide &left = reaction.reaction->chemical_equation.left;
 
-    EmuReactionSide left_side;
+    EmuReaction result_reaction;
+    result_reaction.id = reaction.reaction->id;
+    result_reaction.right.emu = emu;
+    result_reaction.right.coefficient = product.coefficient;
+    result_reaction.rate = product.coefficient;
 
-    // contains all substrates that already included in the equation's left side
-    // and their position
-    std::map<int, int> reactionpos2emupos;
+    // positions of the substrates in the left side of the emu reaction by their positions in the reaction
+    std::vector<int> emu_positions(left.size(), -1);
     // form left side
-    // find sources of all atoms included in the emu
-    for (size_t atom_position = 0; atom_position < emu.atom_states.size(); ++atom_position) {
-        if (emu.atom_states[atom_position]) {
-            std::vector<AtomTransition> transitions;
-            for (const AtomTransition &transition: reaction.chemical_equation.atom_transitions) {
-                if (transition.product_pos == substrate_pos && transition.product_atom == atom_position) {
-                    transitions.push_back(transition);
-                }
-            }
-
-            for (const AtomTransition &transition : transitions) {
-                if (reactionpos2emupos.find(transition.substrate_pos) != reactionpos2emupos.end()) {
-                    left_side[reactionpos2emupos[transition.substrate_pos]].emu.atom_states[transition.substrate_atom] = true;
-                } else {
-                    const Substrate &precursor = reaction.chemical_equation.left[transition.substrate_pos];
-                    EmuSubstrate new_precursor;
-                    new_precursor.emu.name = precursor.name;
-                    new_precursor.emu.atom_states = AtomStates(precursor.size, false);
-                    new_precursor.emu.atom_states[transition.substrate_atom] = true;
-                    new_precursor.coefficient = precursor.substrate_coefficient_;
-                    left_side.push_back(new_precursor);
-                    reactionpos2emupos.insert({transition.substrate_pos, left_side.size() - 1});
-                }
+    // find sources of all atoms included in the emu, the atoms without transitions have no sources
+    const int total_atoms = std::min(emu.total_atoms, static_cast<int>(product.atom_offsets.size()) - 1);
+    for (int atom_position = 0; atom_position < total_atoms; ++atom_position) {
+        if (!IsAtomIncluded(emu, atom_position)) {
+            continue;
+        }
+        for (size_t i = product.atom_offsets[atom_position]; i < product.atom_offsets[atom_position + 1]; ++i) {
+            const AtomTransition &transition = product.transitions[i];
+            int &emu_position = emu_positions[transition.substrate_pos];
+            if (emu_position < 0) {
+                const Substrate &precursor = left[transition.substrate_pos];
+                EmuSubstrate new_precursor;
+                new_precursor.emu = CreateEmu(reaction.precursors[transition.substrate_pos], precursor.size);
+                new_precursor.coefficient = precursor.substrate_coefficient_;
+                emu_position = result_reaction.left.size();
+                result_reaction.left.push_back(new_precursor);
             }
+            IncludeAtom(result_reaction.left[emu_position].emu, transition.substrate_atom);
         }
     }
-    for (const EmuSubstrate& precursor : result_reaction.left) {
-        rate *= precursor.coefficient;
-    }
-
-    result_reaction.left = left_side;
-    result_reaction.rate = rate;
 
     return result_reaction;
 }
 
 
+EmuReaction CreateOneEmuReaction(const Reaction &reaction,
+                                 const Substrate &substrate,
+                                 const Emu &emu) {
+    const ChemicalEquationSide &right = reaction.chemical_equation.right;
+    const size_t position = std::find(right.begin(), right.end(), substrate) - right.begin();
+    const SynthesisReaction synthesis_reaction{&reaction, GetPrecursorIds(reaction), {}};
+    return CreateOneEmuReaction(synthesis_reaction, CreateProductTransitions(reaction, position), emu);
+}
+
+
 std::vector<EmuReaction> SelectUniqueEmuReactions(const std::vector<EmuReaction> &emu_reactions) {
     std::vector<EmuReaction> unique_emu_reactions;
+    // positions of the unique reactions by their hashes
+    std::unordered_multimap<size_t, size_t> unique_positions;
     for (const EmuReaction &reaction : emu_reactions) {
-        auto reaction_position = std::find(unique_emu_reactions.begin(),
-                                           unique_emu_reactions.end(), reaction);
-        if (reaction_position == unique_emu_reactions.end()) {
+        const size_t hash = GetEmuReactionHash(reaction);
+        auto candidates = unique_positions.equal_range(hash);
+        auto same_reaction = std::find_if(candidates.first, candidates.second,
+                                          [&unique_emu_reactions, &reaction](const auto &candidate) {
+                                              return unique_emu_reactions[candidate.second] == reaction;
+                                          });
+        if (same_reaction == candidates.second) {
+            unique_positions.emplace(hash, unique_emu_reactions.size());
             unique_emu_reactions.push_back(reaction);
         } else {
-            reaction_position->rate += reaction.rate;
+            unique_emu_reactions[same_reaction->second].rate += reaction.rate;
         }
     }
 
@@ -169,14 +241,14 @@ std::vector<EmuReaction> SelectUniqueEmuReactions(const std::vector<EmuReaction>
 
 
 void AddNewEmusInQueue(std::queue<Emu> *queue,
-                       const std::set<Emu, decltype(&comparator)> &already_checked_emu,
+                       const EmuIndex<bool> &already_checked_emu,
                        const EmuReactionSide &reaction_side) {
     for (EmuSubstrate const &substrate : reaction_side) {
-        if (already_checked_emu.find(substrate.emu) == already_checked_emu.end()) {
+        if (!already_checked_emu.Contains(substrate.emu)) {
             queue->push(substrate.emu);
         }
     }
 
 }
 } // namespace modelling_utills
-} // namespace khnum
\ No newline at end of file
+} // namespace khnum
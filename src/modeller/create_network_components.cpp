@@ -5,82 +5,139 @@
 #include <iostream>
 
 #include "utilities/emu.h"
+#include "utilities/emu_index.h"
 #include "utilities/debug_utills/debug_prints.h"
 
 namespace khnum {
     namespace modelling_utills {
-        std::vector<EmuNetwork> CreateNetworkComponents(const EmuNetwork &network) {
-            std::vector<EmuNetwork> components;
+        namespace {
+            // emus of the network as vertices with the edges from the precursor to the product
+            struct EmuGraph {
+                EmuIndex<int> vertices;
+                std::vector<std::vector<int>> adjacency;
+            };
 
-            std::vector<Emu> all_emus;
-
-            for (const EmuReaction &reaction : network) {
-                if (reaction.left.size() == 1) {
-                    if (std::find(all_emus.begin(), all_emus.end(), reaction.left[0].emu) == all_emus.end()) {
-                        all_emus.push_back(reaction.left[0].emu);
-                    }
-                }
-
-                if (std::find(all_emus.begin(), all_emus.end(), reaction.right.emu) == all_emus.end()) {
-                    all_emus.push_back(reaction.right.emu);
+            int GetVertex(const Emu &emu, EmuGraph &graph) {
+                const int vertex = graph.vertices.Insert(emu, static_cast<int>(graph.adjacency.size()));
+                if (static_cast<size_t>(vertex) == graph.adjacency.size()) {
+                    graph.adjacency.emplace_back();
                 }
+                return vertex;
             }
 
-            std::vector<size_t> ordered_substrates;
-            std::vector<char> visited(all_emus.size(), false);
-            for (size_t v = 0; v < all_emus.size(); ++v) {
-                if (!visited[v]) {
-                    dfs1(v, network, visited, ordered_substrates, all_emus);
+            EmuGraph CreateEmuGraph(const EmuNetwork &network) {
+                EmuGraph graph;
+                for (const EmuReaction &reaction : network) {
+                    if (reaction.left.size() == 1) {
+                        const int precursor = GetVertex(reaction.left[0].emu, graph);
+                        const int product = GetVertex(reaction.right.emu, graph);
+                        graph.adjacency[precursor].push_back(product);
+                    } else {
+                        GetVertex(reaction.right.emu, graph);
+                    }
                 }
+                return graph;
             }
 
-            visited.assign(all_emus.size(), false);
-            for (int i = 0; i < all_emus.size(); ++i) {
-                int v = ordered_substrates[all_emus.size() - 1 - i];
-                if (!visited[v]) {
-                    std::vector<size_t> vertices_of_component;
-                    dfs2(v, network, visited, vertices_of_component, all_emus);
-                    EmuNetwork component;
-                    for (const EmuReaction &reaction : network) {
-                        for (size_t v : vertices_of_component) {
-                            if (reaction.right.emu == all_emus[v]) {
-                                component.push_back(reaction);
-                                break;
+            // Tarjan numbers the components in the reverse topological order
+            std::vector<int> FindComponents(const std::vector<std::vector<int>> &adjacency, int &total_components) {
+                const int total_vertices = adjacency.size();
+                std::vector<int> order(total_vertices, -1);
+                std::vector<int> lowlink(total_vertices, 0);
+                std::vector<int> components(total_vertices, -1);
+                std::vector<char> is_on_stack(total_vertices, false);
+                std::vector<int> stack;
+
+                // the recursion is replaced by the stack of the vertices with their next edges
+                struct Frame {
+                    int vertex;
+                    size_t next_edge;
+                };
+                std::vector<Frame> frames;
+
+                int next_order = 0;
+                total_components = 0;
+                auto visit = [&](int vertex) {
+                    order[vertex] = lowlink[vertex] = next_order++;
+                    stack.push_back(vertex);
+                    is_on_stack[vertex] = true;
+                    frames.push_back({vertex, 0});
+                };
+
+                for (int root = 0; root < total_vertices; ++root) {
+                    if (order[root] != -1) {
+                        continue;
+                    }
+                    visit(root);
+                    while (!frames.empty()) {
+                        const int vertex = frames.back().vertex;
+                        if (frames.back().next_edge < adjacency[vertex].size()) {
+                            const int next = adjacency[vertex][frames.back().next_edge++];
+                            if (order[next] == -1) {
+                                visit(next);
+                            } else if (is_on_stack[next]) {
+                                lowlink[vertex] = std::min(lowlink[vertex], order[next]);
                             }
+                            continue;
+                        }
+
+                        frames.pop_back();
+                        if (!frames.empty()) {
+                            const int parent = frames.back().vertex;
+                            lowlink[parent] = std::min(lowlink[parent], lowlink[vertex]);
+                        }
+                        if (lowlink[vertex] == order[vertex]) {
+                            int member;
+                            do {
+                                member = stack.back();
+                                stack.pop_back();
+                                is_on_stack[member] = false;
+                                components[member] = total_components;
+                            } while (member != vertex);
+                            ++total_components;
                         }
-                    }
-                    if (!component.empty()) {
-                        components.push_back(component);
                     }
                 }
+                return components;
             }
-            return components;
         }
 
-        void dfs1(int v, const EmuNetwork &network, std::vector<char> &visited, std::vector<size_t> &ordered_reactions, const std::vector<Emu> &all_emus) {
-            visited[v] = true;
-            for (int i = 0; i < network.size(); ++i) {
-                if (network.at(i).left.size() == 1 && network.at(i).left[0].emu == all_emus.at(v)) {
-                    auto right = std::find(all_emus.begin(), all_emus.end(), network.at(i).right.emu);
-                    if (!visited[right - all_emus.begin()]) {
-                        dfs1(right - all_emus.begin(), network, visited, ordered_reactions, all_emus);
-                    }
+        NetworkComponents CreateNetworkComponents(const EmuNetwork &network) {
+            const EmuGraph graph = CreateEmuGraph(network);
+            int total_components = 0;
+            const std::vector<int> vertex_components = FindComponents(graph.adjacency, total_components);
+
+            std::vector<EmuNetwork> components(total_components);
+            for (const EmuReaction &reaction : network) {
+                const int vertex = *graph.vertices.Find(reaction.right.emu);
+                components[total_components - 1 - vertex_components[vertex]].push_back(reaction);
+            }
+
+            // the components without reactions consist of the emus from the other networks
+            std::vector<int> positions(total_components, -1);
+            NetworkComponents result;
+            for (int component = 0; component < total_components; ++component) {
+                if (!components[component].empty()) {
+                    positions[component] = result.components.size();
+                    result.components.push_back(std::move(components[component]));
                 }
             }
-            ordered_reactions.push_back(v);
-        }
 
-        void dfs2(int v, const EmuNetwork &emu_network, std::vector<char> &visited, std::vector<size_t> &component, const std::vector<Emu> &all_emus) {
-            visited[v] = true;
-            component.push_back(v);
-            for (size_t i = 0; i < emu_network.size(); ++i) {
-                if (emu_network[i].right.emu == all_emus[v] && emu_network[i].left.size() == 1) {
-                    auto left = std::find(all_emus.begin(), all_emus.end(), emu_network[i].left[0].emu);
-                    if (!visited[left - all_emus.begin()]) {
-                        dfs2(left - all_emus.begin(), emu_network, visited, component, all_emus);
+            result.dependencies.resize(result.components.size());
+            for (size_t vertex = 0; vertex < graph.adjacency.size(); ++vertex) {
+                const int precursor_position = positions[total_components - 1 - vertex_components[vertex]];
+                for (int product : graph.adjacency[vertex]) {
+                    const int product_position = positions[total_components - 1 - vertex_components[product]];
+                    if (precursor_position != -1 && precursor_position != product_position) {
+                        result.dependencies[product_position].push_back(precursor_position);
                     }
                 }
             }
+            for (std::vector<int> &dependencies : result.dependencies) {
+                std::sort(dependencies.begin(), dependencies.end());
+                dependencies.erase(std::unique(dependencies.begin(), dependencies.end()), dependencies.end());
+            }
+            return result;
         }
     }
-}
\ No newline at end of file
+}
@@ -1,111 +1,215 @@
 #include "modeller/create_nullspace.h"
 
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <utility>
+#include <vector>
+
 #include "utilities/reaction.h"
 #include "utilities/matrix.h"
 
-#include "eigen/Dense"
-
 #include "iostream"
 
 
 namespace khnum {
 namespace modelling_utills {
-const double epsilon = 1.e-12;
-// Transform stoichiometry matrix to form
-/*
- *
- * |1 0 0 0 0 a1 a2 |
- * |0 1 0 0 0 a3 a4 |
- * |0 0 1 0 0 a5 a6 | = | I  A |
- * |0 0 0 1 0 a7 a8 |
- * |0 0 0 0 1 a9 a10|
- */
-// So Vdep = -A * Vfree
-// And return the A matrix
+namespace {
+const double epsilon = 1.e-10;
+
+// Left-looking LU factorization of the columns of a sparse matrix, which are added one by one.
+// A column is accepted only if it is linearly independent of the accepted ones,
+// its pivot is the biggest of the rows which aren't pivots yet
+class ColumnFactorization {
+public:
+    explicit ColumnFactorization(int rows) : is_pivot_row_(rows, false), is_touched_(rows, false), work_(rows, 0.0) {
+    }
+
+    // Returns false and keeps the factorization if the column depends on the accepted ones
+    bool TryAddColumn(const SparseMatrix& matrix, int column) {
+        Eliminate(matrix, column);
 
-Matrix GetNullspace(const Matrix& original_matrix, std::vector<Reaction> &reactions) {
-    // As we work with the diagonal elements, pivot.column == pivot.row
-    // So below I use it as synonymous
-    Matrix matrix = original_matrix;
-
-    std::cout << matrix.cols() << " " << matrix.rows() << std::endl;
-    Eigen::FullPivLU<Matrix> dec(matrix);
-    std::cout << dec.rank() << std::endl;
-    const int metabolite_balance_reactions_total = reactions.size() - matrix.cols();
-
-    for (int column = 0; column < matrix.rows(); ++column) {
-        if (abs(matrix(column, column)) < epsilon) {
-            // Try to exchange with row below
-            bool is_found_not_null_pivot = ExchangeRowsToMakePivotNotNull(matrix, column);
-
-            if (!is_found_not_null_pivot) {
-                // We need to exchange columns, so as the fluxes order
-                const int column_to_swap = FindNotNullColumn(matrix, column);
-                if (column_to_swap == -1) {
-                    throw std::runtime_error(
-                        "Can't transform stoichiometry matrix at column number " + std::to_string(column));
-                }
-                matrix.col(column).swap(matrix.col(column_to_swap));
-                std::swap(reactions[metabolite_balance_reactions_total + column],
-                          reactions[metabolite_balance_reactions_total + column_to_swap]);
-                std::cout << "Reaction num " << metabolite_balance_reactions_total + column << " and num "
-                          << metabolite_balance_reactions_total + column_to_swap << " has swapped" << std::endl;
-                if (abs(matrix(column, column)) < epsilon) {
-                    ExchangeRowsToMakePivotNotNull(matrix, column);
-                }
+        int pivot_row = -1;
+        double max_pivot = epsilon;
+        for (int row : touched_rows_) {
+            if (!is_pivot_row_[row] && std::abs(work_[row]) > max_pivot) {
+                max_pivot = std::abs(work_[row]);
+                pivot_row = row;
             }
         }
+        if (pivot_row == -1) {
+            Clear();
+            return false;
+        }
 
-        // Now it's guaranteed pivot is not null
-        matrix.row(column) /= matrix(column, column);
-        for (int row = column + 1; row < matrix.rows(); ++row) {
-            matrix.row(row) -= matrix.row(column) * matrix(row, column);
+        const double pivot = work_[pivot_row];
+        std::vector<std::pair<int, double>> upper;
+        for (size_t k = 0; k < pivot_rows_.size(); ++k) {
+            if (work_[pivot_rows_[k]] != 0.0) {
+                upper.emplace_back(k, work_[pivot_rows_[k]]);
+            }
+        }
+        std::vector<std::pair<int, double>> lower;
+        for (int row : touched_rows_) {
+            if (!is_pivot_row_[row] && row != pivot_row && work_[row] != 0.0) {
+                lower.emplace_back(row, work_[row] / pivot);
+            }
         }
 
+        upper_.push_back(std::move(upper));
+        lower_.push_back(std::move(lower));
+        diagonal_.push_back(pivot);
+        pivot_rows_.push_back(pivot_row);
+        is_pivot_row_[pivot_row] = true;
+        Clear();
+        return true;
     }
 
-    // Now we have upper-diagonal matrix with units at diagonal
-    for (int column = matrix.rows() - 1; column >= 0; --column) {
-        for (int row = column - 1; row >= 0; --row) {
-            matrix.row(row) -= matrix.row(column) * matrix(row, column);
+    // Coefficients of the column in the basis of the accepted columns
+    void Solve(const SparseMatrix& matrix, int column, Matrix* result, int result_column) {
+        Eliminate(matrix, column);
+
+        const int rank = GetRank();
+        std::vector<double> solution(rank);
+        for (int k = 0; k < rank; ++k) {
+            solution[k] = work_[pivot_rows_[k]];
+        }
+        for (int k = rank - 1; k >= 0; --k) {
+            solution[k] /= diagonal_[k];
+            for (const auto& [previous, value] : upper_[k]) {
+                solution[previous] -= value * solution[k];
+            }
+            (*result)(k, result_column) = solution[k];
         }
+        Clear();
     }
 
-    Matrix result = matrix.block(0, matrix.rows(), matrix.rows(), matrix.cols() - matrix.rows());
-    return result;
-}
-
+    int GetRank() const {
+        return pivot_rows_.size();
+    }
 
-bool ExchangeRowsToMakePivotNotNull(Matrix &matrix, const int column) {
-    double max_pivot = abs(matrix(column, column));
-    int max_row = column;
-    bool found_non_zero = false;
-    for (int row = column + 1; row < matrix.rows(); ++row) {
-        if (abs(matrix(row, column)) > epsilon) {
-            found_non_zero = true;
-            if (max_pivot < abs(matrix(row, column))) {
-                max_pivot = abs(matrix(row, column));
-                max_row = row;
+private:
+    // Applies the accepted transformations to the column
+    void Eliminate(const SparseMatrix& matrix, int column) {
+        for (SparseMatrix::InnerIterator element(matrix, column); element; ++element) {
+            Touch(element.row());
+            work_[element.row()] = element.value();
+        }
+        for (size_t k = 0; k < pivot_rows_.size(); ++k) {
+            const double value = work_[pivot_rows_[k]];
+            if (value == 0.0) {
+                continue;
+            }
+            for (const auto& [row, coefficient] : lower_[k]) {
+                Touch(row);
+                work_[row] -= coefficient * value;
             }
         }
     }
-    if (found_non_zero) {
-        matrix.row(column).swap(matrix.row(max_row));
-        return true;
+
+    void Touch(int row) {
+        if (!is_touched_[row]) {
+            is_touched_[row] = true;
+            touched_rows_.push_back(row);
+        }
+    }
+
+    void Clear() {
+        for (int row : touched_rows_) {
+            work_[row] = 0.0;
+            is_touched_[row] = false;
+        }
+        touched_rows_.clear();
     }
-    return false;
+
+    std::vector<int> pivot_rows_;
+    std::vector<double> diagonal_;
+    std::vector<std::vector<std::pair<int, double>>> lower_; // multipliers of the rows below the pivot
+    std::vector<std::vector<std::pair<int, double>>> upper_; // by the positions of the previous pivots
+    std::vector<bool> is_pivot_row_;
+
+    std::vector<bool> is_touched_;
+    std::vector<int> touched_rows_;
+    std::vector<double> work_;
+};
 }
 
+// Transform stoichiometry matrix to form
+/*
+ *
+ * |1 0 0 0 0 a1 a2 |
+ * |0 1 0 0 0 a3 a4 |
+ * |0 0 1 0 0 a5 a6 | = | I  A |
+ * |0 0 0 1 0 a7 a8 |
+ * |0 0 0 0 1 a9 a10|
+ */
+// So Vdep = -A * Vfree
+// And return the A matrix
 
-int FindNotNullColumn(const Matrix &matrix, const int currentRow) {
-    for (int column = matrix.rows(); column < matrix.cols(); ++column) {
-        for (int row = currentRow; row < matrix.rows(); ++row) {
-            if (abs(matrix(row, column)) > epsilon) {
-                return column;
+// The dependent fluxes are chosen from the beginning: if a column depends on the already chosen ones,
+// it's exchanged with the first suitable column of the free fluxes.
+// If there is no such column, the balances of the metabolites are linearly dependent,
+// then the column goes to the free fluxes and the redundant balances are dropped.
+// So A has as many rows as the rank of the matrix
+Matrix GetNullspace(const SparseMatrix& stoichiometry_matrix, std::vector<Reaction> &reactions) {
+    const int total_columns = stoichiometry_matrix.cols();
+    const int metabolite_balance_reactions_total = reactions.size() - total_columns;
+    std::cout << stoichiometry_matrix.cols() << " " << stoichiometry_matrix.rows() << std::endl;
+
+    // columns of the matrix in the order of the fluxes
+    std::vector<int> order(total_columns);
+    std::iota(order.begin(), order.end(), 0);
+    // the chosen columns only grow, so a dependent column stays dependent
+    std::vector<bool> is_dependent(total_columns, false);
+
+    ColumnFactorization factorization(stoichiometry_matrix.rows());
+    int dependent_fluxes_total = std::min<int>(stoichiometry_matrix.rows(), total_columns);
+    int position = 0;
+    while (position < dependent_fluxes_total) {
+        if (factorization.TryAddColumn(stoichiometry_matrix, order[position])) {
+            ++position;
+            continue;
+        }
+        is_dependent[order[position]] = true;
+
+        int column_to_swap = -1;
+        for (int column = dependent_fluxes_total; column < total_columns && column_to_swap == -1; ++column) {
+            if (is_dependent[order[column]]) {
+                continue;
+            }
+            if (factorization.TryAddColumn(stoichiometry_matrix, order[column])) {
+                column_to_swap = column;
+            } else {
+                is_dependent[order[column]] = true;
             }
         }
+
+        if (column_to_swap != -1) {
+            std::swap(order[position], order[column_to_swap]);
+            std::cout << "Reaction num " << metabolite_balance_reactions_total + position << " and num "
+                      << metabolite_balance_reactions_total + column_to_swap << " has swapped" << std::endl;
+            ++position;
+        } else {
+            std::rotate(order.begin() + position, order.begin() + position + 1,
+                        order.begin() + dependent_fluxes_total);
+            --dependent_fluxes_total;
+        }
+    }
+    std::cout << factorization.GetRank() << std::endl;
+
+    std::vector<Reaction> ordered_reactions;
+    ordered_reactions.reserve(total_columns);
+    for (int column : order) {
+        ordered_reactions.push_back(std::move(reactions[metabolite_balance_reactions_total + column]));
     }
-    return -1;
+    std::move(ordered_reactions.begin(), ordered_reactions.end(),
+              reactions.begin() + metabolite_balance_reactions_total);
+
+    Matrix result(dependent_fluxes_total, total_columns - dependent_fluxes_total);
+    for (int column = dependent_fluxes_total; column < total_columns; ++column) {
+        factorization.Solve(stoichiometry_matrix, order[column], &result, column - dependent_fluxes_total);
+    }
+    return result;
 }
 } // namespace modelling_utills
-} // namespace khnum
\ No newline at end of file
+} // namespace khnum
@@ -4,6 +4,7 @@
 #include <vector>
 #include <iostream>
 #include <exception>
+#include <unordered_map>
 
 #include "utilities/matrix.h"
 #include "utilities/reaction.h"
@@ -12,33 +13,50 @@
 
 namespace khnum {
 namespace modelling_utills {
-Matrix CreateStoichiometryMatrix(const std::vector<Reaction> &reactions,
-                                 const std::vector<std::string> &metabolite_list) {
+SparseMatrix CreateStoichiometryMatrix(const std::vector<Reaction> &reactions,
+                                       const std::vector<std::string> &metabolite_list) {
 
     const int metabolite_number = metabolite_list.size();
+    std::unordered_map<std::string, int> metabolite_rows;
+    for (int metabolite = 0; metabolite < metabolite_number; ++metabolite) {
+        metabolite_rows.emplace(metabolite_list[metabolite], metabolite);
+    }
 
-    // counting number of reaction included in stoichiometry matrix
+    // The coefficients of a metabolite in one reaction are summed up by setFromTriplets
+    std::vector<Triplet> coefficients;
     int reaction_number = 0;
     for (const Reaction &reaction : reactions) {
-        if (reaction.type != ReactionType::IsotopomerBalance) {
-            ++reaction_number;
+        if (reaction.type == ReactionType::IsotopomerBalance) {
+            continue;
+        }
+        for (const Substrate &substrate : reaction.chemical_equation.left) {
+            auto metabolite = metabolite_rows.find(substrate.name);
+            if (metabolite != metabolite_rows.end()) {
+                coefficients.emplace_back(metabolite->second, reaction_number, -substrate.substrate_coefficient_);
+            }
         }
+        for (const Substrate &substrate : reaction.chemical_equation.right) {
+            auto metabolite = metabolite_rows.find(substrate.name);
+            if (metabolite != metabolite_rows.end()) {
+                coefficients.emplace_back(metabolite->second, reaction_number, substrate.substrate_coefficient_);
+            }
+        }
+        ++reaction_number;
     }
-    Matrix stoichiometry_matrix = Matrix::Zero(metabolite_number, reaction_number);
 
+    SparseMatrix stoichiometry_matrix(metabolite_number, reaction_number);
+    stoichiometry_matrix.setFromTriplets(coefficients.begin(), coefficients.end());
+    stoichiometry_matrix.prune([](int, int, double coefficient) { return coefficient != 0.0; });
 
     int stoichiometry_reaction_number = 0;
     for (const Reaction &reaction : reactions) {
         bool is_present = false;
         if (reaction.type != ReactionType::IsotopomerBalance) {
-            for (int metabolite = 0; metabolite < metabolite_number; ++metabolite) {
-                std::string current_metabolite_name = metabolite_list.at(metabolite);
-
-                double coefficient = GetTotalCoefficient(reaction.chemical_equation, current_metabolite_name);
-                if (coefficient < -0.001 || coefficient > 0.001) {
+            for (SparseMatrix::InnerIterator coefficient(stoichiometry_matrix, stoichiometry_reaction_number);
+                 coefficient; ++coefficient) {
+                if (coefficient.value() < -0.001 || coefficient.value() > 0.001) {
                     is_present = true;
                 }
-                stoichiometry_matrix(metabolite, stoichiometry_reaction_number) = coefficient;
             }
             ++stoichiometry_reaction_number;
         }
@@ -49,18 +67,20 @@ Matrix CreateStoichiometryMatrix(const std::vector<Reaction> &reactions,
     }
 
     // Check for metabolites which doesn't have input and output together
-    for (int i = 0; i < stoichiometry_matrix.rows(); ++i) {
-        bool is_pos = false;
-        bool is_neg = false;
-        for (int j = 0; j < stoichiometry_matrix.cols(); ++j) {
-            if (stoichiometry_matrix(i, j) > 0.0) {
-                is_pos = true;
+    std::vector<bool> is_pos(metabolite_number, false);
+    std::vector<bool> is_neg(metabolite_number, false);
+    for (int j = 0; j < stoichiometry_matrix.outerSize(); ++j) {
+        for (SparseMatrix::InnerIterator coefficient(stoichiometry_matrix, j); coefficient; ++coefficient) {
+            if (coefficient.value() > 0.0) {
+                is_pos[coefficient.row()] = true;
             }
-            if (stoichiometry_matrix(i, j) < -0.0) {
-                is_neg = true;
+            if (coefficient.value() < -0.0) {
+                is_neg[coefficient.row()] = true;
             }
         }
-        if (!(is_neg && is_pos)) {
+    }
+    for (int i = 0; i < metabolite_number; ++i) {
+        if (!(is_neg[i] && is_pos[i])) {
             std::cout << "bad: " << metabolite_list[i] << std::endl;
         }
     }
@@ -15,6 +15,7 @@
 #include "modeller/create_nullspace.h"
 #include "modeller/calculate_flux_bounds.h"
 #include "modeller/check_model.h"
+#include "modeller/reversible_reactions.h"
 
 #include "utilities/debug_utills/debug_prints.h"
 
@@ -38,16 +39,16 @@ void Modeller::CalculateInputSubstrateMids() {
 void Modeller::CreateEmuNetworks() {
     std::vector<EmuNetwork> networks = modelling_utills::CreateEmuNetworks(all_emu_reactions_, input_emu_list_, measured_isotopes_);
     for (EmuNetwork &network : networks) {
-        std::vector<EmuNetwork> components = modelling_utills::CreateNetworkComponents(network);
-        for (const EmuNetwork &component : components) {
-            emu_networks_.push_back(component);
+        modelling_utills::NetworkComponents components = modelling_utills::CreateNetworkComponents(network);
+        for (EmuNetwork &component : components.components) {
+            emu_networks_.push_back(std::move(component));
         }
     }
 }
 
 
-void Modeller::CalculateFluxBounds() {
-    modelling_utills::CalculateFluxBounds(reactions_, stoichiometry_matrix_);
+void Modeller::CalculateFluxBounds(size_t total_threads) {
+    modelling_utills::CalculateFluxBounds(reactions_, stoichiometry_matrix_, total_threads);
     int nullity = nullspace_.cols();
 
     lower_bounds_.resize(nullity);
@@ -127,6 +128,7 @@ Problem Modeller::GetProblem() {
         reactions_names.push_back(reaction_name);
     }
     problem.reactions = reactions_names;
+    problem.reversible_reactions = modelling_utills::FindReversibleReactions(reactions_);
 
     return problem;
 }
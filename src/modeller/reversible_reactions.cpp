@@ -0,0 +1,52 @@
+#include "modeller/reversible_reactions.h"
+
+#include <set>
+#include <string>
+#include <vector>
+
+
+namespace khnum {
+namespace modelling_utills {
+namespace {
+// the coefficients of the symmetric substrates differ between the directions, so only the names are compared
+std::set<std::string> GetSubstrateNames(const ChemicalEquationSide& side) {
+    std::set<std::string> names;
+    for (const Substrate& substrate : side) {
+        names.insert(substrate.name);
+    }
+    return names;
+}
+
+bool IsReversed(const Reaction& forward, const Reaction& backward) {
+    return GetSubstrateNames(forward.chemical_equation.left) == GetSubstrateNames(backward.chemical_equation.right) &&
+           GetSubstrateNames(forward.chemical_equation.right) == GetSubstrateNames(backward.chemical_equation.left);
+}
+}
+
+std::vector<ReversibleReaction> FindReversibleReactions(const std::vector<Reaction>& reactions) {
+    std::vector<ReversibleReaction> reversible_reactions;
+    std::vector<bool> is_paired(reactions.size(), false);
+    for (size_t backward = 0; backward < reactions.size(); ++backward) {
+        if (reactions[backward].type != ReactionType::Backward) {
+            continue;
+        }
+        size_t best_forward = reactions.size();
+        for (size_t forward = 0; forward < reactions.size(); ++forward) {
+            if (reactions[forward].type != ReactionType::Forward || is_paired[forward] ||
+                reactions[forward].id > reactions[backward].id ||
+                !IsReversed(reactions[forward], reactions[backward])) {
+                continue;
+            }
+            if (best_forward == reactions.size() || reactions[forward].id > reactions[best_forward].id) {
+                best_forward = forward;
+            }
+        }
+        if (best_forward != reactions.size()) {
+            is_paired[best_forward] = true;
+            reversible_reactions.push_back({best_forward, backward});
+        }
+    }
+    return reversible_reactions;
+}
+} // namespace modelling_utills
+} // namespace khnum
@@ -1,8 +1,13 @@
 #include "parser/maranas_parser.h"
 
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <limits>
 #include <sstream>
 #include <unordered_set>
+#include <utility>
 
 #include "utilities/reaction.h"
 #include "parser/open_flux_parser/open_flux_utills.h"
@@ -10,6 +15,292 @@
 #include "utilities/debug_utills/debug_prints.h"
 
 namespace khnum {
+namespace {
+// Reactions of flux_model.csv which are added to the model, they have no atom transitions
+const std::unordered_set<std::string> flux_only_reactions {
+    "PPA", "DPCOAK", "NADK", "NADS1", "SULRi", "DM_4HBA", "DM_HMFURN", "biomass_out", "EX_ca2(e)",
+    "EX_cl(e)", "EX_cobalt2(e)", "EX_cu2(e)", "EX_fe2(e)", "EX_h(e)", "EX_h2(e)", "EX_h2o(e)", "EX_k(e)",
+    "EX_mg2(e)", "EX_mn2(e)", "EX_mobd(e)", "EX_nh4(e)", "o2_in", "EX_pi(e)", "EX_so4(e)", "EX_zn2(e)",
+    "CAt6pp", "CLt3_2pp", "COBALT2tpp", "CU2tpp", "FE2tpp", "FEROpp", "Kt2pp", "MG2tpp", "MN2t3pp",
+    "MN2tpp", "NAt3_1p5pp", "NAt3_2pp", "NAt3pp", "NH4tpp", "NI2t3pp", "NI2tpp", "O2tpp", "PIt2rpp",
+    "ZN2t3pp", "ZN2tpp", "CYTBD2pp", "CYTBDpp", "CYTBO3_4pp", "NADH10", "NADH16pp", "NADH17pp", "NADH5",
+    "NADPHQR2", "NADPHQR3", "NADTRHD", "THD2pp", "TRDR", "H2Otpp", "H2tpp", "MNt2pp", "H2Otex", "CA2tex",
+    "CLtex", "COBALT2tex", "CU2tex", "FE2tex", "FE3tex", "H2tex", "Htex", "Ktex", "MG2tex", "MNtex",
+    "MOBDtex", "NH4tex", "O2tex", "PItex", "SO4tex", "Zn2tex", "CAT"};
+
+struct MetaboliteAtoms {
+    std::string name;
+    std::vector<std::string> atoms; // labels of the atoms, the same label on both sides is one atom transition
+};
+
+// A reaction of model.csv, every row of the file is one of its metabolites
+struct RawReaction {
+    std::string name;
+    std::string equation;
+    std::vector<MetaboliteAtoms> metabolites;
+};
+
+// Cells of one csv line, the delimiters inside quotes are a part of the cell
+std::vector<std::string> SplitCsvRow(const std::string& line) {
+    std::vector<std::string> row;
+    if (line.empty()) {
+        return row;
+    }
+
+    std::string cell;
+    bool is_quoted = false;
+    for (size_t i = 0; i < line.size(); ++i) {
+        const char symbol = line[i];
+        if (symbol == '"') {
+            if (is_quoted && i + 1 < line.size() && line[i + 1] == '"') {
+                cell += '"';
+                ++i;
+            } else {
+                is_quoted = !is_quoted;
+            }
+        } else if (symbol == ',' && !is_quoted) {
+            row.push_back(std::move(cell));
+            cell.clear();
+        } else if (symbol != '\r' || i + 1 != line.size()) {
+            cell += symbol;
+        }
+    }
+    if (is_quoted) {
+        throw std::runtime_error("There is unclosed quote in line: " + line);
+    }
+    row.push_back(std::move(cell));
+    return row;
+}
+
+std::vector<std::string> Split(const std::string& line, char delimiter) {
+    std::vector<std::string> tokens;
+    size_t begin = 0;
+    while (true) {
+        const size_t end = line.find(delimiter, begin);
+        tokens.push_back(line.substr(begin, end - begin));
+        if (end == std::string::npos) {
+            return tokens;
+        }
+        begin = end + 1;
+    }
+}
+
+// Groups the rows of model.csv by the reaction in the order of their first appearance
+std::vector<RawReaction> ReadEmuModel(const std::string& path) {
+    std::ifstream input(path);
+    if (!input) {
+        throw std::runtime_error("Can't open file: " + path);
+    }
+
+    std::vector<RawReaction> raw_reactions;
+    std::unordered_map<std::string, size_t> positions;
+    std::string line;
+    getline(input, line); // skip header
+    while (getline(input, line)) {
+        const std::vector<std::string> row = SplitCsvRow(line);
+        if (row.empty()) {
+            continue;
+        }
+        if (row.size() < 6) {
+            throw std::runtime_error("There is row with less than 6 cells in " + path + ": " + line);
+        }
+
+        const std::string& name = row[5];
+        auto position = positions.emplace(name, raw_reactions.size());
+        if (position.second) {
+            RawReaction raw;
+            raw.name = name;
+            raw.equation = row[4];
+            raw_reactions.push_back(std::move(raw));
+        }
+        raw_reactions[position.first->second].metabolites.push_back({row[2], Split(row[0], ',')});
+    }
+    return raw_reactions;
+}
+
+// Keeps the coefficient if the token isn't a number
+bool ParseCoefficient(const std::string& token, SubstrateCoefficient* coefficient) {
+    char* end = nullptr;
+    const SubstrateCoefficient value = std::strtod(token.c_str(), &end);
+    if (end != token.c_str() + token.size()) {
+        return false;
+    }
+    *coefficient = value;
+    return true;
+}
+
+// A metabolite with atoms is added once for each of its rows, so 2 atp with mapped atoms become atp + atp.
+// The metabolites without atoms keep their coefficients and have zero size
+ChemicalEquationSide ParseEquationSide(const std::string& raw_side, const std::string& compartment,
+                                       const RawReaction& raw) {
+    ChemicalEquationSide side;
+    bool has_coefficient = false;
+    SubstrateCoefficient coefficient = 0.0;
+    for (const std::string& token : Split(raw_side, ' ')) {
+        if (token.empty() || token == "+") {
+            continue;
+        }
+
+        if (ParseCoefficient(token, &coefficient)) {
+            if (has_coefficient) {
+                throw std::runtime_error("There is reaction with two coefficient in a row: " + raw.name);
+            }
+            has_coefficient = true;
+            continue;
+        }
+
+        // 0* marks the metabolites excluded from the balance
+        std::string name = token.compare(0, 2, "0*") == 0 ? token.substr(2) : token;
+        name += compartment;
+
+        const MetaboliteAtoms* atoms = nullptr;
+        int total_copies = 0;
+        for (const MetaboliteAtoms& metabolite : raw.metabolites) {
+            if (metabolite.name == name) {
+                atoms = atoms ? atoms : &metabolite;
+                ++total_copies;
+            }
+        }
+
+        Substrate substrate;
+        substrate.name = name;
+        if (atoms) {
+            substrate.size = atoms->atoms.size();
+            substrate.substrate_coefficient_ = 1.0;
+            for (int copy = 0; copy < total_copies; ++copy) {
+                substrate.id = side.size();
+                side.push_back(substrate);
+            }
+        } else {
+            substrate.size = 0;
+            substrate.substrate_coefficient_ = has_coefficient && coefficient != 0.0 ? coefficient : 1.0;
+            substrate.id = side.size();
+            side.push_back(substrate);
+        }
+        has_coefficient = false;
+    }
+    return side;
+}
+
+// The first copy of the metabolite which has atoms without transitions, every call takes one atom of it.
+// Returns -1 if there is no such copy
+int TakeNextAtom(const ChemicalEquationSide& side, const std::string& name, std::vector<int>* taken_atoms) {
+    for (size_t position = 0; position < side.size(); ++position) {
+        int& taken = (*taken_atoms)[position];
+        if (side[position].name == name && (taken == 0 || taken < side[position].size)) {
+            ++taken;
+            return position;
+        }
+    }
+    return -1;
+}
+
+// Every atom label of a metabolite is looked for among the other metabolites of the reaction,
+// the pairs of copies are taken in the order of the rows
+std::vector<AtomTransition> ParseAtomTransitions(RawReaction raw, const ChemicalEquationSide& left,
+                                                 const ChemicalEquationSide& right) {
+    std::vector<AtomTransition> transitions;
+    std::vector<int> left_taken_atoms(left.size(), 0);
+    std::vector<int> right_taken_atoms(right.size(), 0);
+
+    for (MetaboliteAtoms& metabolite : raw.metabolites) {
+        while (!metabolite.atoms.empty()) {
+            int substrate_position = TakeNextAtom(left, metabolite.name, &left_taken_atoms);
+            const bool is_left = substrate_position != -1;
+            if (!is_left) {
+                substrate_position = TakeNextAtom(right, metabolite.name, &right_taken_atoms);
+            }
+            if (substrate_position == -1) {
+                throw std::runtime_error("Reaction " + raw.name + " has no metabolite " + metabolite.name);
+            }
+
+            const std::string atom = metabolite.atoms.front();
+            metabolite.atoms.erase(metabolite.atoms.begin());
+
+            MetaboliteAtoms* product = nullptr;
+            for (MetaboliteAtoms& other : raw.metabolites) {
+                if (std::find(other.atoms.begin(), other.atoms.end(), atom) != other.atoms.end()) {
+                    if (product) {
+                        throw std::runtime_error("Reaction " + raw.name + " has several products of atom " + atom);
+                    }
+                    product = &other;
+                }
+            }
+            if (!product) {
+                throw std::runtime_error("Reaction " + raw.name + " has no product of atom " + atom);
+            }
+            product->atoms.erase(std::find(product->atoms.begin(), product->atoms.end(), atom));
+
+            const int product_position = is_left ? TakeNextAtom(right, product->name, &right_taken_atoms)
+                                                 : TakeNextAtom(left, product->name, &left_taken_atoms);
+            if (product_position == -1) {
+                throw std::runtime_error("Reaction " + raw.name + " has no metabolite " + product->name);
+            }
+
+            const std::vector<int>& substrate_taken_atoms = is_left ? left_taken_atoms : right_taken_atoms;
+            const std::vector<int>& product_taken_atoms = is_left ? right_taken_atoms : left_taken_atoms;
+            AtomTransition transition;
+            transition.substrate_pos = substrate_position;
+            transition.substrate_atom = substrate_taken_atoms[substrate_position] - 1;
+            transition.product_pos = product_position;
+            transition.product_atom = product_taken_atoms[product_position] - 1;
+            transitions.push_back(transition);
+        }
+    }
+
+    for (const auto& [side, taken_atoms] : {std::make_pair(&left, &left_taken_atoms),
+                                            std::make_pair(&right, &right_taken_atoms)}) {
+        for (size_t position = 0; position < side->size(); ++position) {
+            if ((*side)[position].size > 0 && (*taken_atoms)[position] != (*side)[position].size) {
+                throw std::runtime_error("Reaction " + raw.name + " has atoms without transitions in " +
+                                         (*side)[position].name);
+            }
+        }
+    }
+    return transitions;
+}
+
+// Equation looks like "[c] : akg + ala-L <==> glu-L + pyr", the compartment prefix is optional
+Reaction ParseReaction(const RawReaction& raw, int id) {
+    std::string separator;
+    size_t separator_position = std::string::npos;
+    for (const char* candidate : {"-->", "->", "<==>"}) {
+        separator_position = raw.equation.find(candidate);
+        if (separator_position != std::string::npos) {
+            separator = candidate;
+            break;
+        }
+    }
+    if (separator_position == std::string::npos) {
+        throw std::runtime_error("There is reaction without arrow: " + raw.name);
+    }
+
+    std::string left = raw.equation.substr(0, separator_position);
+    const std::string right = raw.equation.substr(separator_position + separator.size());
+    std::string compartment;
+    if (!left.empty() && left[0] == '[') {
+        compartment = left.substr(0, left.find(' '));
+        const size_t compartment_end = left.find(':');
+        if (compartment_end == std::string::npos) {
+            throw std::runtime_error("There is compartment without colon in reaction " + raw.name);
+        }
+        left = left.substr(compartment_end + 1);
+    }
+
+    Reaction result;
+    result.id = id;
+    result.name = raw.name;
+    result.chemical_equation.left = ParseEquationSide(left, compartment, raw);
+    result.chemical_equation.right = ParseEquationSide(right, compartment, raw);
+    result.chemical_equation.atom_transitions = ParseAtomTransitions(raw, result.chemical_equation.left,
+                                                                     result.chemical_equation.right);
+    result.type = separator == "<==>" ? ReactionType::Forward : ReactionType::Irreversible;
+    result.basis = std::numeric_limits<double>::quiet_NaN();
+    result.deviation = std::numeric_limits<double>::quiet_NaN();
+    result.is_set_free = false;
+    return result;
+}
+}
 
 
 ParserResults ParserMaranas::GetResults() {
@@ -33,30 +324,45 @@ void ParserMaranas::Parse() {
 }
 
 void ParserMaranas::ParseReactions() {
-    Py_Initialize();
-
-    // change current directory
-    PyRun_SimpleString("import os");
-    PyRun_SimpleString("import sys");
-    PyRun_SimpleString("sys.path.append(os.getcwd() + \"/../src/parser/maranas_parser\")");
-
-    PyObject *pName = PyUnicode_DecodeFSDefault("Maranas");
-    PyObject *pModule = PyImport_Import(pName);
-    PyObject *pFunc = PyObject_GetAttrString(pModule, "parse");
-    PyObject *pArgs = PyTuple_New(1);
-    PyObject *path = Py_BuildValue("s", path_.c_str());
-    PyTuple_SetItem(pArgs, 0, path);
-    PyObject *pValue = PyObject_CallObject(pFunc, pArgs);
-    const char *command = PyBytes_AsString(pValue);
-    std::string answer(command);
-
-    std::stringstream stream(answer);
-    int total_reactions = 0;
-    stream >> total_reactions;
-    for (int i = 0; i < total_reactions; ++i) {
-        reactions_.push_back(ParseReaction(stream));
+    const std::vector<RawReaction> raw_reactions = ReadEmuModel((std::filesystem::path(path_) / "model.csv").string());
+
+    // reactions of both files by their names, a repeated name replaces the reaction in its place
+    std::unordered_map<std::string, size_t> reaction_positions;
+    int next_id = 0;
+    auto add_reaction = [this, &reaction_positions, &next_id](const RawReaction& raw) {
+        Reaction reaction = ParseReaction(raw, next_id++);
+        auto position = reaction_positions.emplace(reaction.name, reactions_.size());
+        if (position.second) {
+            reactions_.push_back(std::move(reaction));
+        } else {
+            reactions_[position.first->second] = std::move(reaction);
+        }
+    };
+    for (const RawReaction& raw : raw_reactions) {
+        add_reaction(raw);
     }
 
+    const std::string flux_model_path = (std::filesystem::path(path_) / "flux_model.csv").string();
+    std::ifstream flux_model(flux_model_path);
+    if (!flux_model) {
+        throw std::runtime_error("Can't open file: " + flux_model_path);
+    }
+    std::string line;
+    while (getline(flux_model, line)) {
+        const std::vector<std::string> row = SplitCsvRow(line);
+        if (row.empty() || flux_only_reactions.count(row[0]) == 0) {
+            continue;
+        }
+        if (row.size() < 3) {
+            throw std::runtime_error("There is no equation of reaction " + row[0] + " in " + flux_model_path);
+        }
+        RawReaction raw;
+        raw.name = row[0] + "_flux";
+        raw.equation = row[2];
+        add_reaction(raw);
+    }
+
+    const int total_reactions = reactions_.size();
     // Add backward reactions for the reversible
     for (int i = 0; i < total_reactions; ++i) {
         const Reaction &reaction = reactions_[i];
@@ -109,80 +415,6 @@ void ParserMaranas::CollectSubstrateSizes(const ChemicalEquationSide &side) {
     }
 }
 
-Reaction ParserMaranas::ParseReaction(std::stringstream &stream) {
-    Reaction result;
-    stream >> result.id;
-    stream >> result.name;
-    bool is_flux_only = false;
-    stream >> is_flux_only;
-    bool is_reversed = false;
-    stream >> is_reversed;
-    bool is_excluded = false;
-    stream >> is_excluded;
-
-    ChemicalEquationSide left;
-    int total_left = 0;
-    stream >> total_left;
-    for (int i = 0; i < total_left; ++i) {
-        Substrate sub;
-        stream >> sub.id;
-        stream >> sub.substrate_coefficient_;
-        stream >> sub.name;
-        stream >> sub.size;
-        left.push_back(sub);
-    }
-
-    ChemicalEquationSide right;
-    int total_right = 0;
-    stream >> total_right;
-    for (int i = 0; i < total_right; ++i) {
-        Substrate sub;
-        stream >> sub.id;
-        stream >> sub.substrate_coefficient_;
-        stream >> sub.name;
-        stream >> sub.size;
-        right.push_back(sub);
-    }
-
-    result.chemical_equation.left = left;
-    result.chemical_equation.right = right;
-    int total_transitions = 0;
-    stream >> total_transitions;
-    for (int i = 0; i < total_transitions; ++i) {
-        AtomTransition transition;
-        stream >> transition.substrate_pos >> transition.substrate_atom;
-        stream >> transition.product_pos >> transition.product_atom;
-        result.chemical_equation.atom_transitions.push_back(transition);
-    }
-
-    if (false) {
-        result.type = ReactionType::MetaboliteBalance;
-    } else {
-        if (!is_reversed) {
-            result.type = ReactionType::Irreversible;
-        } else {
-            result.type = ReactionType::Forward;
-        }
-    }
-
-    if (result.name == "gluc_up") {
-        result.basis = 100;
-        result.deviation = 0.02;
-        result.is_set_free = true;
-    } else {
-        result.basis = std::numeric_limits<double>::quiet_NaN();
-        result.deviation = std::numeric_limits<double>::quiet_NaN();
-        result.is_set_free = false;
-    }
-
-
-
-    result.basis = std::numeric_limits<double>::quiet_NaN();
-    result.is_set_free = false;
-    result.deviation = std::numeric_limits<double>::quiet_NaN();
-    return result;
-}
-
 void ParserMaranas::ParseExcludedMetabolites() {
     // Find metabolites from special compartment
     std::vector<std::string> excluded_prefixes {"[out]", "[pre]", "[d]", "[x]"};
@@ -245,17 +477,17 @@ void ParserMaranas::ParseExcludedMetabolites() {
 
 
 void ParserMaranas::ParseMeasurements() {
-    const std::string measurements_path = "../modelMaranas/measurements.csv";
+    const std::string measurements_path = (std::filesystem::path(path_) / "measurements.csv").string();
     std::vector<std::string> raw_measurements = open_flux_parser::GetLines(measurements_path);
     for (int i = 1; i < raw_measurements.size(); ++i) {
         Measurement measurement;
         std::stringstream line(raw_measurements[i]);
         std::string formula;
         getline(line, formula, '-');
-        measurement.emu.name = formula.substr(1) + "[d]"; // skip first " symbols
+        const std::string name = formula.substr(1) + "[d]"; // skip first " symbols
 
-        measurement.emu.atom_states = AtomStates(substrate_sizes_[measurement.emu.name], 0);
-        measurement.mid = Mid(substrate_sizes_[measurement.emu.name], 0);
+        AtomStates atom_states(substrate_sizes_[name], 0);
+        measurement.mid = Mid(substrate_sizes_[name], 0);
         std::string atoms;
         getline(line, atoms, '"');
         std::stringstream atoms_stream(atoms);
@@ -263,7 +495,7 @@ void ParserMaranas::ParseMeasurements() {
         getline(atoms_stream, atom, ',');
         while (!atom.empty()) {
             int atom_pos = std::stoi(atom);
-            measurement.emu.atom_states[atom_pos - 1] = 1;
+            atom_states[atom_pos - 1] = 1;
             if (atoms_stream.eof()) {
                 break;
             }
@@ -275,7 +507,8 @@ void ParserMaranas::ParseMeasurements() {
             line >> mass;
             measurement.mid[i] = mass;
         }
-        measurement.errors = Errors(substrate_sizes_[measurement.emu.name], 0.005);
+        measurement.emu = CreateEmu(name, atom_states);
+        measurement.errors = Errors(substrate_sizes_[name], 0.005);
         measurements_.push_back(measurement);
         measured_isotopes_.push_back(measurement.emu);
     }
@@ -284,7 +517,7 @@ void ParserMaranas::ParseMeasurements() {
 
 void ParserMaranas::ParseSubstrateInput() {
 
-    const std::string input_substrates_path = "../modelMaranas/substrate_input.csv";
+    const std::string input_substrates_path = (std::filesystem::path(path_) / "substrate_input.csv").string();
     const std::vector<std::string>& raw_substrates = open_flux_parser::GetLines(input_substrates_path);
     std::vector<InputSubstrate> input_substrates;
 
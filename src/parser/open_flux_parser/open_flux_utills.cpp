@@ -47,38 +47,29 @@ std::vector<Emu> ParseMeasuredIsotopes(const std::vector<std::string> &raw_measu
 
 Emu ParseOneMeasuredIsotope(const std::string& raw_measured_isotope, int line_number /* = -1 */) {
     std::stringstream line(raw_measured_isotope);
-    Emu measured_isotope;
-    getline(line, measured_isotope.name, ':');
+    std::string name;
+    getline(line, name, ':');
 
     std::string row_atom_states;
     getline(line, row_atom_states);
 
-    measured_isotope.atom_states.resize(row_atom_states.size());
+    AtomStates atom_states(row_atom_states.size());
     for (size_t atom_position = 0; atom_position < row_atom_states.size(); ++atom_position) {
         if (row_atom_states[atom_position] == '1') {
-            measured_isotope.atom_states[atom_position] = true;
+            atom_states[atom_position] = true;
         } else if (row_atom_states[atom_position] == '0') {
-            measured_isotope.atom_states[atom_position] = false;
+            atom_states[atom_position] = false;
         } else {
             throw std::runtime_error(
                 "Line: " + std::to_string(line_number) + " There is strange atom states in measured isotope!");
         }
     }
 
-    return measured_isotope;
+    return CreateEmu(name, atom_states);
 }
 
 std::string GetMeasuredIsotopeName(const Emu& emu) {
-    std::string name = emu.name;
-    name += ":";
-    for (char state : emu.atom_states) {
-        if (state) {
-            name += "1";
-        } else {
-            name += "0";
-        }
-    }
-    return name;
+    return GetEmuName(emu);
 }
 
 Matrix ParseCorrectionMatrix(const std::vector<std::string>& raw_matrix, const Delimiters& delimiters) {
@@ -122,7 +113,7 @@ std::vector<Measurement> ParseMeasurements(const std::vector<std::string>& raw_m
     for (const Emu &isotope : measured_isotopes) {
         Measurement new_measurement;
         new_measurement.emu = isotope;
-        for (size_t mass_shift = 0; mass_shift < isotope.atom_states.size() + 1; ++mass_shift) {
+        for (size_t mass_shift = 0; mass_shift < isotope.total_atoms + 1; ++mass_shift) {
             std::stringstream line(raw_measurements.at(line_number));
             ++line_number;
 
@@ -1,4 +1,7 @@
 #include <iostream>
+#include <stdexcept>
+#include <string>
+#include <utility>
 #include "simulator/generator.h"
 #include "simulator/generator_utilites.h"
 #include "simulator/simulator.h"
@@ -9,18 +12,24 @@ SimulatorGenerator::SimulatorGenerator(const GeneratorParameters& parameters) {
     parameters_ = parameters;
 
     std::vector<std::vector<int>> usefull_emus(parameters.networks.size());
-    std::vector<NetworkEmu> all_known_emus = InitializeInputEmus(parameters.input_mids);
+    EmuIndex<NetworkEmu> all_known_emus = InitializeInputEmus(parameters.input_mids);
+    EmuIndex<int> measurement_positions;
+    for (size_t position = 0; position < parameters.measurements.size(); ++position) {
+        measurement_positions.Insert(parameters.measurements[position].emu, position);
+    }
     for (size_t network_num = 0; network_num < parameters.networks.size(); ++network_num) {
         GeneratorNetworkData network_data;
         const std::vector<EmuReaction>& reactions = parameters.networks[network_num];
 
         generator_utilites::FillEmuLists(reactions, all_known_emus, network_data, usefull_emus);
         generator_utilites::CreateSymbolicMatrices(reactions, network_data);
-        generator_utilites::FillFinalEmu(parameters.measurements, network_data);
+        generator_utilites::FillFinalEmu(parameters.measurements, measurement_positions, network_data);
         generator_utilites::InsertIntoAllKnownEmus(network_data.unknown_emus, network_num, all_known_emus);
 
         int network_size = generator_utilites::FindNetworkSize(reactions);
         simulator_network_data_.emplace_back(FillSimulatorNetworkData(network_data, network_size));
+        simulator_network_data_.back().diff_free_fluxes =
+            generator_utilites::FindDiffFreeFluxes(simulator_network_data_.back(), simulator_network_data_);
     }
 
     for (size_t network_num = 0; network_num < parameters.networks.size(); ++network_num) {
@@ -28,14 +37,37 @@ SimulatorGenerator::SimulatorGenerator(const GeneratorParameters& parameters) {
             simulator_network_data_[network_num].usefull_emus.push_back(position);
         }
     }
+    mid_arena_layout_ = generator_utilites::CreateMidArenaLayout(parameters.input_mids, simulator_network_data_);
+    for (SimulatorNetworkData& network : simulator_network_data_) {
+        generator_utilites::PlaceConvolutionOthers(network);
+    }
+}
+
+SimulatorGenerator::SimulatorGenerator(const GeneratorParameters& parameters,
+                                       std::vector<SimulatorNetworkData> simulator_network_data,
+                                       MidArenaLayout mid_arena_layout)
+    : parameters_(parameters),
+      simulator_network_data_(std::move(simulator_network_data)),
+      mid_arena_layout_(std::move(mid_arena_layout)) {
+}
+
+const std::vector<SimulatorNetworkData>& SimulatorGenerator::GetNetworkData() const {
+    return simulator_network_data_;
+}
+
+const MidArenaLayout& SimulatorGenerator::GetMidArenaLayout() const {
+    return mid_arena_layout_;
 }
 
 Simulator SimulatorGenerator::Generate() const {
-    return Simulator(simulator_network_data_, parameters_.input_mids, parameters_.measured_isotopes.size());
+    return Simulator(simulator_network_data_, parameters_.input_mids, mid_arena_layout_,
+                     parameters_.measured_isotopes.size(),
+                     parameters_.big_network_solver,
+                     parameters_.total_threads);
 }
 
-std::vector<NetworkEmu> SimulatorGenerator::InitializeInputEmus(const std::vector<EmuAndMid>& input_mids) const {
-    std::vector<NetworkEmu> all_known_emus;
+EmuIndex<NetworkEmu> SimulatorGenerator::InitializeInputEmus(const std::vector<EmuAndMid>& input_mids) const {
+    EmuIndex<NetworkEmu> all_known_emus;
     for (size_t i = 0; i < input_mids.size(); ++i) {
         NetworkEmu input_emu;
         input_emu.emu = input_mids[i].emu;
@@ -43,7 +75,7 @@ std::vector<NetworkEmu> SimulatorGenerator::InitializeInputEmus(const std::vecto
         input_emu.order_in_usefull_emus = i;
         input_emu.order_in_X = i;
         input_emu.is_usefull = true;
-        all_known_emus.push_back(input_emu);
+        all_known_emus.Insert(input_emu.emu, input_emu);
     }
 
     return all_known_emus;
@@ -51,7 +83,7 @@ std::vector<NetworkEmu> SimulatorGenerator::InitializeInputEmus(const std::vecto
 
 SimulatorNetworkData SimulatorGenerator::FillSimulatorNetworkData(const GeneratorNetworkData& network_data, int network_size) const {
     SimulatorNetworkData simulator_network_data;
-    if (network_data.unknown_emus.size() > 10) {
+    if (network_data.unknown_emus.size() > parameters_.max_small_network_size) {
         simulator_network_data.size = NetworkSize::big;
     } else {
         simulator_network_data.size = NetworkSize::small;
@@ -61,6 +93,8 @@ SimulatorNetworkData SimulatorGenerator::FillSimulatorNetworkData(const Generato
     simulator_network_data.symbolic_B = network_data.symbolic_B;
     simulator_network_data.Y_data = network_data.Y_data;
     simulator_network_data.convolutions = network_data.convolutions;
+    simulator_network_data.dependencies = generator_utilites::FindNetworkDependencies(network_data.Y_data,
+                                                                                      network_data.convolutions);
 
     simulator_network_data.final_emus = network_data.final_emus;
     simulator_network_data.A_rows = network_data.unknown_emus.size();
@@ -69,47 +103,33 @@ SimulatorNetworkData SimulatorGenerator::FillSimulatorNetworkData(const Generato
     simulator_network_data.B_cols = network_data.known_emus.size() + network_data.convolutions.size();
     simulator_network_data.Y_rows = network_data.known_emus.size() + network_data.convolutions.size();
     simulator_network_data.Y_cols = network_size + 1;
+    if (simulator_network_data.Y_cols > max_inline_mid_size) {
+        throw std::runtime_error("Emus with " + std::to_string(network_size) + " atoms are too big for the simulator");
+    }
 
-    std::vector<DerivativeData> derivatives(parameters_.free_fluxes_id.size());
-    size_t position = 0;
-    for (int id : parameters_.free_fluxes_id) {
-        std::vector<Triplet> symbolic_dA = generator_utilites::GenerateDiffFluxMatrix(network_data.symbolic_A,
-                                                                              network_data.unknown_emus.size(),
-                                                                              network_data.unknown_emus.size(),
-                                                                              id, position, parameters_.free_flux_id_to_nullspace_position, parameters_.nullspace);
-
-        if (simulator_network_data.size == NetworkSize::small) {
-            Matrix &dA = derivatives[position].dA_small;
-            dA = Matrix::Zero(network_data.unknown_emus.size(), network_data.unknown_emus.size());
-            for (const Triplet &triplet : symbolic_dA) {
-                dA(triplet.row(), triplet.col()) = triplet.value();
-            }
-        } else if (simulator_network_data.size == NetworkSize::big) {
-            SparseMatrix &dA = derivatives[position].dA_big;
-            dA = SparseMatrix(simulator_network_data.A_rows, simulator_network_data.A_cols);
-            dA.setFromTriplets(symbolic_dA.begin(), symbolic_dA.end());
-        }
-
-        std::vector<Triplet> symbolic_dB = generator_utilites::GenerateDiffFluxMatrix(network_data.symbolic_B,
-                                                                              network_data.unknown_emus.size(),
-                                                                              network_data.known_emus.size() + network_data.convolutions.size(),
-                                                                              id, position, parameters_.free_flux_id_to_nullspace_position, parameters_.nullspace);
-        if (simulator_network_data.size == NetworkSize::small) {
-            Matrix &dB = derivatives[position].dB_small;
-            dB = Matrix::Zero(simulator_network_data.B_rows, simulator_network_data.B_cols);
-            for (const Triplet &triplet : symbolic_dB) {
-                dB(triplet.row(), triplet.col()) = triplet.value();
-            }
-        } else if (simulator_network_data.size == NetworkSize::big) {
-            SparseMatrix &dB = derivatives[position].dB_big;
-            dB = SparseMatrix(simulator_network_data.B_rows, simulator_network_data.B_cols);
-            dB.setFromTriplets(symbolic_dB.begin(), symbolic_dB.end());
-        }
-
-        ++position;
+    if (simulator_network_data.size == NetworkSize::big) {
+        simulator_network_data.A_pattern = generator_utilites::CreatePatternMatrix(simulator_network_data.symbolic_A,
+                                                                                   simulator_network_data.A_rows,
+                                                                                   simulator_network_data.A_cols);
+        simulator_network_data.B_pattern = generator_utilites::CreatePatternMatrix(simulator_network_data.symbolic_B,
+                                                                                   simulator_network_data.B_rows,
+                                                                                   simulator_network_data.B_cols);
     }
 
-    simulator_network_data.derivatives = derivatives;
+    simulator_network_data.A_operator = generator_utilites::CreateFluxMatrixOperator(simulator_network_data.symbolic_A,
+                                                                                     simulator_network_data.size,
+                                                                                     simulator_network_data.A_rows,
+                                                                                     simulator_network_data.A_cols,
+                                                                                     parameters_.free_fluxes_id,
+                                                                                     parameters_.free_flux_id_to_nullspace_position,
+                                                                                     parameters_.nullspace);
+    simulator_network_data.B_operator = generator_utilites::CreateFluxMatrixOperator(simulator_network_data.symbolic_B,
+                                                                                     simulator_network_data.size,
+                                                                                     simulator_network_data.B_rows,
+                                                                                     simulator_network_data.B_cols,
+                                                                                     parameters_.free_fluxes_id,
+                                                                                     parameters_.free_flux_id_to_nullspace_position,
+                                                                                     parameters_.nullspace);
     return simulator_network_data;
 }
 
@@ -2,11 +2,13 @@
 
 #include <vector>
 #include <algorithm>
-#include <set>
+#include <stdexcept>
+#include <string>
 #include <unordered_map>
 #include <iostream>
 
 #include "utilities/emu.h"
+#include "utilities/emu_index.h"
 #include "simulator/flux_combination.h"
 #include "simulator/simulation_data.h"
 #include "utilities/matrix.h"
@@ -16,16 +18,16 @@ namespace khnum {
 namespace generator_utilites {
 
 void FillEmuLists(const std::vector<EmuReaction>& reactions,
-                  std::vector<NetworkEmu>& all_known_emus,
+                  EmuIndex<NetworkEmu>& all_known_emus,
                   GeneratorNetworkData& network_data,
                   std::vector<std::vector<int>>& usefull_emus) {
-    std::set<Emu> seen_emus;
+    EmuIndex<bool> seen_emus;
     size_t reaction_num = 0;
     for (const EmuReaction &reaction : reactions) {
         if (reaction.left.size() == 1) {
-            if (seen_emus.find(reaction.left[0].emu) == seen_emus.end()) {
+            if (!seen_emus.Contains(reaction.left[0].emu)) {
                 CheckAndInsertEmu(reaction.left[0].emu, all_known_emus, network_data, usefull_emus);
-                seen_emus.insert(reaction.left[0].emu);
+                seen_emus.Insert(reaction.left[0].emu, true);
             }
         } else {
             Convolution convolution = ConvolveReaction(reaction, all_known_emus, usefull_emus);
@@ -40,9 +42,9 @@ void FillEmuLists(const std::vector<EmuReaction>& reactions,
             network_data.reaction_to_convolution[reaction_num] = convolutions.size() - 1;
         }
 
-        if (seen_emus.find(reaction.right.emu) == seen_emus.end()) {
+        if (!seen_emus.Contains(reaction.right.emu)) {
             network_data.unknown_emus.push_back(reaction.right.emu);
-            seen_emus.insert(reaction.right.emu);
+            seen_emus.Insert(reaction.right.emu, true);
         }
         ++reaction_num;
     }
@@ -50,16 +52,12 @@ void FillEmuLists(const std::vector<EmuReaction>& reactions,
 
 
 void CheckAndInsertEmu(const Emu &emu,
-                       std::vector<NetworkEmu>& all_known_emus,
+                       EmuIndex<NetworkEmu>& all_known_emus,
                        GeneratorNetworkData& network_data,
                        std::vector<std::vector<int>>& usefull_emus) {
-    auto it = std::find_if(all_known_emus.begin(),
-                           all_known_emus.end(),
-                           [&emu](const NetworkEmu& known_emu) {
-                               return known_emu.emu == emu;
-                           });
+    NetworkEmu* it = all_known_emus.Find(emu);
 
-    if (it != all_known_emus.end()) {
+    if (it) {
         if (!it->is_usefull) {
             it->is_usefull = true;
             usefull_emus[it->network].push_back(it->order_in_X);
@@ -74,16 +72,15 @@ void CheckAndInsertEmu(const Emu &emu,
 
 
 Convolution ConvolveReaction(const EmuReaction& reaction,
-                             std::vector<NetworkEmu>& all_known_emus,
+                             EmuIndex<NetworkEmu>& all_known_emus,
                              std::vector<std::vector<int>>& usefull_emus) {
     Convolution convolution;
     convolution.flux_id = reaction.id;
     for (const EmuSubstrate& emu : reaction.left) {
-        auto it = std::find_if(all_known_emus.begin(),
-                               all_known_emus.end(),
-                               [&emu](const NetworkEmu& known_emu) {
-                                   return known_emu.emu == emu.emu;
-                               });
+        NetworkEmu* it = all_known_emus.Find(emu.emu);
+        if (!it) {
+            throw std::runtime_error("Convolution of the emu " + GetEmuName(emu.emu) + " which isn't simulated before");
+        }
 
         if (!it->is_usefull) {
             it->is_usefull = true;
@@ -104,8 +101,10 @@ Convolution ConvolveReaction(const EmuReaction& reaction,
 void CreateSymbolicMatrices(const std::vector<EmuReaction>& reactions,
                             GeneratorNetworkData& network_data) {
     const std::vector<Emu>& unknown_emus = network_data.unknown_emus;
-    const std::vector<Emu> known_emus = network_data.known_emus;
-    const std::vector<Convolution> convolutions = network_data.convolutions;
+    const std::vector<Emu>& known_emus = network_data.known_emus;
+    const std::vector<Convolution>& convolutions = network_data.convolutions;
+    const EmuIndex<int> unknown_positions = CreatePositionIndex(unknown_emus);
+    const EmuIndex<int> known_positions = CreatePositionIndex(known_emus);
 
     const int unknown_size = unknown_emus.size();
     const int known_size = known_emus.size() + convolutions.size();
@@ -118,7 +117,7 @@ void CreateSymbolicMatrices(const std::vector<EmuReaction>& reactions,
 
     size_t reaction_num = 0;
     for (const EmuReaction &reaction : reactions) {
-        size_t position_of_product = FindUnknownEmuPosition(reaction.right.emu, unknown_emus);
+        size_t position_of_product = FindEmuPosition(reaction.right.emu, unknown_positions);
 
         FluxAndCoefficient substrate_element;
         substrate_element.coefficient = -reaction.rate;
@@ -136,9 +135,9 @@ void CreateSymbolicMatrices(const std::vector<EmuReaction>& reactions,
             EmuSubstrate substrate = reaction.left[0];
 
             // returns -1 if emu is unknown
-            int position_of_substrate = FindKnownEmuPosition(substrate.emu, known_emus);
+            int position_of_substrate = FindEmuPosition(substrate.emu, known_positions);
             if (position_of_substrate == -1) {
-                position_of_substrate = FindUnknownEmuPosition(substrate.emu, unknown_emus);
+                position_of_substrate = FindEmuPosition(substrate.emu, unknown_positions);
                 FluxAndCoefficient product;
                 product.coefficient = reaction.rate;
                 product.id = reaction.id;
@@ -159,29 +158,20 @@ void CreateSymbolicMatrices(const std::vector<EmuReaction>& reactions,
 
 
 
-int FindUnknownEmuPosition(const Emu &emu,
-                           const std::vector<Emu>& unknown_emus) {
-    auto position = find(unknown_emus.begin(),
-                         unknown_emus.end(),
-                         emu);
-    if (position != unknown_emus.end()) {
-        return position - unknown_emus.begin();
-    } else {
-        return -1;
+EmuIndex<int> CreatePositionIndex(const std::vector<Emu>& emus) {
+    EmuIndex<int> positions;
+    for (size_t position = 0; position < emus.size(); ++position) {
+        positions.Insert(emus[position], position);
     }
+    return positions;
 }
 
 
-int FindKnownEmuPosition(const Emu &emu,
-                         const std::vector<Emu>& known_emus) {
-    auto position = find_if(known_emus.begin(),
-                            known_emus.end(),
-                            [&emu](const Emu &known_emu) {
-                                return known_emu == emu;
-                            });
-
-    if (position != known_emus.end()) {
-        return position - known_emus.begin();
+int FindEmuPosition(const Emu &emu,
+                    const EmuIndex<int>& positions) {
+    const int* position = positions.Find(emu);
+    if (position) {
+        return *position;
     } else {
         return -1;
     }
@@ -204,22 +194,19 @@ void ConvertToSparseMatrix(const std::vector<std::vector<FluxCombination>>& dens
 
 
 void FillFinalEmu(const std::vector<Measurement>& measured_isotopes,
+                  const EmuIndex<int>& measurement_positions,
                   GeneratorNetworkData& network_data) {
     const std::vector<Emu>& unknown_emus = network_data.unknown_emus;
     for (size_t i = 0; i < unknown_emus.size(); ++i) {
-        Emu emu = unknown_emus[i];
-        auto it = std::find_if(measured_isotopes.begin(),
-                               measured_isotopes.end(),
-                               [&emu](const Measurement& measured_emu) {
-                                   return measured_emu.emu == emu;
-                               });
-
-        if (it != measured_isotopes.end()) {
+        const Emu& emu = unknown_emus[i];
+        const int measurement_position = FindEmuPosition(emu, measurement_positions);
+
+        if (measurement_position != -1) {
             FinalEmu final_emu;
             final_emu.emu = emu;
             final_emu.order_in_X = i;
-            final_emu.position_in_result = it - measured_isotopes.begin();
-            final_emu.correction_matrix = it->correction_matrix;
+            final_emu.position_in_result = measurement_position;
+            final_emu.correction_matrix = measured_isotopes[measurement_position].correction_matrix;
             network_data.final_emus.push_back(final_emu);
         }
     }
@@ -227,44 +214,178 @@ void FillFinalEmu(const std::vector<Measurement>& measured_isotopes,
 
 void InsertIntoAllKnownEmus(const std::vector<Emu>& unknown_emus,
                             int network_num,
-                            std::vector<NetworkEmu>& all_known_emus) {
+                            EmuIndex<NetworkEmu>& all_known_emus) {
     for (size_t i = 0; i < unknown_emus.size(); ++i) {
         NetworkEmu new_emu;
         new_emu.order_in_X = i;
         new_emu.emu = unknown_emus[i];
         new_emu.is_usefull = false;
         new_emu.network = network_num;
-        all_known_emus.push_back(new_emu);
+        all_known_emus.Insert(new_emu.emu, new_emu);
     }
 }
 
 int FindNetworkSize(const std::vector<EmuReaction>& reactions) {
-    int current_size = 0;
-    for (const bool state : reactions[0].right.emu.atom_states) {
-        current_size += static_cast<int>(state);
+    return GetEmuSize(reactions[0].right.emu);
+}
+
+SparseMatrix CreatePatternMatrix(std::vector<FluxCombination>& symbolic_matrix,
+                                 size_t rows, size_t cols) {
+    std::vector<Triplet> triplets;
+    for (const FluxCombination& combination : symbolic_matrix) {
+        triplets.push_back(Triplet(combination.i, combination.j, 1.0));
+    }
+    SparseMatrix pattern(rows, cols);
+    pattern.setFromTriplets(triplets.begin(), triplets.end());
+    pattern.makeCompressed();
+
+    for (FluxCombination& combination : symbolic_matrix) {
+        const SparseMatrix::StorageIndex* column_begin = pattern.innerIndexPtr() + pattern.outerIndexPtr()[combination.j];
+        const SparseMatrix::StorageIndex* column_end = pattern.innerIndexPtr() + pattern.outerIndexPtr()[combination.j + 1];
+        const SparseMatrix::StorageIndex* position = std::lower_bound(column_begin, column_end, combination.i);
+        combination.value_position = position - pattern.innerIndexPtr();
     }
-    return current_size;
+    return pattern;
 }
 
-std::vector<Triplet> GenerateDiffFluxMatrix(const std::vector<FluxCombination>& symbolic_matrix,
-                              int rows, int cols, int id, int position, const std::vector<int>& id_to_pos,
-                              const Matrix& nullspace) {
-    std::vector<Triplet> matrix;
+FluxMatrixOperator CreateFluxMatrixOperator(const std::vector<FluxCombination>& symbolic_matrix,
+                                            NetworkSize size, size_t rows, size_t cols,
+                                            const std::vector<int>& free_fluxes_id,
+                                            const std::vector<int>& id_to_pos,
+                                            const Matrix& nullspace) {
+    std::unordered_map<int, int> id_to_free_position;
+    for (size_t position = 0; position < free_fluxes_id.size(); ++position) {
+        id_to_free_position[free_fluxes_id[position]] = position;
+    }
+
+    const size_t total_values = size == NetworkSize::small ? rows * cols : symbolic_matrix.size();
+    FluxMatrixOperator flux_operator;
+    flux_operator.offset = Eigen::VectorXd::Zero(total_values);
+    flux_operator.rows.resize(total_values);
+    flux_operator.cols.resize(total_values);
+
+    std::vector<Triplet> coefficients;
     for (const FluxCombination& combination : symbolic_matrix) {
-        double value = 0.0;
+        const int value = size == NetworkSize::small ? combination.i + combination.j * rows
+                                                     : combination.value_position;
+        flux_operator.rows[value] = combination.i;
+        flux_operator.cols[value] = combination.j;
         for (const FluxAndCoefficient& flux : combination.fluxes) {
             if (id_to_pos[flux.id] == -1) {
-                if (flux.id == id) {
-                    value += flux.coefficient;
+                auto free_position = id_to_free_position.find(flux.id);
+                if (free_position != id_to_free_position.end()) {
+                    coefficients.push_back(Triplet(value, free_position->second, flux.coefficient));
+                } else {
+                    flux_operator.offset(value) += flux.coefficient;
                 }
             } else {
-                value += -nullspace(id_to_pos[flux.id], position) * flux.coefficient;
+                for (int free_flux = 0; free_flux < nullspace.cols(); ++free_flux) {
+                    const double coefficient = -nullspace(id_to_pos[flux.id], free_flux) * flux.coefficient;
+                    if (coefficient != 0.0) {
+                        coefficients.push_back(Triplet(value, free_flux, coefficient));
+                    }
+                }
+            }
+        }
+    }
+
+    // duplicates are summed up
+    flux_operator.coefficients = SparseMatrix(total_values, free_fluxes_id.size());
+    flux_operator.coefficients.setFromTriplets(coefficients.begin(), coefficients.end());
+    flux_operator.coefficients.prune(0.0);
+    return flux_operator;
+}
+std::vector<int> FindNetworkDependencies(const std::vector<PositionOfSavedEmu>& Y_data,
+                                         const std::vector<Convolution>& convolutions) {
+    std::vector<int> dependencies;
+    for (const PositionOfSavedEmu& known_emu : Y_data) {
+        if (known_emu.network != -1) {
+            dependencies.push_back(known_emu.network);
+        }
+    }
+    for (const Convolution& convolution : convolutions) {
+        for (const PositionOfSavedEmu& emu : convolution.elements) {
+            if (emu.network != -1) {
+                dependencies.push_back(emu.network);
+            }
+        }
+    }
+
+    std::sort(dependencies.begin(), dependencies.end());
+    dependencies.erase(std::unique(dependencies.begin(), dependencies.end()), dependencies.end());
+    return dependencies;
+}
+std::vector<int> FindDiffFreeFluxes(const SimulatorNetworkData& network,
+                                    const std::vector<SimulatorNetworkData>& previous_networks) {
+    const int total_free_fluxes = network.A_operator.coefficients.cols();
+    std::vector<bool> is_diff_free_flux(total_free_fluxes, false);
+    for (int free_flux = 0; free_flux < total_free_fluxes; ++free_flux) {
+        is_diff_free_flux[free_flux] = network.A_operator.coefficients.col(free_flux).nonZeros() > 0 ||
+                                       network.B_operator.coefficients.col(free_flux).nonZeros() > 0;
+    }
+    for (int dependency : network.dependencies) {
+        for (int free_flux : previous_networks[dependency].diff_free_fluxes) {
+            is_diff_free_flux[free_flux] = true;
+        }
+    }
+
+    std::vector<int> diff_free_fluxes;
+    for (int free_flux = 0; free_flux < total_free_fluxes; ++free_flux) {
+        if (is_diff_free_flux[free_flux]) {
+            diff_free_fluxes.push_back(free_flux);
+        }
+    }
+    return diff_free_fluxes;
+}
+
+MidArenaLayout CreateMidArenaLayout(const std::vector<EmuAndMid>& input_mids,
+                                    std::vector<SimulatorNetworkData>& networks) {
+    MidArenaLayout layout;
+    for (const EmuAndMid& input_mid : input_mids) {
+        layout.input_offsets.push_back(layout.size);
+        layout.size += input_mid.mid.size();
+    }
+    for (SimulatorNetworkData& network : networks) {
+        network.saved_mids_offset = layout.size;
+        layout.size += network.usefull_emus.size() * network.Y_cols;
+    }
+
+    auto place_emu = [&](PositionOfSavedEmu& emu) {
+        if (emu.network == -1) {
+            emu.offset = layout.input_offsets[emu.position];
+            emu.length = input_mids[emu.position].mid.size();
+        } else {
+            const SimulatorNetworkData& saved_network = networks[emu.network];
+            emu.offset = saved_network.saved_mids_offset + emu.position * saved_network.Y_cols;
+            emu.length = saved_network.Y_cols;
+        }
+    };
+    for (SimulatorNetworkData& network : networks) {
+        for (PositionOfSavedEmu& known_emu : network.Y_data) {
+            place_emu(known_emu);
+        }
+        for (Convolution& convolution : network.convolutions) {
+            for (PositionOfSavedEmu& emu : convolution.elements) {
+                place_emu(emu);
             }
+        }
+    }
+    return layout;
+}
 
+void PlaceConvolutionOthers(SimulatorNetworkData& network) {
+    network.convolution_others_size = 0;
+    for (Convolution& convolution : network.convolutions) {
+        int convolution_length = 1;
+        for (const PositionOfSavedEmu& emu : convolution.elements) {
+            convolution_length += emu.length - 1;
+        }
+        convolution.others_offsets.clear();
+        for (const PositionOfSavedEmu& emu : convolution.elements) {
+            convolution.others_offsets.push_back(network.convolution_others_size);
+            network.convolution_others_size += convolution_length - emu.length + 1;
         }
-        matrix.push_back(Triplet(combination.i, combination.j, value));
     }
-    return matrix;
 }
 }
-}
\ No newline at end of file
+}
@@ -1,152 +1,431 @@
 #include "simulator/simulator.h"
 
+#include <algorithm>
 #include <vector>
 #include <iostream>
 #include <chrono>
+#include <stdexcept>
 
 #include "simulator/simulation_data.h"
 #include "simulator/simulator_utilities.h"
 
 namespace khnum {
+namespace {
+// Unlike a not converged iterative solve, which is still a usable guess, a failed LU has no solution
+void CheckFactorization(const DirectSolver& solver) {
+    if (solver.info() != Eigen::Success) {
+        throw std::runtime_error("Can't factorize the matrix of a big network: " + solver.lastErrorMessage());
+    }
+}
+}
 
 
-SimulatorResult Simulator::CalculateMids(const std::vector<Flux> &fluxes, bool calculate_jacobian) {
-    SimulatorResult result;
-    std::vector<double> sums(total_mids_to_simulate_);
-    std::vector<EmuAndMid>& simulated_mids = result.simulated_mids;
-    simulated_mids.resize(total_mids_to_simulate_);
-
-    std::vector<std::vector<EmuAndMid>>& diff_results = result.diff_results;
-    diff_results.resize(total_free_fluxes_);
-    for (std::vector<EmuAndMid>& vec : diff_results) {
-        vec.resize(total_mids_to_simulate_);
+const SimulatorResult& Simulator::CalculateMids(const Eigen::VectorXd &free_fluxes, bool calculate_jacobian) {
+    if (!thread_pool_) {
+        for (size_t network_num = 0; network_num < total_networks_; ++network_num) {
+            CalculateNetwork(network_num, free_fluxes, calculate_jacobian);
+        }
+        return result_;
     }
 
-    std::vector<std::vector<Mid>> saved_mids(total_networks_);
-    // contains MID's derivative at [free_flux][network][i]
-    std::vector<std::vector<std::vector<Mid>>> saved_diff_mids(total_free_fluxes_);
-    for (auto& vec : saved_diff_mids) {
-        vec.resize(total_networks_);
+    // networks write only their own workspaces and results, so any network with simulated dependencies may run
+    current_free_fluxes_ = &free_fluxes;
+    current_calculate_jacobian_ = calculate_jacobian;
+    for (size_t network_num = 0; network_num < total_networks_; ++network_num) {
+        remaining_dependencies_[network_num] = networks_[network_num].dependencies.size();
     }
-    size_t total_big_networks = 0;
     for (size_t network_num = 0; network_num < total_networks_; ++network_num) {
+        if (networks_[network_num].dependencies.empty()) {
+            thread_pool_->Submit([this, network_num] { RunNetworkTask(network_num); });
+        }
+    }
+    thread_pool_->Wait();
+    return result_;
+}
+
+void Simulator::RunNetworkTask(size_t network_num) {
+    CalculateNetwork(network_num, *current_free_fluxes_, current_calculate_jacobian_);
+    for (size_t dependent_network : dependent_networks_[network_num]) {
+        if (--remaining_dependencies_[dependent_network] == 0) {
+            thread_pool_->Submit([this, dependent_network] { RunNetworkTask(dependent_network); });
+        }
+    }
+}
+
+void Simulator::CalculateNetwork(size_t network_num, const Eigen::VectorXd &free_fluxes, bool calculate_jacobian) {
+    const SimulatorNetworkData &network = networks_[network_num];
+    NetworkWorkspace &workspace = workspaces_[network_num];
+    if (network.size == NetworkSize::small) {
+        Matrix &A = workspace.A;
+        simulator_utilities::FillFluxMatrix(network.A_operator, free_fluxes, A.data());
+
+        Matrix &B = workspace.B;
+        simulator_utilities::FillFluxMatrix(network.B_operator, free_fluxes, B.data());
+
+        Matrix &Y = workspace.Y;
+        simulator_utilities::FillYMatrix(network.Y_data, saved_mids_.data(),
+                                         network.convolutions, workspace.buffers, Y);
+        if (calculate_jacobian) {
+            simulator_utilities::FillConvolutionOthers(network.convolutions, saved_mids_.data(), workspace.buffers,
+                                                       workspace.convolution_others.data());
+        }
+
+        workspace.BY.noalias() = B * Y;
+        workspace.small_solver->Factorize(A);
+        Matrix &X = workspace.X;
+        workspace.small_solver->Solve(workspace.BY, X);
+        simulator_utilities::SaveNewEmus(X, network.usefull_emus, network.final_emus,
+                                         saved_mids_.data() + network.saved_mids_offset,
+                                         result_.simulated_mids, sums_);
+    } else {
+        SparseMatrix &A = workspace.sparse_A;
+        simulator_utilities::FillFluxMatrix(network.A_operator, free_fluxes, A.valuePtr());
+
+        SparseMatrix &B = workspace.sparse_B;
+        simulator_utilities::FillFluxMatrix(network.B_operator, free_fluxes, B.valuePtr());
+
+        Matrix &Y = workspace.Y;
+        simulator_utilities::FillYMatrix(network.Y_data, saved_mids_.data(),
+                                         network.convolutions, workspace.buffers, Y);
+        if (calculate_jacobian) {
+            simulator_utilities::FillConvolutionOthers(network.convolutions, saved_mids_.data(), workspace.buffers,
+                                                       workspace.convolution_others.data());
+        }
+
+        workspace.BY.noalias() = B * Y;
+        const size_t big_network = solver_positions_[network_num];
+        FactorizeBigNetwork(big_network, A);
+        Matrix &X = workspace.X;
+        X.setConstant(1.0 / network.Y_cols);
+        SolveBigNetwork(big_network, workspace.BY, X);
+
+        simulator_utilities::SaveNewEmus(X, network.usefull_emus, network.final_emus,
+                                         saved_mids_.data() + network.saved_mids_offset,
+                                         result_.simulated_mids, sums_);
+    }
+
+    if (calculate_jacobian) {
+        CalculateNetworkDiff(network_num);
+    }
+}
+
+void Simulator::CalculateNetworkDiff(size_t network_num) {
+    const SimulatorNetworkData &network = networks_[network_num];
+    NetworkWorkspace &workspace = workspaces_[network_num];
+    // the iterative solver keeps the state of the last solve in itself
+    const bool is_iterative = network.size == NetworkSize::big && big_network_solver_ == BigNetworkSolver::iterative;
+    // derivatives by the other free fluxes are structurally zero and stay zero since the initialization
+    const size_t total_diff_fluxes = network.diff_free_fluxes.size();
+    const size_t total_chunks = std::min(jacobian_chunks_, total_diff_fluxes);
+    if (total_chunks == 0) {
+        return;
+    }
+    if (total_chunks == 1 || is_iterative) {
+        CalculateNetworkDiff(network_num, 0, total_diff_fluxes, workspace.buffers);
+        return;
+    }
+
+    ThreadPool::TaskGroup chunks(*thread_pool_);
+    for (size_t chunk = 0; chunk < total_chunks; ++chunk) {
+        chunks.Submit([this, network_num, chunk, total_chunks] {
+            const size_t total_diff_fluxes = networks_[network_num].diff_free_fluxes.size();
+            CalculateNetworkDiff(network_num,
+                                 chunk * total_diff_fluxes / total_chunks,
+                                 (chunk + 1) * total_diff_fluxes / total_chunks,
+                                 workspaces_[network_num].chunk_buffers[chunk]);
+        });
+    }
+    chunks.Wait();
+}
+
+void Simulator::CalculateNetworkDiff(size_t network_num, size_t first_position, size_t end_position,
+                                     ConvolutionBuffers &buffers) {
+    const SimulatorNetworkData &network = networks_[network_num];
+    NetworkWorkspace &workspace = workspaces_[network_num];
+    const size_t first_column = first_position * network.Y_cols;
+    const size_t total_columns = (end_position - first_position) * network.Y_cols;
+    auto right_part = workspace.right_part.middleCols(first_column, total_columns);
+    auto dX = workspace.dX.middleCols(first_column, total_columns);
+    if (network.size == NetworkSize::small) {
+        FillDiffRightPart(network, workspace.B, workspace, first_position, end_position, buffers);
+        workspace.small_solver->Solve(right_part, dX);
+    } else {
+        FillDiffRightPart(network, workspace.sparse_B, workspace, first_position, end_position, buffers);
+        dX.setZero();
+        SolveBigNetwork(solver_positions_[network_num], right_part, dX);
+    }
+    SaveNewDiffEmus(network_num, first_position, end_position);
+}
+
+const Eigen::VectorXd& Simulator::CalculateTransposedJacobianProduct(const Eigen::VectorXd &free_fluxes,
+                                                                     const std::vector<Mid> &weights) {
+    CalculateMids(free_fluxes, false);
+    return RunAdjointSweep(weights);
+}
+
+const Eigen::VectorXd& Simulator::CalculateSSRGradient(const Eigen::VectorXd &free_fluxes,
+                                                       const std::vector<Measurement> &measurements) {
+    CalculateMids(free_fluxes, false);
+    for (size_t isotope = 0; isotope < measurements.size(); ++isotope) {
+        const Measurement &measurement = measurements[isotope];
+        const Mid &simulated_mid = result_.simulated_mids[isotope].mid;
+        Mid &weight = ssr_weights_[isotope];
+        for (size_t mass_shift = 0; mass_shift < weight.size(); ++mass_shift) {
+            const double error = measurement.errors[mass_shift];
+            weight[mass_shift] = 2.0 * (simulated_mid[mass_shift] - measurement.mid[mass_shift]) / (error * error);
+        }
+    }
+    return RunAdjointSweep(ssr_weights_);
+}
+
+const Eigen::VectorXd& Simulator::RunAdjointSweep(const std::vector<Mid> &weights) {
+    gradient_.setZero();
+    std::fill(saved_adjoint_mids_.begin(), saved_adjoint_mids_.end(), 0.0);
+
+    // networks only depend on the previous ones, so the adjoints are complete when a network is reached
+    for (size_t network_num = total_networks_; network_num-- > 0;) {
         const SimulatorNetworkData &network = networks_[network_num];
+        NetworkWorkspace &workspace = workspaces_[network_num];
+
+        Matrix &X_adjoint = workspace.X_adjoint;
+        X_adjoint.setZero();
+        simulator_utilities::AddFinalEmusAdjoint(network.final_emus, result_.simulated_mids, sums_, weights, X_adjoint);
+        simulator_utilities::AddSavedEmusAdjoint(network.usefull_emus,
+                                                 saved_adjoint_mids_.data() + network.saved_mids_offset, X_adjoint);
+        if (X_adjoint.isZero(0.0)) {
+            continue;
+        }
+
+        Matrix &X_multiplier = workspace.X_multiplier;
         if (network.size == NetworkSize::small) {
-            Matrix A = Matrix::Zero(network.A_rows, network.A_cols);
-            simulator_utilities::FillSmallFluxMatrix(network.symbolic_A, fluxes, A);
-
-            Matrix B = Matrix::Zero(network.B_rows, network.B_cols);
-            simulator_utilities::FillSmallFluxMatrix(network.symbolic_B, fluxes, B);
-
-            Matrix Y = Matrix::Zero(network.Y_rows, network.Y_cols);
-            simulator_utilities::FillYMatrix(network.Y_data,input_mids_, saved_mids,
-                                             network.convolutions, Y);
-
-            const Matrix BY = B * Y;
-            auto A_decomposition = A.householderQr();
-            const Matrix X = A_decomposition.solve(BY);
-            simulator_utilities::SaveNewEmus(X, network.usefull_emus, network.final_emus, saved_mids[network_num], simulated_mids,
-                                             sums);
-            if (!calculate_jacobian) {
-                continue;
-            }
-            Matrix dY = Matrix::Zero(network.Y_rows, network.Y_cols);
-            for (size_t flux = 0; flux < total_free_fluxes_; ++flux) {
-                const DerivativeData &derivatives = network.derivatives.at(flux);
-
-                dY.setZero();
-                simulator_utilities::FillDiffYMatrix(network.Y_data, saved_diff_mids[flux], network.convolutions,
-                                                     input_mids_, saved_mids, dY);
-
-                // Right Part of A * dX = (...)
-                Matrix RightPart = derivatives.dB_small * Y + B * dY - derivatives.dA_small * X;
-                Matrix dX = A_decomposition.solve(RightPart);
-                simulator_utilities::SaveNewDiffEmus(dX, network.usefull_emus, network.final_emus, simulated_mids,
-                                                     sums, saved_diff_mids[flux][network_num], diff_results[flux]);
-            }
+            workspace.small_solver->SolveTransposed(X_adjoint, X_multiplier);
+            workspace.Y_adjoint.noalias() = workspace.B.transpose() * X_multiplier;
         } else {
-            SparseMatrix A(network.A_rows, network.A_cols);
-            std::vector<Triplet> A_triplets;
-            simulator_utilities::FillBigFluxMatrix(network.symbolic_A, fluxes, A_triplets);
-            A.setFromTriplets(A_triplets.begin(), A_triplets.end());
-
-            SparseMatrix B(network.B_rows, network.B_cols);
-            std::vector<Triplet> B_triplets;
-            simulator_utilities::FillBigFluxMatrix(network.symbolic_B, fluxes, B_triplets);
-            B.setFromTriplets(B_triplets.begin(), B_triplets.end());
-
-            Matrix Y = Matrix::Zero(network.Y_rows, network.Y_cols);
-            simulator_utilities::FillYMatrix(network.Y_data,input_mids_, saved_mids,
-                                             network.convolutions, Y);
-
-            const Matrix BY = B * Y;
-            Eigen::BiCGSTAB<SparseMatrix, Eigen::IncompleteLUT<SparseMatrix::Scalar>> &solver = solvers_[total_big_networks++];
-            solver.factorize(A);
-            const Matrix guess = Matrix::Constant(network.A_rows, network.Y_cols, 1.0 / network.Y_cols);
-
-            const Matrix X = solver.solveWithGuess(BY, guess);
-            if (solver.info() != Eigen::Success) {
-                std::cout << "NOT SUCCESS " << solver.info() << std::endl;
-                std::cout << solver.error() << std::endl;
-                std::cout << solver.iterations() << std::endl;
-            }
-
-            simulator_utilities::SaveNewEmus(X, network.usefull_emus, network.final_emus, saved_mids[network_num], simulated_mids,
-                                             sums);
-            if (!calculate_jacobian) {
-                continue;
-            }
-            Matrix dY = Matrix::Zero(network.Y_rows, network.Y_cols);
-            for (size_t flux = 0; flux < total_free_fluxes_; ++flux) {
-                const DerivativeData &derivatives = network.derivatives.at(flux);
-
-                dY.setZero();
-                simulator_utilities::FillDiffYMatrix(network.Y_data, saved_diff_mids[flux], network.convolutions,
-                                                     input_mids_, saved_mids, dY);
-
-                // Right Part of A * dX = (...)
-                Matrix RightPart = derivatives.dB_big * Y - derivatives.dA_big * X + B * dY;
-                Matrix dX = solver.solve(RightPart);
-
-
-                if (solver.info() != Eigen::Success) {
-                    std::cout << "NOT SUCCESS " << solver.info() << std::endl;
-                    std::cout << solver.error() << std::endl;
-                    std::cout << solver.iterations() << std::endl;
-                }
-                simulator_utilities::SaveNewDiffEmus(dX, network.usefull_emus, network.final_emus, simulated_mids,
-                                                     sums, saved_diff_mids[flux][network_num], diff_results[flux]);
+            SparseMatrix &A_transposed = workspace.sparse_A_transposed;
+            const double* A_values = workspace.sparse_A.valuePtr();
+            for (size_t value = 0; value < workspace.A_transposed_positions.size(); ++value) {
+                A_transposed.valuePtr()[value] = A_values[workspace.A_transposed_positions[value]];
             }
-
+            DirectSolver &solver = transposed_solvers_[solver_positions_[network_num]];
+            solver.factorize(A_transposed);
+            CheckFactorization(solver);
+            X_multiplier = solver.solve(X_adjoint);
+            workspace.Y_adjoint.noalias() = workspace.sparse_B.transpose() * X_multiplier;
         }
 
+        // d(loss) / dv = <X_multiplier, dB / dv * Y - dA / dv * X>
+        simulator_utilities::AddDiffFluxMatrixInnerProducts(network.B_operator, 1.0, X_multiplier, workspace.Y, gradient_);
+        simulator_utilities::AddDiffFluxMatrixInnerProducts(network.A_operator, -1.0, X_multiplier, workspace.X, gradient_);
+        simulator_utilities::FillConvolutionOthers(network.convolutions, saved_mids_.data(), workspace.buffers,
+                                                   workspace.convolution_others.data());
+        simulator_utilities::AddYMatrixAdjoint(network.Y_data, network.convolutions, workspace.convolution_others.data(),
+                                               workspace.Y_adjoint, saved_adjoint_mids_.data());
+    }
+    return gradient_;
+}
 
+template <typename FluxMatrix>
+void Simulator::FillDiffRightPart(const SimulatorNetworkData& network,
+                                  const FluxMatrix& B,
+                                  NetworkWorkspace& workspace,
+                                  size_t first_position,
+                                  size_t end_position,
+                                  ConvolutionBuffers& buffers) {
+    const size_t mid_size = network.Y_cols;
+    const size_t first_column = first_position * mid_size;
+    const size_t total_columns = (end_position - first_position) * mid_size;
+    auto dY = workspace.dY.middleCols(first_column, total_columns);
+    dY.setZero();
+    for (size_t position = first_position; position < end_position; ++position) {
+        const int flux = network.diff_free_fluxes[position];
+        simulator_utilities::FillDiffYMatrix(network.Y_data, saved_diff_mids_.data() + flux * mid_arena_layout_.size,
+                                             network.convolutions, workspace.convolution_others.data(), buffers,
+                                             workspace.dY.middleCols(position * mid_size, mid_size));
+    }
 
+    Matrix &right_part = workspace.right_part;
+    right_part.middleCols(first_column, total_columns).noalias() = B * dY;
+    for (size_t position = first_position; position < end_position; ++position) {
+        const int flux = network.diff_free_fluxes[position];
+        auto flux_right_part = right_part.middleCols(position * mid_size, mid_size);
+        simulator_utilities::AddDiffFluxMatrixProduct(network.B_operator, flux, 1.0, workspace.Y, flux_right_part);
+        simulator_utilities::AddDiffFluxMatrixProduct(network.A_operator, flux, -1.0, workspace.X, flux_right_part);
+    }
+}
+
+void Simulator::SaveNewDiffEmus(size_t network_num, size_t first_position, size_t end_position) {
+    const SimulatorNetworkData &network = networks_[network_num];
+    const Matrix &dX = workspaces_[network_num].dX;
+    for (size_t position = first_position; position < end_position; ++position) {
+        const int flux = network.diff_free_fluxes[position];
+        simulator_utilities::SaveNewDiffEmus(dX.middleCols(position * network.Y_cols, network.Y_cols),
+                                             network.usefull_emus, network.final_emus,
+                                             result_.simulated_mids, sums_,
+                                             saved_diff_mids_.data() + flux * mid_arena_layout_.size +
+                                                 network.saved_mids_offset,
+                                             result_.diff_results[flux]);
     }
-    return result;
 }
 
 Simulator::Simulator(const std::vector<SimulatorNetworkData>& networks,
                      const std::vector<EmuAndMid>& input_mids,
-                     const size_t total_mids_to_simulate) :
+                     const MidArenaLayout& mid_arena_layout,
+                     const size_t total_mids_to_simulate,
+                     BigNetworkSolver big_network_solver,
+                     size_t total_threads) :
                                             total_networks_{networks.size()},
-                                            total_free_fluxes_{networks[0].derivatives.size()},
+                                            total_free_fluxes_{static_cast<size_t>(networks[0].A_operator.coefficients.cols())},
                                             total_mids_to_simulate_{total_mids_to_simulate},
                                             input_mids_{input_mids},
+                                            mid_arena_layout_{mid_arena_layout},
                                             networks_{networks},
-                                            solvers_{networks_.size()}{
-    int total_big_networks = 0;
-    for (const SimulatorNetworkData &network : networks) {
-        if (network.size == NetworkSize::big) {
-            SparseMatrix A(network.A_rows, network.A_cols);
-            std::vector<Triplet> A_triplets;
-            for (const FluxCombination &fc : network.symbolic_A) {
-                A_triplets.push_back(Triplet(fc.i, fc.j, 1));
+                                            big_network_solver_{big_network_solver} {
+    InitializeWorkspace();
+
+    size_t total_big_networks = 0;
+    solver_positions_.assign(total_networks_, -1);
+    for (size_t network_num = 0; network_num < total_networks_; ++network_num) {
+        if (networks_[network_num].size == NetworkSize::big) {
+            solver_positions_[network_num] = total_big_networks++;
+        }
+    }
+
+    // Eigen solvers are not copyable, so the vectors are created at once with the final size
+    if (big_network_solver_ == BigNetworkSolver::iterative) {
+        solvers_ = std::vector<IterativeSolver>(total_big_networks);
+    } else {
+        direct_solvers_ = std::vector<DirectSolver>(total_big_networks);
+    }
+    transposed_solvers_ = std::vector<DirectSolver>(total_big_networks);
+
+    for (size_t network_num = 0; network_num < total_networks_; ++network_num) {
+        if (networks_[network_num].size == NetworkSize::big) {
+            const size_t big_network = solver_positions_[network_num];
+            // The sparsity pattern never changes, so the ordering is computed only once
+            if (big_network_solver_ == BigNetworkSolver::iterative) {
+                solvers_[big_network].analyzePattern(workspaces_[network_num].sparse_A);
+            } else {
+                direct_solvers_[big_network].analyzePattern(workspaces_[network_num].sparse_A);
+            }
+            transposed_solvers_[big_network].analyzePattern(workspaces_[network_num].sparse_A_transposed);
+        }
+    }
+
+    if (total_threads > 1) {
+        CreateThreadPool(total_threads);
+    }
+}
+
+void Simulator::SetJacobianThreads(size_t total_threads) {
+    jacobian_chunks_ = std::max<size_t>(1, std::min(total_threads, total_free_fluxes_));
+    if (total_threads > 1 && (!thread_pool_ || thread_pool_->GetThreadsCount() < total_threads)) {
+        CreateThreadPool(total_threads);
+    }
+
+    for (NetworkWorkspace& workspace : workspaces_) {
+        workspace.chunk_buffers.resize(jacobian_chunks_);
+    }
+}
+
+void Simulator::CreateThreadPool(size_t total_threads) {
+    thread_pool_ = std::make_unique<ThreadPool>(total_threads);
+    dependent_networks_.assign(total_networks_, {});
+    for (size_t network_num = 0; network_num < total_networks_; ++network_num) {
+        for (int dependency : networks_[network_num].dependencies) {
+            dependent_networks_[dependency].push_back(network_num);
+        }
+    }
+    remaining_dependencies_ = std::vector<std::atomic<size_t>>(total_networks_);
+}
+
+void Simulator::FactorizeBigNetwork(size_t big_network, const SparseMatrix& A) {
+    if (big_network_solver_ == BigNetworkSolver::iterative) {
+        solvers_[big_network].factorize(A);
+    } else {
+        DirectSolver& solver = direct_solvers_[big_network];
+        solver.factorize(A);
+        CheckFactorization(solver);
+    }
+}
+
+void Simulator::SolveBigNetwork(size_t big_network,
+                                const Eigen::Ref<const Matrix>& right_part,
+                                Eigen::Ref<Matrix> result_inout) {
+    if (big_network_solver_ == BigNetworkSolver::iterative) {
+        IterativeSolver& solver = solvers_[big_network];
+        result_inout = solver.solveWithGuess(right_part, result_inout);
+        if (solver.info() != Eigen::Success) {
+            std::cout << "NOT SUCCESS " << solver.info() << std::endl;
+            std::cout << solver.error() << std::endl;
+            std::cout << solver.iterations() << std::endl;
+        }
+    } else {
+        result_inout = direct_solvers_[big_network].solve(right_part);
+    }
+}
+
+void Simulator::InitializeWorkspace() {
+    result_.simulated_mids.resize(total_mids_to_simulate_);
+    result_.diff_results.resize(total_free_fluxes_);
+    for (std::vector<EmuAndMid>& vec : result_.diff_results) {
+        vec.resize(total_mids_to_simulate_);
+    }
+    sums_.resize(total_mids_to_simulate_);
+
+    saved_mids_.assign(mid_arena_layout_.size, 0.0);
+    for (size_t input = 0; input < input_mids_.size(); ++input) {
+        std::copy(input_mids_[input].mid.begin(), input_mids_[input].mid.end(),
+                  saved_mids_.begin() + mid_arena_layout_.input_offsets[input]);
+    }
+    saved_adjoint_mids_.assign(mid_arena_layout_.size, 0.0);
+    saved_diff_mids_.assign(total_free_fluxes_ * mid_arena_layout_.size, 0.0);
+    ssr_weights_.resize(total_mids_to_simulate_);
+    gradient_ = Eigen::VectorXd::Zero(total_free_fluxes_);
+
+    workspaces_.resize(total_networks_);
+    for (size_t network_num = 0; network_num < total_networks_; ++network_num) {
+        const SimulatorNetworkData &network = networks_[network_num];
+        NetworkWorkspace &workspace = workspaces_[network_num];
+
+        if (network.size == NetworkSize::small) {
+            workspace.A = Matrix::Zero(network.A_rows, network.A_cols);
+            workspace.B = Matrix::Zero(network.B_rows, network.B_cols);
+            workspace.small_solver = CreateSmallNetworkSolver(network.A_rows);
+        } else {
+            workspace.sparse_A = network.A_pattern;
+            workspace.sparse_B = network.B_pattern;
+
+            SparseMatrix positions = network.A_pattern;
+            for (int value = 0; value < positions.nonZeros(); ++value) {
+                positions.valuePtr()[value] = value;
+            }
+            workspace.sparse_A_transposed = positions.transpose();
+            const double* transposed_positions = workspace.sparse_A_transposed.valuePtr();
+            workspace.A_transposed_positions.assign(transposed_positions,
+                                                    transposed_positions + workspace.sparse_A_transposed.nonZeros());
+        }
+
+        workspace.Y = Matrix::Zero(network.Y_rows, network.Y_cols);
+        workspace.BY = Matrix::Zero(network.B_rows, network.Y_cols);
+        workspace.X = Matrix::Zero(network.A_rows, network.Y_cols);
+        const size_t total_diff_columns = network.diff_free_fluxes.size() * network.Y_cols;
+        workspace.dY = Matrix::Zero(network.Y_rows, total_diff_columns);
+        workspace.right_part = Matrix::Zero(network.A_rows, total_diff_columns);
+        workspace.dX = Matrix::Zero(network.A_rows, total_diff_columns);
+        workspace.X_adjoint = Matrix::Zero(network.A_rows, network.Y_cols);
+        workspace.X_multiplier = Matrix::Zero(network.A_rows, network.Y_cols);
+        workspace.Y_adjoint = Matrix::Zero(network.Y_rows, network.Y_cols);
+        workspace.convolution_others.assign(network.convolution_others_size, 0.0);
+
+        for (const FinalEmu &final_emu : network.final_emus) {
+            const size_t mid_size = final_emu.correction_matrix.rows() > 0 ? final_emu.correction_matrix.rows()
+                                                                           : network.Y_cols;
+            result_.simulated_mids[final_emu.position_in_result] = {final_emu.emu, Mid(mid_size, 0.0)};
+            ssr_weights_[final_emu.position_in_result].assign(mid_size, 0.0);
+            for (std::vector<EmuAndMid>& vec : result_.diff_results) {
+                vec[final_emu.position_in_result] = {final_emu.emu, Mid(mid_size, 0.0)};
             }
-            A.setFromTriplets(A_triplets.begin(), A_triplets.end());
-            solvers_[total_big_networks].analyzePattern(A);
-            ++total_big_networks;
         }
     }
 }
-} // namespace khnum
\ No newline at end of file
+} // namespace khnum
@@ -1,61 +1,57 @@
 #include "simulator/simulator_utilities.h"
 
+#include <algorithm>
+
 namespace khnum {
 namespace simulator_utilities {
-void FillSmallFluxMatrix(const std::vector<FluxCombination>& symbolic_matrix,
-                         const std::vector<Flux>& fluxes,
-                         Matrix& matrix_out) {
-    for (const FluxCombination& combination : symbolic_matrix) {
-        double value = 0.0;
-        for (const FluxAndCoefficient& flux : combination.fluxes) {
-            value += flux.coefficient * fluxes[flux.id];
-        }
-        matrix_out(combination.i, combination.j) = value;
+namespace {
+// masses in the product of all the elements
+int GetConvolutionLength(const Convolution& convolution) {
+    int convolution_length = 1;
+    for (const PositionOfSavedEmu& emu : convolution.elements) {
+        convolution_length += emu.length - 1;
     }
+    return convolution_length;
+}
 }
 
-void FillBigFluxMatrix(const std::vector<FluxCombination>& symbolic_matrix,
-                       const std::vector<Flux>& fluxes,
-                       std::vector<Triplet> &triplets_out) {
-    for (const FluxCombination& combination : symbolic_matrix) {
-        double value = 0.0;
-        for (const FluxAndCoefficient& flux : combination.fluxes) {
-            value += flux.coefficient * fluxes[flux.id];
-        }
-        triplets_out.push_back(Triplet(combination.i, combination.j, value));
+void FillFluxMatrix(const FluxMatrixOperator& flux_operator,
+                    const Eigen::VectorXd& free_fluxes,
+                    double* values_out) {
+    Eigen::Map<Eigen::VectorXd> values(values_out, flux_operator.offset.size());
+    values = flux_operator.offset;
+    values.noalias() += flux_operator.coefficients * free_fluxes;
+}
+
+void AddDiffFluxMatrixProduct(const FluxMatrixOperator& flux_operator,
+                              size_t free_flux,
+                              double factor,
+                              const Matrix& multiplier,
+                              Eigen::Ref<Matrix> result_out) {
+    for (SparseMatrix::InnerIterator value(flux_operator.coefficients, free_flux); value; ++value) {
+        result_out.row(flux_operator.rows[value.row()]) +=
+            (factor * value.value()) * multiplier.row(flux_operator.cols[value.row()]);
     }
 }
 
 void FillYMatrix(const std::vector<PositionOfSavedEmu>& Y_data,
-                 const std::vector<EmuAndMid>& input_mids,
-                 const std::vector<std::vector<Mid>>& saved_mids,
+                 const double* mids,
                  const std::vector<Convolution>& convolutions,
+                 ConvolutionBuffers& buffers,
                  Matrix& Y_out) {
     for (size_t i = 0; i < Y_data.size(); ++i) {
         const PositionOfSavedEmu& known_emu = Y_data[i];
-        Mid mid;
-        if (known_emu.network == -1) {
-            mid = input_mids[known_emu.position].mid;
-        } else {
-            mid = saved_mids[known_emu.network][known_emu.position];
-        }
-        for (size_t mass_shift = 0; mass_shift < mid.size(); ++mass_shift) {
+        const double* mid = mids + known_emu.offset;
+        for (int mass_shift = 0; mass_shift < known_emu.length; ++mass_shift) {
             Y_out(i, mass_shift) = mid[mass_shift];
         }
     }
 
     for (size_t i = 0; i < convolutions.size(); ++i) {
         const Convolution& convolution = convolutions[i];
-        Mid mid(1, 1.0); // MID = [1.0]
-        for (const PositionOfSavedEmu& emu : convolution.elements) {
-            if (emu.network == -1) {
-                mid = mid * input_mids[emu.position].mid;
-            } else {
-                mid = mid * saved_mids[emu.network][emu.position];
-            }
-        }
-        for (size_t mass_shift = 0; mass_shift < mid.size(); ++mass_shift) {
-            Y_out(i + Y_data.size(), mass_shift) = mid[mass_shift];
+        const InlineMid& mid = ConvolveElements(convolution, mids, buffers);
+        for (size_t mass_shift = 0; mass_shift < mid.size; ++mass_shift) {
+            Y_out(i + Y_data.size(), mass_shift) = mid.masses[mass_shift];
         }
     }
 }
@@ -63,172 +59,298 @@ void FillYMatrix(const std::vector<PositionOfSavedEmu>& Y_data,
 void SaveNewEmus(const Matrix& X,
                  const std::vector<int>& usefull_emus,
                  const std::vector<FinalEmu>& final_emus,
-                 std::vector<Mid>& saved_mids_out,
+                 double* saved_mids_out,
                  std::vector<EmuAndMid>& result_out,
                  std::vector<double>& sums_out) {
-    for (int position : usefull_emus) {
-        Mid new_mid;
+    for (size_t i = 0; i < usefull_emus.size(); ++i) {
+        double* new_mid = saved_mids_out + i * X.cols();
         for (int mass_shift = 0; mass_shift < X.cols(); ++mass_shift) {
-            new_mid.push_back(X(position, mass_shift));
+            new_mid[mass_shift] = X(usefull_emus[i], mass_shift);
         }
-        saved_mids_out.push_back(new_mid);
     }
 
     for (const FinalEmu& final_emu : final_emus) {
-        Mid result_mid;
+        Mid& result_mid = result_out[final_emu.position_in_result].mid;
         if (final_emu.correction_matrix.rows() > 0) {
-            Matrix original_mid = X.row(final_emu.order_in_X);
-            Matrix corrected_mid = final_emu.correction_matrix * original_mid.transpose();
+            const Matrix& correction_matrix = final_emu.correction_matrix;
             double sum = 0.0;
-            for (int i = 0; i < corrected_mid.rows(); ++i) {
-                sum += corrected_mid(i, 0);
+            for (int mass_shift = 0; mass_shift < correction_matrix.rows(); ++mass_shift) {
+                result_mid[mass_shift] = correction_matrix.row(mass_shift).dot(X.row(final_emu.order_in_X));
+                sum += result_mid[mass_shift];
             }
             sums_out[final_emu.position_in_result] = sum;
-            for (int mass_shift = 0; mass_shift < corrected_mid.rows(); ++mass_shift) {
-                result_mid.push_back(corrected_mid(mass_shift, 0) / sum);
+            for (double& mass : result_mid) {
+                mass /= sum;
             }
         } else {
             for (int mass_shift = 0; mass_shift < X.cols(); ++mass_shift) {
-                result_mid.push_back(X(final_emu.order_in_X, mass_shift));
+                result_mid[mass_shift] = X(final_emu.order_in_X, mass_shift);
             }
         }
-
-        EmuAndMid result_emu;
-        result_emu.emu = final_emu.emu;
-        result_emu.mid = result_mid;
-        result_out[final_emu.position_in_result] = result_emu;
     }
 }
 
-void SaveNewDiffEmus(const Matrix& X,
+void SaveNewDiffEmus(const Eigen::Ref<const Matrix>& X,
                      const std::vector<int>& usefull_emus,
                      const std::vector<FinalEmu>& final_emus,
                      const std::vector<EmuAndMid> &result,
                      const std::vector<double>& sums,
-                     std::vector<Mid>& saved_mids_out,
+                     double* saved_mids_out,
                      std::vector<EmuAndMid>& diff_result_out) {
-    for (int position : usefull_emus) {
-        Mid new_mid;
+    for (size_t i = 0; i < usefull_emus.size(); ++i) {
+        double* new_mid = saved_mids_out + i * X.cols();
         for (int mass_shift = 0; mass_shift < X.cols(); ++mass_shift) {
-            new_mid.push_back(X(position, mass_shift));
+            new_mid[mass_shift] = X(usefull_emus[i], mass_shift);
         }
-        saved_mids_out.push_back(new_mid);
     }
 
     for (const FinalEmu& final_emu : final_emus) {
-        Mid result_mid;
+        Mid& result_mid = diff_result_out[final_emu.position_in_result].mid;
         if (final_emu.correction_matrix.rows() > 0) {
-            Matrix mid(result[final_emu.position_in_result].mid.size(), 1);
-            for (int i = 0; i < result[final_emu.position_in_result].mid.size(); ++i) {
-                mid(i, 0) = result[final_emu.position_in_result].mid[i];
-            }
-
-            Matrix diff_mid = X.row(final_emu.order_in_X);
-            Matrix corrected_mid = GetCorrectedDiffMid(final_emu.correction_matrix,
-                                                       mid,
-                                                       diff_mid.transpose(),
-                                                       sums[final_emu.position_in_result]);
-
-
-            for (int mass_shift = 0; mass_shift < corrected_mid.rows(); ++mass_shift) {
-                result_mid.push_back(corrected_mid(mass_shift, 0));
-            }
+            GetCorrectedDiffMid(final_emu.correction_matrix,
+                                result[final_emu.position_in_result].mid,
+                                X,
+                                final_emu.order_in_X,
+                                sums[final_emu.position_in_result],
+                                result_mid);
         } else {
             for (int mass_shift = 0; mass_shift < X.cols(); ++mass_shift) {
-                result_mid.push_back(X(final_emu.order_in_X, mass_shift));
+                result_mid[mass_shift] = X(final_emu.order_in_X, mass_shift);
             }
         }
-
-        EmuAndMid result_emu;
-        result_emu.emu = final_emu.emu;
-        result_emu.mid = result_mid;
-        diff_result_out[final_emu.position_in_result] = result_emu;
     }
 }
 
-Matrix GetCorrectedDiffMid(const Matrix& correction_matrix,
-                           Matrix mid,
-                           const Matrix& diff_mid,
-                           double sum) {
-    Matrix corrected_diff_mid = correction_matrix * diff_mid;
+void GetCorrectedDiffMid(const Matrix& correction_matrix,
+                         const Mid& mid,
+                         const Eigen::Ref<const Matrix>& diff_X,
+                         int row,
+                         double sum,
+                         Mid& corrected_diff_mid_out) {
     double diff_sum = 0.0;
-    for (int i = 0; i < corrected_diff_mid.rows(); ++i) {
-        diff_sum += corrected_diff_mid(i, 0);
+    for (int mass_shift = 0; mass_shift < correction_matrix.rows(); ++mass_shift) {
+        corrected_diff_mid_out[mass_shift] = correction_matrix.row(mass_shift).dot(diff_X.row(row));
+        diff_sum += corrected_diff_mid_out[mass_shift];
+    }
+    for (int mass_shift = 0; mass_shift < correction_matrix.rows(); ++mass_shift) {
+        corrected_diff_mid_out[mass_shift] = (corrected_diff_mid_out[mass_shift] - mid[mass_shift] * diff_sum) / sum;
     }
-    mid *= diff_sum;
-    corrected_diff_mid -= mid;
-    corrected_diff_mid /= sum;
-    return corrected_diff_mid;
 }
 
 
 void FillDiffYMatrix(const std::vector<PositionOfSavedEmu>& Y_data,
-                     const std::vector<std::vector<Mid>>& known_d_mids,
+                     const double* known_d_mids,
                      const std::vector<Convolution>& convolutions,
-                     const std::vector<EmuAndMid>& input_mids,
-                     const std::vector<std::vector<Mid>>& saved_mids,
-                     Matrix& Y_out) {
+                     const double* convolution_others,
+                     ConvolutionBuffers& buffers,
+                     Eigen::Ref<Matrix> Y_out) {
     for (size_t i = 0; i < Y_data.size(); ++i) {
         const PositionOfSavedEmu known_emu = Y_data[i];
-        Mid mid;
         if (known_emu.network == -1) {
             // Do nothing. Because:
             // mid = std::vector<double> (Y_out.cols(), 0.0);
             // and Y_out(i, ...) is already zero
-        } else {
-            mid = known_d_mids[known_emu.network][known_emu.position];
+            continue;
         }
-        for (size_t mass_shift = 0; mass_shift < mid.size(); ++mass_shift) {
+        const double* mid = known_d_mids + known_emu.offset;
+        for (int mass_shift = 0; mass_shift < known_emu.length; ++mass_shift) {
             Y_out(i, mass_shift) = mid[mass_shift];
         }
     }
 
     size_t position = Y_data.size();
     for (const Convolution& convolution : convolutions) {
-        Mid mid = std::vector<double> (Y_out.cols(), 0.0);
+        const int convolution_length = GetConvolutionLength(convolution);
+        // Y_out(position, ...) is already zero, so the partial derivatives are simply added
         for (size_t diff_position = 0; diff_position < convolution.elements.size(); ++diff_position) {
-            Mid mid_part = ConvolvePartialDiff(convolution,
-                                               known_d_mids,
-                                               input_mids,
-                                               saved_mids,
-                                               Y_out.cols(),
-                                               diff_position);
-            for (size_t j = 0; j < mid.size(); ++j) {
-                mid[j] += mid_part[j];
+            const PositionOfSavedEmu& diff_emu = convolution.elements[diff_position];
+            if (diff_emu.network == -1) {
+                // the input mids are constant, so the partial derivative is zero
+                continue;
+            }
+            InlineMid& mid_part = buffers.mid_buffer;
+            mid_part.size = convolution_length;
+            Convolve(convolution_others + convolution.others_offsets[diff_position],
+                     convolution_length - diff_emu.length + 1,
+                     known_d_mids + diff_emu.offset,
+                     diff_emu.length,
+                     mid_part.masses.data());
+            for (size_t mass_shift = 0; mass_shift < mid_part.size; ++mass_shift) {
+                Y_out(position, mass_shift) += mid_part.masses[mass_shift];
             }
         }
+        ++position;
+    }
+}
 
-        for (size_t mass_shift = 0; mass_shift < mid.size(); ++mass_shift) {
-            Y_out(position, mass_shift) = mid[mass_shift];
+const InlineMid& ConvolveElements(const Convolution& convolution,
+                                  const double* mids,
+                                  ConvolutionBuffers& buffers) {
+    InlineMid* mid = &buffers.mid_buffer;
+    InlineMid* next_mid = &buffers.second_mid_buffer;
+    const PositionOfSavedEmu& first_emu = convolution.elements.front();
+    std::copy(mids + first_emu.offset, mids + first_emu.offset + first_emu.length, mid->masses.begin());
+    mid->size = first_emu.length;
+    for (size_t position = 1; position < convolution.elements.size(); ++position) {
+        const PositionOfSavedEmu& emu = convolution.elements[position];
+        Convolve(*mid, mids + emu.offset, emu.length, *next_mid);
+        std::swap(mid, next_mid);
+    }
+    return *mid;
+}
+
+void FillConvolutionOthers(const std::vector<Convolution>& convolutions,
+                           const double* mids,
+                           ConvolutionBuffers& buffers,
+                           double* others_out) {
+    for (const Convolution& convolution : convolutions) {
+        const size_t total_elements = convolution.elements.size();
+        const int convolution_length = GetConvolutionLength(convolution);
+        if (total_elements == 1) {
+            others_out[convolution.others_offsets[0]] = 1.0;
+            continue;
         }
-        ++position;
+
+        // the others of the i'th element are prefix(i - 1) * suffix(i + 1), the prefixes are saved first.
+        // Empty products have zero size
+        InlineMid* product = &buffers.mid_buffer;
+        InlineMid* next_product = &buffers.second_mid_buffer;
+        product->size = 0;
+        for (size_t position = 0; position < total_elements; ++position) {
+            double* others = others_out + convolution.others_offsets[position];
+            std::copy(product->masses.begin(), product->masses.begin() + product->size, others);
+            if (position + 1 == total_elements) {
+                break;
+            }
+            const PositionOfSavedEmu& emu = convolution.elements[position];
+            if (product->size == 0) {
+                std::copy(mids + emu.offset, mids + emu.offset + emu.length, product->masses.begin());
+                product->size = emu.length;
+            } else {
+                Convolve(*product, mids + emu.offset, emu.length, *next_product);
+                std::swap(product, next_product);
+            }
+        }
+
+        product->size = 0;
+        for (size_t position = total_elements; position-- > 0;) {
+            const PositionOfSavedEmu& emu = convolution.elements[position];
+            double* others = others_out + convolution.others_offsets[position];
+            if (product->size > 0) {
+                if (position == 0) {
+                    std::copy(product->masses.begin(), product->masses.begin() + product->size, others);
+                } else {
+                    InlineMid& others_buffer = buffers.third_mid_buffer;
+                    const size_t prefix_length = convolution_length - emu.length + 2 - product->size;
+                    Convolve(*product, others, prefix_length, others_buffer);
+                    std::copy(others_buffer.masses.begin(), others_buffer.masses.begin() + others_buffer.size, others);
+                }
+            }
+            if (position == 0) {
+                break;
+            }
+            if (product->size == 0) {
+                std::copy(mids + emu.offset, mids + emu.offset + emu.length, product->masses.begin());
+                product->size = emu.length;
+            } else {
+                Convolve(*product, mids + emu.offset, emu.length, *next_product);
+                std::swap(product, next_product);
+            }
+        }
+    }
+}
+
+void AddDiffFluxMatrixInnerProducts(const FluxMatrixOperator& flux_operator,
+                                    double factor,
+                                    const Matrix& left,
+                                    const Matrix& right,
+                                    Eigen::VectorXd& gradient_out) {
+    for (int free_flux = 0; free_flux < flux_operator.coefficients.cols(); ++free_flux) {
+        double product = 0.0;
+        for (SparseMatrix::InnerIterator value(flux_operator.coefficients, free_flux); value; ++value) {
+            product += value.value() * left.row(flux_operator.rows[value.row()]).dot(
+                right.row(flux_operator.cols[value.row()]));
+        }
+        gradient_out(free_flux) += factor * product;
     }
 }
 
-Mid ConvolvePartialDiff(const Convolution& convolution,
-                        const std::vector<std::vector<Mid>>& known_d_mids,
-                        const std::vector<EmuAndMid>& input_mids,
-                        const std::vector<std::vector<Mid>>& saved_mids,
-                        size_t mid_size,
-                        size_t diff_position) {
-    Mid mid_part(1, 1.0);
-    for (size_t i = 0; i < convolution.elements.size(); ++i) {
-        const PositionOfSavedEmu& emu = convolution.elements[i];
-        if (diff_position == i) {
-            if (emu.network == -1) {
-                return std::vector<double> (mid_size, 0.0);
-            }
-            mid_part = mid_part * known_d_mids[emu.network][emu.position];
+void AddFinalEmusAdjoint(const std::vector<FinalEmu>& final_emus,
+                         const std::vector<EmuAndMid>& result,
+                         const std::vector<double>& sums,
+                         const std::vector<Mid>& weights,
+                         Matrix& X_adjoint_out) {
+    for (const FinalEmu& final_emu : final_emus) {
+        const Mid& weight = weights[final_emu.position_in_result];
+        if (final_emu.correction_matrix.rows() > 0) {
+            // mid = C * x / sum(C * x), so d(weight * mid) = (weight - weight * mid) * C * dx / sum
+            const Matrix& correction_matrix = final_emu.correction_matrix;
+            const Mid& mid = result[final_emu.position_in_result].mid;
+            const double sum = sums[final_emu.position_in_result];
+            double weighted_mid = 0.0;
+            for (int mass_shift = 0; mass_shift < correction_matrix.rows(); ++mass_shift) {
+                weighted_mid += weight[mass_shift] * mid[mass_shift];
+            }
+            for (int mass_shift = 0; mass_shift < correction_matrix.rows(); ++mass_shift) {
+                X_adjoint_out.row(final_emu.order_in_X) +=
+                    ((weight[mass_shift] - weighted_mid) / sum) * correction_matrix.row(mass_shift);
+            }
         } else {
-            if (emu.network == -1) {
-                mid_part = mid_part * input_mids[emu.position].mid;
-            } else {
-                mid_part = mid_part * saved_mids[emu.network][emu.position];
+            for (int mass_shift = 0; mass_shift < X_adjoint_out.cols(); ++mass_shift) {
+                X_adjoint_out(final_emu.order_in_X, mass_shift) += weight[mass_shift];
             }
+        }
+    }
+}
 
+void AddSavedEmusAdjoint(const std::vector<int>& usefull_emus,
+                         const double* adjoint_mids,
+                         Matrix& X_adjoint_out) {
+    for (size_t i = 0; i < usefull_emus.size(); ++i) {
+        const double* adjoint_mid = adjoint_mids + i * X_adjoint_out.cols();
+        for (int mass_shift = 0; mass_shift < X_adjoint_out.cols(); ++mass_shift) {
+            X_adjoint_out(usefull_emus[i], mass_shift) += adjoint_mid[mass_shift];
+        }
+    }
+}
+
+void AddYMatrixAdjoint(const std::vector<PositionOfSavedEmu>& Y_data,
+                       const std::vector<Convolution>& convolutions,
+                       const double* convolution_others,
+                       const Matrix& Y_adjoint,
+                       double* adjoint_mids_out) {
+    for (size_t i = 0; i < Y_data.size(); ++i) {
+        const PositionOfSavedEmu& known_emu = Y_data[i];
+        if (known_emu.network == -1) {
+            continue;
+        }
+        double* adjoint_mid = adjoint_mids_out + known_emu.offset;
+        for (int mass_shift = 0; mass_shift < known_emu.length; ++mass_shift) {
+            adjoint_mid[mass_shift] += Y_adjoint(i, mass_shift);
+        }
+    }
+
+    for (size_t i = 0; i < convolutions.size(); ++i) {
+        const Convolution& convolution = convolutions[i];
+        const int convolution_length = GetConvolutionLength(convolution);
+        const size_t row = i + Y_data.size();
+        for (size_t diff_position = 0; diff_position < convolution.elements.size(); ++diff_position) {
+            const PositionOfSavedEmu& diff_emu = convolution.elements[diff_position];
+            if (diff_emu.network == -1) {
+                continue;
+            }
+
+            // the adjoint of a convolution is a correlation with the product of the other elements
+            const double* others = convolution_others + convolution.others_offsets[diff_position];
+            const int others_length = convolution_length - diff_emu.length + 1;
+            double* adjoint_mid = adjoint_mids_out + diff_emu.offset;
+            for (int mass_shift = 0; mass_shift < diff_emu.length; ++mass_shift) {
+                for (int other_shift = 0; other_shift < others_length; ++other_shift) {
+                    adjoint_mid[mass_shift] += Y_adjoint(row, mass_shift + other_shift) * others[other_shift];
+                }
+            }
         }
     }
-    return mid_part;
 }
 } // namespace simulator_utilities
-} // namespace khnum
\ No newline at end of file
+} // namespace khnum
@@ -0,0 +1,83 @@
+#include "simulator/small_network_solver.h"
+
+
+namespace khnum {
+namespace {
+template <int Size>
+class FixedSizeSolver : public ISmallNetworkSolver {
+public:
+    void Factorize(const Matrix& A) override {
+        decomposition_.compute(A);
+    }
+
+    void Solve(const Eigen::Ref<const Matrix>& right_part, Eigen::Ref<Matrix> result_out) const override {
+        result_out = decomposition_.solve(right_part);
+    }
+
+    void SolveTransposed(const Eigen::Ref<const Matrix>& right_part, Eigen::Ref<Matrix> result_out) const override {
+        result_out = decomposition_.transpose().solve(right_part);
+    }
+
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+private:
+    Eigen::PartialPivLU<Eigen::Matrix<double, Size, Size>> decomposition_;
+};
+
+class DynamicSizeSolver : public ISmallNetworkSolver {
+public:
+    explicit DynamicSizeSolver(size_t network_size) : decomposition_(network_size) {
+    }
+
+    void Factorize(const Matrix& A) override {
+        decomposition_.compute(A);
+    }
+
+    void Solve(const Eigen::Ref<const Matrix>& right_part, Eigen::Ref<Matrix> result_out) const override {
+        result_out = decomposition_.solve(right_part);
+    }
+
+    void SolveTransposed(const Eigen::Ref<const Matrix>& right_part, Eigen::Ref<Matrix> result_out) const override {
+        result_out = decomposition_.transpose().solve(right_part);
+    }
+
+private:
+    Eigen::PartialPivLU<Matrix> decomposition_;
+};
+
+template <int Size>
+std::unique_ptr<ISmallNetworkSolver> CreateFixedSizeSolver() {
+    return std::make_unique<FixedSizeSolver<Size>>();
+}
+
+using SolverFactory = std::unique_ptr<ISmallNetworkSolver> (*)();
+
+// the factory of the fixed-size solver at the network size
+const SolverFactory fixed_size_solvers[max_fixed_network_size + 1] = {
+    nullptr,
+    &CreateFixedSizeSolver<1>,
+    &CreateFixedSizeSolver<2>,
+    &CreateFixedSizeSolver<3>,
+    &CreateFixedSizeSolver<4>,
+    &CreateFixedSizeSolver<5>,
+    &CreateFixedSizeSolver<6>,
+    &CreateFixedSizeSolver<7>,
+    &CreateFixedSizeSolver<8>,
+    &CreateFixedSizeSolver<9>,
+    &CreateFixedSizeSolver<10>,
+    &CreateFixedSizeSolver<11>,
+    &CreateFixedSizeSolver<12>,
+    &CreateFixedSizeSolver<13>,
+    &CreateFixedSizeSolver<14>,
+    &CreateFixedSizeSolver<15>,
+    &CreateFixedSizeSolver<16>
+};
+} // namespace
+
+std::unique_ptr<ISmallNetworkSolver> CreateSmallNetworkSolver(size_t network_size) {
+    if (network_size > 0 && network_size <= max_fixed_network_size) {
+        return fixed_size_solvers[network_size]();
+    }
+    return std::make_unique<DynamicSizeSolver>(network_size);
+}
+} // namespace khnum
@@ -0,0 +1,516 @@
+#include "solver/confidence_intervals.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <glpk/glpk.h>
+
+#include "simulator/simulator.h"
+#include "solver/levenberg_marquardt.h"
+#include "solver/solver.h"
+
+
+namespace khnum {
+namespace {
+// the step doubles while one step raises the SSR by less than this share of the threshold
+const double slow_growth_share = 0.25;
+// a direction of the exchange flux isn't smaller than the fixed one if it is below it by less than this
+const double direction_tolerance = 1e-9;
+
+// A flux of the model as a linear function of the free fluxes,
+// the exchange flux is the smaller one of the forward and the backward fluxes
+struct ProfiledFlux {
+    // position in problem.reactions, the forward reaction for the net and the exchange fluxes
+    size_t reaction;
+    ProfiledFluxType type;
+    // the forward flux for the exchange flux
+    Eigen::VectorXd coefficients;
+    // the backward flux for the exchange flux, empty for the other ones
+    Eigen::VectorXd backward_coefficients;
+};
+
+// Feasible ranges of the forward and the backward fluxes of the exchange flux
+using DirectionRanges = std::array<std::pair<double, double>, 2>;
+
+double CalculateFlux(const ProfiledFlux& flux, const Eigen::VectorXd& free_fluxes) {
+    const double value = flux.coefficients.dot(free_fluxes);
+    if (flux.type != ProfiledFluxType::exchange) {
+        return value;
+    }
+    return std::min(value, flux.backward_coefficients.dot(free_fluxes));
+}
+
+// The fluxes follow problem.reactions: the isotopomer balance reactions, the dependent fluxes, the free fluxes.
+// The isotopomer balance reactions have no coefficients
+std::vector<Eigen::VectorXd> CreateReactionCoefficients(const Problem& problem) {
+    const int total_dependent = problem.nullspace.rows();
+    const int total_free = problem.nullspace.cols();
+    const size_t isotopomer_balance_total = problem.reactions.size() - total_dependent - total_free;
+
+    std::vector<Eigen::VectorXd> coefficients(problem.reactions.size());
+    for (size_t reaction = isotopomer_balance_total; reaction < problem.reactions.size(); ++reaction) {
+        const int position = reaction - isotopomer_balance_total;
+        if (position < total_dependent) {
+            coefficients[reaction] = -problem.nullspace.row(position).transpose();
+        } else {
+            coefficients[reaction] = Eigen::VectorXd::Unit(total_free, position - total_dependent);
+        }
+    }
+    return coefficients;
+}
+
+std::vector<ProfiledFlux> CreateProfiledFluxes(const Problem& problem) {
+    const std::vector<Eigen::VectorXd> coefficients = CreateReactionCoefficients(problem);
+
+    std::vector<const ReversibleReaction*> reversible_reactions(problem.reactions.size(), nullptr);
+    for (const ReversibleReaction& reaction : problem.reversible_reactions) {
+        if (coefficients[reaction.forward].size() > 0 && coefficients[reaction.backward].size() > 0) {
+            reversible_reactions[reaction.forward] = &reaction;
+            reversible_reactions[reaction.backward] = &reaction;
+        }
+    }
+
+    std::vector<ProfiledFlux> fluxes;
+    for (size_t reaction = 0; reaction < problem.reactions.size(); ++reaction) {
+        if (coefficients[reaction].size() == 0) {
+            continue;
+        }
+        const ReversibleReaction* reversible_reaction = reversible_reactions[reaction];
+        if (!reversible_reaction) {
+            fluxes.push_back({reaction, ProfiledFluxType::single, coefficients[reaction], {}});
+            continue;
+        }
+        if (reaction != std::min(reversible_reaction->forward, reversible_reaction->backward)) {
+            continue;
+        }
+
+        const Eigen::VectorXd& forward = coefficients[reversible_reaction->forward];
+        const Eigen::VectorXd& backward = coefficients[reversible_reaction->backward];
+        fluxes.push_back({reversible_reaction->forward, ProfiledFluxType::net, forward - backward, {}});
+        fluxes.push_back({reversible_reaction->forward, ProfiledFluxType::exchange, forward, backward});
+    }
+    return fluxes;
+}
+
+// Minimum and maximum of a flux over lower <= free fluxes <= upper, nullspace * free fluxes <= 0.
+// The linear problem is built once per worker, only its objective changes between the fluxes,
+// so every simplex starts from the previous basis
+class FeasibleRangeFinder {
+public:
+    explicit FeasibleRangeFinder(const Problem& problem) {
+        const Matrix& nullspace = problem.nullspace;
+        glp_term_out(GLP_OFF);
+        linear_problem_ = glp_create_prob();
+        glp_add_cols(linear_problem_, nullspace.cols());
+        for (int column = 0; column < nullspace.cols(); ++column) {
+            const double lower = problem.lower_bounds[column];
+            const double upper = problem.upper_bounds[column];
+            glp_set_col_bnds(linear_problem_, column + 1, lower < upper ? GLP_DB : GLP_FX, lower, upper);
+        }
+        std::vector<int> row_index = {0};
+        std::vector<int> col_index = {0};
+        std::vector<double> values = {0.0};
+        if (nullspace.rows() > 0) {
+            glp_add_rows(linear_problem_, nullspace.rows());
+        }
+        for (int row = 0; row < nullspace.rows(); ++row) {
+            glp_set_row_bnds(linear_problem_, row + 1, GLP_UP, 0.0, 0.0);
+            for (int column = 0; column < nullspace.cols(); ++column) {
+                if (nullspace(row, column) != 0.0) {
+                    row_index.push_back(row + 1);
+                    col_index.push_back(column + 1);
+                    values.push_back(nullspace(row, column));
+                }
+            }
+        }
+        glp_load_matrix(linear_problem_, values.size() - 1, row_index.data(), col_index.data(), values.data());
+
+        glp_init_smcp(&parameters_);
+        parameters_.msg_lev = GLP_MSG_OFF;
+    }
+
+    ~FeasibleRangeFinder() {
+        glp_delete_prob(linear_problem_);
+    }
+
+    FeasibleRangeFinder(const FeasibleRangeFinder&) = delete;
+    FeasibleRangeFinder& operator=(const FeasibleRangeFinder&) = delete;
+
+    std::pair<double, double> Find(const Eigen::VectorXd& coefficients) {
+        for (int column = 0; column < coefficients.size(); ++column) {
+            glp_set_obj_coef(linear_problem_, column + 1, coefficients[column]);
+        }
+        std::pair<double, double> range;
+        for (int direction : {GLP_MIN, GLP_MAX}) {
+            glp_set_obj_dir(linear_problem_, direction);
+            if (!Solve()) {
+                throw std::runtime_error("Can't find the feasible range of a flux for its confidence interval");
+            }
+            (direction == GLP_MIN ? range.first : range.second) = glp_get_obj_val(linear_problem_);
+        }
+        return range;
+    }
+
+    // Maximum of min(first * free fluxes, second * free fluxes): an auxiliary column bounded by both fluxes
+    // is maximized, the column and its rows are removed afterwards
+    double FindSmallerMaximum(const Eigen::VectorXd& first, const Eigen::VectorXd& second) {
+        const int bound_column = glp_add_cols(linear_problem_, 1);
+        glp_set_col_bnds(linear_problem_, bound_column, GLP_FR, 0.0, 0.0);
+        const int first_row = glp_add_rows(linear_problem_, 2);
+        for (int row = 0; row < 2; ++row) {
+            const Eigen::VectorXd& coefficients = row == 0 ? first : second;
+            // bound - coefficients * free fluxes <= 0
+            std::vector<int> columns = {0, bound_column};
+            std::vector<double> values = {0.0, 1.0};
+            for (int column = 0; column < coefficients.size(); ++column) {
+                if (coefficients[column] != 0.0) {
+                    columns.push_back(column + 1);
+                    values.push_back(-coefficients[column]);
+                }
+            }
+            glp_set_mat_row(linear_problem_, first_row + row, columns.size() - 1, columns.data(), values.data());
+            glp_set_row_bnds(linear_problem_, first_row + row, GLP_UP, 0.0, 0.0);
+        }
+        for (int column = 0; column < first.size(); ++column) {
+            glp_set_obj_coef(linear_problem_, column + 1, 0.0);
+        }
+        glp_set_obj_coef(linear_problem_, bound_column, 1.0);
+        glp_set_obj_dir(linear_problem_, GLP_MAX);
+        const bool is_solved = Solve();
+        const double maximum = glp_get_obj_val(linear_problem_);
+
+        const int rows[] = {0, first_row, first_row + 1};
+        glp_del_rows(linear_problem_, 2, rows);
+        const int columns[] = {0, bound_column};
+        glp_del_cols(linear_problem_, 1, columns);
+        if (!is_solved) {
+            throw std::runtime_error("Can't find the feasible range of a flux for its confidence interval");
+        }
+        return maximum;
+    }
+
+private:
+    // a singular basis is replaced by the standard one once
+    bool Solve() {
+        if (glp_simplex(linear_problem_, &parameters_) != 0) {
+            glp_std_basis(linear_problem_);
+            if (glp_simplex(linear_problem_, &parameters_) != 0) {
+                return false;
+            }
+        }
+        return glp_get_status(linear_problem_) == GLP_OPT;
+    }
+
+    glp_prob* linear_problem_;
+    glp_smcp parameters_;
+};
+
+// Fits of one worker, its own simulator and Levenberg-Marquardt buffers
+class ProfileFitter {
+public:
+    ProfileFitter(const Problem& problem, const SimulatorGenerator& generator) :
+                                  simulator_(generator.Generate()),
+                                  solver_(problem.measurements_count,
+                                          Eigen::Map<const Eigen::VectorXd>(problem.lower_bounds.data(),
+                                                                            problem.lower_bounds.size()),
+                                          Eigen::Map<const Eigen::VectorXd>(problem.upper_bounds.data(),
+                                                                            problem.upper_bounds.size()),
+                                          problem.nullspace, Eigen::VectorXd::Zero(problem.nullspace.rows())),
+                                  measurements_(problem.measurements),
+                                  use_analytic_jacobian_(problem.use_analytic_jacobian),
+                                  residuals_(problem.measurements_count) {
+        function_ = [this](const Eigen::VectorXd& free_fluxes, Eigen::VectorXd& residuals, Matrix* jacobian) {
+            FillResiduals(simulator_.CalculateMids(free_fluxes, jacobian != nullptr), measurements_,
+                          residuals, jacobian);
+        };
+    }
+
+    double CalculateSSR(const Eigen::VectorXd& free_fluxes) {
+        function_(free_fluxes, residuals_, nullptr);
+        return residuals_.squaredNorm();
+    }
+
+    // Fits the free fluxes with equalities * free_fluxes = values starting from free_fluxes, returns the SSR
+    double Fit(const Matrix& equalities, const Eigen::VectorXd& values, Eigen::VectorXd& free_fluxes) {
+        solver_.SetEqualities(equalities, values);
+        free_fluxes = solver_.Minimize(function_, use_analytic_jacobian_, free_fluxes);
+        ++total_fits_;
+        return solver_.GetReport().final_ssr;
+    }
+
+    int GetTotalFits() const {
+        return total_fits_;
+    }
+
+private:
+    Simulator simulator_;
+    LevenbergMarquardt solver_;
+    const std::vector<Measurement>& measurements_;
+    bool use_analytic_jacobian_;
+    Eigen::VectorXd residuals_;
+    LevenbergMarquardt::ResidualFunction function_;
+    int total_fits_ = 0;
+};
+
+// Fits the free fluxes with the flux fixed to the value starting from free_fluxes, returns the SSR.
+// The exchange flux min(forward, backward) isn't linear: the direction which is smaller at the start is fixed,
+// if the fit moves the other one below the value, the net flux has changed its sign and the other direction
+// is fixed instead. If both fits do so, the optimum is where both directions are equal to the value.
+// A direction isn't fixed out of its feasible range, the other one is the smaller one there anyway
+double FitFlux(ProfileFitter& fitter,
+               const ProfiledFlux& flux,
+               const DirectionRanges& direction_ranges,
+               double value,
+               Eigen::VectorXd& free_fluxes) {
+    if (flux.type != ProfiledFluxType::exchange) {
+        return fitter.Fit(flux.coefficients.transpose(), Eigen::VectorXd::Constant(1, value), free_fluxes);
+    }
+
+    Matrix directions(2, flux.coefficients.size());
+    directions << flux.coefficients.transpose(), flux.backward_coefficients.transpose();
+    const int smaller = flux.coefficients.dot(free_fluxes) <= flux.backward_coefficients.dot(free_fluxes) ? 0 : 1;
+    for (const int fixed : {smaller, 1 - smaller}) {
+        if (value < direction_ranges[fixed].first - direction_tolerance ||
+            value > direction_ranges[fixed].second + direction_tolerance) {
+            continue;
+        }
+        Eigen::VectorXd fitted_free_fluxes = free_fluxes;
+        const double ssr = fitter.Fit(directions.row(fixed), Eigen::VectorXd::Constant(1, value),
+                                      fitted_free_fluxes);
+        if (directions.row(1 - fixed).dot(fitted_free_fluxes) >= value - direction_tolerance) {
+            free_fluxes = std::move(fitted_free_fluxes);
+            return ssr;
+        }
+    }
+    return fitter.Fit(directions, Eigen::VectorXd::Constant(2, value), free_fluxes);
+}
+
+struct ProfileEnd {
+    double value;
+    bool is_feasible_limit;
+};
+
+// Steps the flux from the best fit towards the limit of its feasible range until the SSR exceeds the threshold.
+// Every fit starts from the secant prediction through the two previous optima, the net and the single fluxes
+// are linear in the free fluxes, so the prediction has the new flux value.
+// If the threshold isn't reached in max_steps the last fitted value is returned
+ProfileEnd FindProfileEnd(ProfileFitter& fitter,
+                          const ProfiledFlux& flux,
+                          const DirectionRanges& direction_ranges,
+                          const Eigen::VectorXd& best_free_fluxes,
+                          double best_value,
+                          double threshold_ssr,
+                          double limit,
+                          double initial_step,
+                          double best_ssr,
+                          const ConfidenceIntervalsParameters& parameters) {
+    double inner_value = best_value;
+    double inner_ssr = best_ssr;
+    Eigen::VectorXd inner_free_fluxes = best_free_fluxes;
+    double previous_value = best_value;
+    Eigen::VectorXd previous_free_fluxes = best_free_fluxes;
+    double step = initial_step;
+    for (int iteration = 0; iteration < parameters.max_steps; ++iteration) {
+        if (inner_value == limit) {
+            return {limit, true};
+        }
+        double outer_value = limit > best_value ? std::min(inner_value + step, limit) :
+                                                  std::max(inner_value - step, limit);
+        Eigen::VectorXd outer_free_fluxes = inner_free_fluxes;
+        if (previous_value != inner_value) {
+            outer_free_fluxes += (outer_value - inner_value) / (inner_value - previous_value) *
+                                 (inner_free_fluxes - previous_free_fluxes);
+        }
+        double outer_ssr = FitFlux(fitter, flux, direction_ranges, outer_value, outer_free_fluxes);
+
+        if (outer_ssr > threshold_ssr) {
+            // the start between the optima of the bracket is feasible and has the linear flux value
+            for (int refinement = 0; refinement < parameters.refinement_steps; ++refinement) {
+                const double share = (threshold_ssr - inner_ssr) / (outer_ssr - inner_ssr);
+                const double value = inner_value + share * (outer_value - inner_value);
+                Eigen::VectorXd free_fluxes = inner_free_fluxes + share * (outer_free_fluxes - inner_free_fluxes);
+                const double ssr = FitFlux(fitter, flux, direction_ranges, value, free_fluxes);
+                if (ssr > threshold_ssr) {
+                    outer_value = value;
+                    outer_ssr = ssr;
+                    outer_free_fluxes = std::move(free_fluxes);
+                } else {
+                    inner_value = value;
+                    inner_ssr = ssr;
+                    inner_free_fluxes = std::move(free_fluxes);
+                }
+            }
+            const double end_value = inner_value + (threshold_ssr - inner_ssr) / (outer_ssr - inner_ssr) *
+                                                   (outer_value - inner_value);
+            return {end_value, false};
+        }
+
+        if (outer_ssr - inner_ssr < slow_growth_share * parameters.ssr_threshold) {
+            step *= 2.0;
+        }
+        previous_value = inner_value;
+        previous_free_fluxes = std::move(inner_free_fluxes);
+        inner_value = outer_value;
+        inner_ssr = outer_ssr;
+        inner_free_fluxes = std::move(outer_free_fluxes);
+    }
+    return {inner_value, inner_value == limit};
+}
+
+FluxConfidenceInterval CalculateInterval(ProfileFitter& fitter,
+                                         FeasibleRangeFinder& range_finder,
+                                         const Problem& problem,
+                                         const ProfiledFlux& flux,
+                                         const Eigen::VectorXd& best_free_fluxes,
+                                         double best_ssr,
+                                         const ConfidenceIntervalsParameters& parameters) {
+    const int fits_before = fitter.GetTotalFits();
+    std::pair<double, double> feasible_range;
+    DirectionRanges direction_ranges;
+    if (flux.type == ProfiledFluxType::exchange) {
+        direction_ranges = {range_finder.Find(flux.coefficients), range_finder.Find(flux.backward_coefficients)};
+        feasible_range = {std::min(direction_ranges[0].first, direction_ranges[1].first),
+                          range_finder.FindSmallerMaximum(flux.coefficients, flux.backward_coefficients)};
+    } else {
+        feasible_range = range_finder.Find(flux.coefficients);
+    }
+    const double best_value = std::clamp(CalculateFlux(flux, best_free_fluxes), feasible_range.first,
+                                         feasible_range.second);
+
+    FluxConfidenceInterval interval;
+    interval.reaction_id = problem.reactions[flux.reaction].id;
+    interval.name = problem.reactions[flux.reaction].name;
+    interval.type = flux.type;
+    interval.best_value = best_value;
+
+    // the flux is fixed by the bounds, there is nothing to profile and the zero step wouldn't move
+    if (feasible_range.first == feasible_range.second) {
+        interval.lower = best_value;
+        interval.upper = best_value;
+        interval.is_lower_feasible_limit = true;
+        interval.is_upper_feasible_limit = true;
+        interval.total_fits = 0;
+        return interval;
+    }
+
+    const double initial_step = parameters.initial_step_share * (feasible_range.second - feasible_range.first);
+    const double threshold_ssr = best_ssr + parameters.ssr_threshold;
+
+    const ProfileEnd lower = FindProfileEnd(fitter, flux, direction_ranges, best_free_fluxes, best_value,
+                                            threshold_ssr, feasible_range.first, initial_step, best_ssr, parameters);
+    const ProfileEnd upper = FindProfileEnd(fitter, flux, direction_ranges, best_free_fluxes, best_value,
+                                            threshold_ssr, feasible_range.second, initial_step, best_ssr, parameters);
+
+    interval.lower = lower.value;
+    interval.upper = upper.value;
+    interval.is_lower_feasible_limit = lower.is_feasible_limit;
+    interval.is_upper_feasible_limit = upper.is_feasible_limit;
+    interval.total_fits = fitter.GetTotalFits() - fits_before;
+    return interval;
+}
+} // namespace
+
+ConfidenceIntervalsCalculator::ConfidenceIntervalsCalculator(const Problem &problem,
+                                                             const SimulatorGenerator &generator,
+                                                             const ConfidenceIntervalsParameters &parameters) :
+                                                                                     problem_{problem},
+                                                                                     generator_{generator},
+                                                                                     parameters_{parameters} {
+}
+
+std::vector<FluxConfidenceInterval> ConfidenceIntervalsCalculator::Calculate(
+                                                        const std::vector<alglib::real_1d_array> &solutions) {
+    if (solutions.empty()) {
+        throw std::runtime_error("No solutions to calculate the confidence intervals around");
+    }
+
+    Eigen::VectorXd best_free_fluxes;
+    double best_ssr = 0.0;
+    {
+        ProfileFitter fitter(problem_, generator_);
+        for (const alglib::real_1d_array &solution : solutions) {
+            const Eigen::VectorXd free_fluxes = Eigen::Map<const Eigen::VectorXd>(solution.getcontent(),
+                                                                                  solution.length());
+            const double ssr = fitter.CalculateSSR(free_fluxes);
+            if (best_free_fluxes.size() == 0 || ssr < best_ssr) {
+                best_free_fluxes = free_fluxes;
+                best_ssr = ssr;
+            }
+        }
+    }
+
+    const std::vector<ProfiledFlux> fluxes = CreateProfiledFluxes(problem_);
+    std::vector<FluxConfidenceInterval> intervals(fluxes.size());
+    const size_t total_workers = std::max<size_t>(1, std::min(parameters_.total_threads, fluxes.size()));
+    std::atomic<size_t> next_flux{0};
+
+    auto calculate_intervals = [this, &fluxes, &intervals, &next_flux, &best_free_fluxes, best_ssr] {
+        ProfileFitter fitter(problem_, generator_);
+        FeasibleRangeFinder range_finder(problem_);
+        for (size_t flux = next_flux++; flux < fluxes.size(); flux = next_flux++) {
+            intervals[flux] = CalculateInterval(fitter, range_finder, problem_, fluxes[flux], best_free_fluxes,
+                                                best_ssr, parameters_);
+        }
+    };
+
+    // Every worker thread has its own glpk environment, which is freed when the thread is finished.
+    // The environment of the calling thread may hold the problems of the caller, so it isn't freed
+    const auto start_time = std::chrono::steady_clock::now();
+    if (total_workers == 1) {
+        calculate_intervals();
+    } else {
+        std::vector<std::exception_ptr> exceptions(total_workers);
+        std::vector<std::thread> workers;
+        for (size_t worker = 0; worker < total_workers; ++worker) {
+            workers.emplace_back([&calculate_intervals, &exceptions, worker] {
+                try {
+                    calculate_intervals();
+                } catch (...) {
+                    exceptions[worker] = std::current_exception();
+                }
+                glp_free_env();
+            });
+        }
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+        for (const std::exception_ptr& exception : exceptions) {
+            if (exception) {
+                std::rethrow_exception(exception);
+            }
+        }
+    }
+    const auto end_time = std::chrono::steady_clock::now();
+
+    const double elapsed_seconds = std::chrono::duration<double>(end_time - start_time).count();
+    std::cout << "Confidence intervals of " << fluxes.size() << " fluxes in " << elapsed_seconds << " seconds on "
+              << total_workers << " threads" << std::endl;
+    return intervals;
+}
+
+void PrintConfidenceIntervals(const std::vector<FluxConfidenceInterval> &intervals) {
+    // one write, so the output isn't mixed with the messages of other threads
+    std::ostringstream message;
+    for (const FluxConfidenceInterval &interval : intervals) {
+        message << interval.name;
+        if (interval.type == ProfiledFluxType::net) {
+            message << " net";
+        } else if (interval.type == ProfiledFluxType::exchange) {
+            message << " exchange";
+        }
+        message << ": " << interval.best_value << " ["
+                << interval.lower << (interval.is_lower_feasible_limit ? "*" : "") << ", "
+                << interval.upper << (interval.is_upper_feasible_limit ? "*" : "") << "]" << std::endl;
+    }
+    message << "* the end of the feasible range" << std::endl;
+    std::cout << message.str();
+}
+} // namespace khnum
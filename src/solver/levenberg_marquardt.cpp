@@ -0,0 +1,348 @@
+#include "solver/levenberg_marquardt.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+
+namespace khnum {
+namespace {
+const double initial_damping = 1e-3;
+const double max_damping = 1e16;
+const double min_scaling = 1e-12;
+// smaller predicted reductions of the ssr are lost in the rounding errors
+const double min_relative_reduction = 1e-14;
+// constraints with smaller slacks are active
+const double active_tolerance = 1e-10;
+const double feasibility_tolerance = 1e-10;
+const int max_projection_sweeps = 1000;
+}
+
+LevenbergMarquardt::LevenbergMarquardt(int total_residuals,
+                                       const Eigen::VectorXd& lower_bounds,
+                                       const Eigen::VectorXd& upper_bounds,
+                                       const Matrix& inequalities,
+                                       const Eigen::VectorXd& inequality_bounds,
+                                       const LevenbergMarquardtParameters& parameters) :
+                                                                        total_variables_(lower_bounds.size()),
+                                                                        total_residuals_(total_residuals),
+                                                                        lower_bounds_(lower_bounds),
+                                                                        upper_bounds_(upper_bounds),
+                                                                        parameters_(parameters) {
+    std::vector<int> nonzero_rows;
+    for (int row = 0; row < inequalities.rows(); ++row) {
+        if (inequalities.row(row).norm() > 0.0) {
+            nonzero_rows.push_back(row);
+        }
+    }
+    inequalities_.resize(nonzero_rows.size(), total_variables_);
+    inequality_bounds_.resize(nonzero_rows.size());
+    for (size_t i = 0; i < nonzero_rows.size(); ++i) {
+        const double norm = inequalities.row(nonzero_rows[i]).norm();
+        inequalities_.row(i) = inequalities.row(nonzero_rows[i]) / norm;
+        inequality_bounds_[i] = inequality_bounds[nonzero_rows[i]] / norm;
+    }
+
+    equalities_.resize(0, total_variables_);
+    equality_bounds_.resize(0);
+
+    x_.resize(total_variables_);
+    residuals_.resize(total_residuals_);
+    jacobian_.resize(total_residuals_, total_variables_);
+    trial_x_.resize(total_variables_);
+    trial_residuals_.resize(total_residuals_);
+    trial_jacobian_.resize(total_residuals_, total_variables_);
+    difference_residuals_.resize(total_residuals_);
+}
+
+const Eigen::VectorXd& LevenbergMarquardt::Minimize(const ResidualFunction& function,
+                                                     bool has_jacobian,
+                                                     const Eigen::VectorXd& start) {
+    report_ = LevenbergMarquardtReport();
+    x_ = start;
+    ProjectOnFeasibleSet(x_);
+
+    function(x_, residuals_, has_jacobian ? &jacobian_ : nullptr);
+    ++report_.residual_evaluations;
+    CalculateJacobian(function, has_jacobian);
+    double ssr = residuals_.squaredNorm();
+    report_.initial_ssr = ssr;
+
+    scaling_ = Eigen::VectorXd::Constant(total_variables_, min_scaling);
+    double damping = initial_damping;
+    double damping_growth = 2.0;
+    bool point_changed = true;
+    while (report_.iterations < parameters_.max_iterations) {
+        if (point_changed) {
+            normal_matrix_.noalias() = jacobian_.transpose() * jacobian_;
+            gradient_.noalias() = jacobian_.transpose() * residuals_;
+            scaling_ = scaling_.cwiseMax(normal_matrix_.diagonal());
+            UpdateWorkingSet();
+            UpdateFreeDirections();
+            point_changed = false;
+        }
+
+        // the damped step in the free directions,
+        // a step blocked too early to change the SSR activates the blocking constraint
+        Eigen::VectorXd step;
+        double step_share = 0.0;
+        double predicted_reduction = 0.0;
+        bool is_converged = false;
+        while (true) {
+            if (free_directions_.cols() == 0 ||
+                (free_directions_.transpose() * gradient_).lpNorm<Eigen::Infinity>() <=
+                    parameters_.gradient_tolerance) {
+                is_converged = true;
+                break;
+            }
+            Matrix reduced_matrix = free_directions_.transpose() * normal_matrix_ * free_directions_;
+            reduced_matrix.noalias() += damping * free_directions_.transpose() * scaling_.asDiagonal() *
+                                        free_directions_;
+            const Eigen::VectorXd reduced_step =
+                reduced_matrix.ldlt().solve(-free_directions_.transpose() * gradient_);
+            step = free_directions_ * reduced_step;
+
+            int blocking_constraint = -1;
+            step_share = GetMaxStep(step, blocking_constraint);
+            // the reduction of |r|^2 / 2
+            predicted_reduction = -step_share * gradient_.dot(step) -
+                                  0.5 * step_share * step_share * (jacobian_ * step).squaredNorm();
+            if (blocking_constraint < 0 || predicted_reduction > min_relative_reduction * ssr) {
+                break;
+            }
+            working_set_.push_back(blocking_constraint);
+            UpdateFreeDirections();
+        }
+        if (is_converged) {
+            report_.status = LevenbergMarquardtStatus::gradient_tolerance;
+            break;
+        }
+
+        if (predicted_reduction <= min_relative_reduction * ssr) {
+            report_.status = LevenbergMarquardtStatus::no_progress;
+            break;
+        }
+        trial_x_ = (x_ + step_share * step).cwiseMax(lower_bounds_).cwiseMin(upper_bounds_);
+
+        function(trial_x_, trial_residuals_, has_jacobian ? &trial_jacobian_ : nullptr);
+        ++report_.residual_evaluations;
+        if (has_jacobian) {
+            ++report_.jacobian_evaluations;
+        }
+        const double trial_ssr = trial_residuals_.squaredNorm();
+
+        const double actual_reduction = 0.5 * (ssr - trial_ssr);
+        const double gain_ratio = actual_reduction / predicted_reduction;
+        if (gain_ratio > 0.0 && std::isfinite(trial_ssr)) {
+            std::swap(x_, trial_x_);
+            std::swap(residuals_, trial_residuals_);
+            if (has_jacobian) {
+                std::swap(jacobian_, trial_jacobian_);
+            } else {
+                CalculateJacobian(function, has_jacobian);
+            }
+            ssr = trial_ssr;
+            point_changed = true;
+            ++report_.iterations;
+
+            damping *= std::max(1.0 / 3.0, 1.0 - std::pow(2.0 * gain_ratio - 1.0, 3));
+            damping_growth = 2.0;
+            // a step cut by a constraint isn't a sign of convergence
+            if (step.norm() <= parameters_.step_tolerance) {
+                report_.status = LevenbergMarquardtStatus::step_tolerance;
+                break;
+            }
+        } else {
+            ++report_.rejected_steps;
+            damping *= damping_growth;
+            damping_growth *= 2.0;
+            if (damping > max_damping) {
+                report_.status = LevenbergMarquardtStatus::no_progress;
+                break;
+            }
+        }
+    }
+
+    report_.final_ssr = ssr;
+    return x_;
+}
+
+void LevenbergMarquardt::SetEqualities(const Matrix& equalities, const Eigen::VectorXd& equality_bounds) {
+    // the zero rows hold for any variables if their bounds are zero, otherwise for none
+    std::vector<int> nonzero_rows;
+    for (int row = 0; row < equalities.rows(); ++row) {
+        if (equalities.row(row).norm() > 0.0) {
+            nonzero_rows.push_back(row);
+        } else if (equality_bounds[row] != 0.0) {
+            throw std::runtime_error("There is a zero equality with a nonzero bound");
+        }
+    }
+    equalities_.resize(nonzero_rows.size(), total_variables_);
+    equality_bounds_.resize(nonzero_rows.size());
+    for (size_t i = 0; i < nonzero_rows.size(); ++i) {
+        const double norm = equalities.row(nonzero_rows[i]).norm();
+        equalities_.row(i) = equalities.row(nonzero_rows[i]) / norm;
+        equality_bounds_[i] = equality_bounds[nonzero_rows[i]] / norm;
+    }
+}
+
+const LevenbergMarquardtReport& LevenbergMarquardt::GetReport() const {
+    return report_;
+}
+
+double LevenbergMarquardt::GetSlack(int constraint, const Eigen::VectorXd& x) const {
+    if (constraint < total_variables_) {
+        return x[constraint] - lower_bounds_[constraint];
+    }
+    if (constraint < 2 * total_variables_) {
+        return upper_bounds_[constraint - total_variables_] - x[constraint - total_variables_];
+    }
+    const int row = constraint - 2 * total_variables_;
+    if (row < inequalities_.rows()) {
+        return inequality_bounds_[row] - inequalities_.row(row).dot(x);
+    }
+    return equality_bounds_[row - inequalities_.rows()] - equalities_.row(row - inequalities_.rows()).dot(x);
+}
+
+double LevenbergMarquardt::GetNormalProduct(int constraint, const Eigen::VectorXd& direction) const {
+    if (constraint < total_variables_) {
+        return -direction[constraint];
+    }
+    if (constraint < 2 * total_variables_) {
+        return direction[constraint - total_variables_];
+    }
+    return inequalities_.row(constraint - 2 * total_variables_).dot(direction);
+}
+
+Eigen::VectorXd LevenbergMarquardt::GetNormal(int constraint) const {
+    if (constraint < 2 * total_variables_) {
+        Eigen::VectorXd normal = Eigen::VectorXd::Zero(total_variables_);
+        normal[constraint % total_variables_] = constraint < total_variables_ ? -1.0 : 1.0;
+        return normal;
+    }
+    const int row = constraint - 2 * total_variables_;
+    if (row < inequalities_.rows()) {
+        return inequalities_.row(row).transpose();
+    }
+    return equalities_.row(row - inequalities_.rows()).transpose();
+}
+
+void LevenbergMarquardt::ProjectOnFeasibleSet(Eigen::VectorXd& x) const {
+    x = x.cwiseMax(lower_bounds_).cwiseMin(upper_bounds_);
+    auto get_max_violation = [this](const Eigen::VectorXd& point) {
+        double violation = 0.0;
+        if (inequalities_.rows() > 0) {
+            violation = std::max(violation, (inequalities_ * point - inequality_bounds_).maxCoeff());
+        }
+        if (equalities_.rows() > 0) {
+            violation = std::max(violation, (equalities_ * point - equality_bounds_).lpNorm<Eigen::Infinity>());
+        }
+        return violation;
+    };
+    if (get_max_violation(x) <= feasibility_tolerance) {
+        return;
+    }
+
+    // the projections on the hyperplanes need no corrections
+    Matrix corrections = Matrix::Zero(total_variables_, inequalities_.rows());
+    Eigen::VectorXd box_correction = Eigen::VectorXd::Zero(total_variables_);
+    for (int sweep = 0; sweep < max_projection_sweeps && get_max_violation(x) > feasibility_tolerance; ++sweep) {
+        for (int row = 0; row < equalities_.rows(); ++row) {
+            x -= (equalities_.row(row).dot(x) - equality_bounds_[row]) * equalities_.row(row).transpose();
+        }
+        for (int row = 0; row < inequalities_.rows(); ++row) {
+            const Eigen::VectorXd corrected = x + corrections.col(row);
+            const double violation = inequalities_.row(row).dot(corrected) - inequality_bounds_[row];
+            x = violation > 0.0 ? Eigen::VectorXd(corrected - violation * inequalities_.row(row).transpose()) :
+                                  corrected;
+            corrections.col(row) = corrected - x;
+        }
+        const Eigen::VectorXd corrected = x + box_correction;
+        x = corrected.cwiseMax(lower_bounds_).cwiseMin(upper_bounds_);
+        box_correction = corrected - x;
+    }
+}
+
+void LevenbergMarquardt::UpdateWorkingSet() {
+    working_set_.clear();
+    const int total_inequalities = 2 * total_variables_ + inequalities_.rows();
+    for (int row = 0; row < equalities_.rows(); ++row) {
+        working_set_.push_back(total_inequalities + row);
+    }
+    const double tolerance = active_tolerance * std::max(1.0, x_.lpNorm<Eigen::Infinity>());
+    for (int constraint = 0; constraint < total_inequalities; ++constraint) {
+        if (GetSlack(constraint, x_) <= tolerance) {
+            working_set_.push_back(constraint);
+        }
+    }
+
+    // KKT: gradient + normals * multipliers = 0, the inequality with the most negative multiplier is released
+    const int total_equalities = equalities_.rows();
+    while (working_set_.size() > static_cast<size_t>(total_equalities)) {
+        Matrix normals(total_variables_, working_set_.size());
+        for (size_t i = 0; i < working_set_.size(); ++i) {
+            normals.col(i) = GetNormal(working_set_[i]);
+        }
+        const Eigen::VectorXd multipliers = normals.completeOrthogonalDecomposition().solve(-gradient_);
+        Eigen::Index released = 0;
+        if (multipliers.tail(multipliers.size() - total_equalities).minCoeff(&released) >=
+            -std::numeric_limits<double>::epsilon() * gradient_.norm()) {
+            break;
+        }
+        working_set_.erase(working_set_.begin() + total_equalities + released);
+    }
+}
+
+void LevenbergMarquardt::UpdateFreeDirections() {
+    if (working_set_.empty()) {
+        free_directions_ = Matrix::Identity(total_variables_, total_variables_);
+        return;
+    }
+    Matrix normals(total_variables_, working_set_.size());
+    for (size_t i = 0; i < working_set_.size(); ++i) {
+        normals.col(i) = GetNormal(working_set_[i]);
+    }
+    const Eigen::ColPivHouseholderQR<Matrix> decomposition(normals);
+    const Matrix orthogonal = decomposition.householderQ();
+    free_directions_ = orthogonal.rightCols(total_variables_ - decomposition.rank());
+}
+
+double LevenbergMarquardt::GetMaxStep(const Eigen::VectorXd& direction, int& blocking_constraint) const {
+    double max_step = 1.0;
+    blocking_constraint = -1;
+    const int total_constraints = 2 * total_variables_ + inequalities_.rows();
+    for (int constraint = 0; constraint < total_constraints; ++constraint) {
+        const double normal_product = GetNormalProduct(constraint, direction);
+        if (normal_product <= 0.0 ||
+            std::find(working_set_.begin(), working_set_.end(), constraint) != working_set_.end()) {
+            continue;
+        }
+        const double step = std::max(0.0, GetSlack(constraint, x_)) / normal_product;
+        if (step < max_step) {
+            max_step = step;
+            blocking_constraint = constraint;
+        }
+    }
+    return max_step;
+}
+
+void LevenbergMarquardt::CalculateJacobian(const ResidualFunction& function, bool has_jacobian) {
+    ++report_.jacobian_evaluations;
+    if (has_jacobian) {
+        return;
+    }
+    // the difference point stays in the bounds
+    for (int variable = 0; variable < total_variables_; ++variable) {
+        double difference_step = parameters_.difference_step * std::max(1.0, std::abs(x_[variable]));
+        if (x_[variable] + difference_step > upper_bounds_[variable]) {
+            difference_step = -difference_step;
+        }
+        trial_x_ = x_;
+        trial_x_[variable] += difference_step;
+        function(trial_x_, difference_residuals_, nullptr);
+        ++report_.residual_evaluations;
+        jacobian_.col(variable) = (difference_residuals_ - residuals_) / difference_step;
+    }
+}
+} // namespace khnum
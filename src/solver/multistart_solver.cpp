@@ -0,0 +1,46 @@
+#include "solver/multistart_solver.h"
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+
+#include "solver/solver.h"
+#include "solver/start_points.h"
+#include "utilities/thread_pool.h"
+
+
+namespace khnum {
+MultistartSolver::MultistartSolver(const Problem &problem, const SimulatorGenerator &generator) :
+                                                                                   problem_{problem},
+                                                                                   generator_{generator} {
+}
+
+std::vector<alglib::real_1d_array> MultistartSolver::Solve() {
+    const size_t total_starts = problem_.total_starts;
+    const size_t total_workers = std::max<size_t>(1, std::min(problem_.multistart_threads, total_starts));
+    std::vector<alglib::real_1d_array> solutions(total_starts);
+    std::atomic<size_t> next_start{0};
+    const std::vector<Eigen::VectorXd> start_points = GenerateStartPoints(problem_.nullspace, problem_.lower_bounds,
+                                                                          problem_.upper_bounds, total_starts,
+                                                                          problem_.start_points_method,
+                                                                          problem_.starts_seed);
+
+    const auto start_time = std::chrono::steady_clock::now();
+    ThreadPool thread_pool(total_workers);
+    for (size_t worker = 0; worker < total_workers; ++worker) {
+        thread_pool.Submit([this, &solutions, &next_start, &start_points, total_starts] {
+            Solver solver(problem_, generator_);
+            for (size_t start = next_start++; start < total_starts; start = next_start++) {
+                solutions[start] = solver.SolveFromPoint(start_points[start]);
+            }
+        });
+    }
+    thread_pool.Wait();
+    const auto end_time = std::chrono::steady_clock::now();
+
+    const double elapsed_seconds = std::chrono::duration<double>(end_time - start_time).count();
+    std::cout << "Average time: " << elapsed_seconds / total_starts << " seconds per iteration on "
+              << total_workers << " threads" << std::endl;
+    return solutions;
+}
+} // namespace khnum
@@ -1,8 +1,8 @@
 #include "solver/solver.h"
 
-#include <random>
 #include <chrono>
 #include <ctime>
+#include <sstream>
 #include "alglib/optimization.h"
 
 #include "simulator/simulator.h"
@@ -15,20 +15,24 @@
 namespace khnum {
 
 
-Solver::Solver(const Problem &problem, const SimulatorGenerator &generator) {
+Solver::Solver(const Problem &problem, const SimulatorGenerator &generator) :
+                                                                reactions_{problem.reactions},
+                                                                nullspace_{problem.nullspace},
+                                                                measured_mids_{problem.measurements} {
     new_simulator_.emplace(generator.Generate());
+    new_simulator_->SetJacobianThreads(problem.jacobian_threads);
     reactions_num_ = problem.reactions_total;
-    nullspace_ = problem.nullspace;
-    measured_mids_ = problem.measurements;
     measurements_count_ = problem.measurements_count;
     use_analytic_gradient_ = problem.use_analytic_jacobian;
-    reactions_ = problem.reactions;
+    least_squares_solver_ = problem.least_squares_solver;
 
     nullity_ = nullspace_.cols();
     free_fluxes_.setlength(nullity_);
 
     iteration_ = 0;
-    iteration_total_ = 30;
+    iteration_total_ = problem.total_starts;
+    starts_seed_ = problem.starts_seed;
+    start_points_method_ = problem.start_points_method;
 
     lower_bounds_.setlength(nullity_);
     upper_bounds_.setlength(nullity_);
@@ -37,6 +41,13 @@ Solver::Solver(const Problem &problem, const SimulatorGenerator &generator) {
         upper_bounds_[i] = problem.upper_bounds[i];
     }
 
+    // the dependent fluxes -nullspace * free_fluxes are nonnegative
+    if (least_squares_solver_ == LeastSquaresSolver::native) {
+        native_solver_.emplace(measurements_count_,
+                               Eigen::Map<const Eigen::VectorXd>(problem.lower_bounds.data(), nullity_),
+                               Eigen::Map<const Eigen::VectorXd>(problem.upper_bounds.data(), nullity_),
+                               nullspace_, Eigen::VectorXd::Zero(nullspace_.rows()));
+    }
 }
 
 
@@ -45,23 +56,23 @@ std::vector<alglib::real_1d_array> Solver::GetResult() {
 }
 
 
-void Solver::Solve() {
-    std::random_device randomizer;
-    std::mt19937 random_source(randomizer());
+int Solver::GetLastIterationsCount() const {
+    if (least_squares_solver_ == LeastSquaresSolver::native) {
+        return native_solver_->GetReport().iterations;
+    }
+    return report_.iterationscount;
+}
+
 
+void Solver::Solve() {
     std::chrono::time_point<std::chrono::system_clock> start, end;
     start = std::chrono::system_clock::now();
+    const std::vector<Eigen::VectorXd> start_points = GenerateStartPoints(nullspace_,
+        std::vector<double>(lower_bounds_.getcontent(), lower_bounds_.getcontent() + nullity_),
+        std::vector<double>(upper_bounds_.getcontent(), upper_bounds_.getcontent() + nullity_),
+        iteration_total_, start_points_method_, starts_seed_);
     for (iteration_ = 0; iteration_ < iteration_total_; ++iteration_) {
-        GenerateInitialPoints(random_source);
-        if (iteration_ == 0) {
-            SetOptimizationParameters();
-        } else {
-            alglib::minlmrestartfrom(state_, free_fluxes_);
-        }
-
-        alglib::real_1d_array new_solution = RunOptimization();
-
-        all_solutions_.emplace_back(new_solution);
+        all_solutions_.emplace_back(SolveFromPoint(start_points[iteration_]));
     }
     end = std::chrono::system_clock::now();
     double elapsed_milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>
@@ -74,14 +85,24 @@ void Solver::Solve() {
 }
 
 
-void Solver::GenerateInitialPoints(std::mt19937 &random_source) {
-    std::uniform_real_distribution<> get_random_point(0.0, 1.0);
+alglib::real_1d_array Solver::SolveFromPoint(const Eigen::VectorXd &start_point) {
+    if (least_squares_solver_ == LeastSquaresSolver::native) {
+        return RunNativeOptimization(start_point);
+    }
 
     for (int i = 0; i < nullity_; ++i) {
-        free_fluxes_[i] = lower_bounds_[i] + get_random_point(random_source) * (upper_bounds_[i] - lower_bounds_[i]);
+        free_fluxes_[i] = start_point[i];
     }
-
     PrintStartMessage();
+
+    if (!is_state_created_) {
+        SetOptimizationParameters();
+        is_state_created_ = true;
+    } else {
+        alglib::minlmrestartfrom(state_, free_fluxes_);
+    }
+
+    return RunOptimization();
 }
 
 
@@ -172,7 +193,27 @@ alglib::real_1d_array Solver::RunOptimization() {
     alglib::real_1d_array final_free_fluxes;
     alglib::minlmresults(state_, final_free_fluxes, report_);
 
-    PrintFinalMessage(final_free_fluxes);
+    const SimulatorResult& result = new_simulator_->CalculateMids(GetEigenVectorFromAlgLibVector(final_free_fluxes),
+                                                                  false);
+    alglib::real_1d_array residuals;
+    residuals.setlength(measurements_count_);
+    Fillf0Array(residuals, result.simulated_mids);
+    PrintFinalMessage(GetSSR(residuals), report_.iterationscount);
+
+    return final_free_fluxes;
+}
+
+
+alglib::real_1d_array Solver::RunNativeOptimization(const Eigen::VectorXd &start_point) {
+    const LevenbergMarquardt::ResidualFunction function = [this](const Eigen::VectorXd &free_fluxes,
+                                                                 Eigen::VectorXd &residuals, Matrix *jacobian) {
+        CalculateResidual(free_fluxes, residuals, jacobian);
+    };
+    const Eigen::VectorXd &solution = native_solver_->Minimize(function, use_analytic_gradient_, start_point);
+
+    alglib::real_1d_array final_free_fluxes;
+    final_free_fluxes.setcontent(nullity_, solution.data());
+    PrintFinalMessage(native_solver_->GetReport().final_ssr, native_solver_->GetReport().iterations);
 
     return final_free_fluxes;
 }
@@ -201,8 +242,8 @@ void Solver::FillJacobian(alglib::real_2d_array &jac) {
     for (size_t isotope = 0; isotope < measured_mids_.size(); ++isotope) {
         for (size_t mass_shift = 0; mass_shift < measured_mids_[isotope].errors.size(); ++mass_shift) {
             for (size_t flux = 0; flux < diff_results_.size(); ++flux) {
-                float temp = diff_results_[flux][isotope].mid[mass_shift] / measured_mids_[isotope].errors[mass_shift];
-                jac(total_residuals, flux) = temp;
+                jac(total_residuals, flux) = diff_results_[flux][isotope].mid[mass_shift] /
+                                             measured_mids_[isotope].errors[mass_shift];
             }
             ++total_residuals;
         }
@@ -212,10 +253,8 @@ void Solver::FillJacobian(alglib::real_2d_array &jac) {
 
 void Solver::CalculateResidual(const alglib::real_1d_array &free_fluxes,
                                alglib::real_1d_array &residuals) {
-    std::vector<Flux> calculated_fluxes = CalculateAllFluxesFromFree(free_fluxes);
-
-
-    SimulatorResult result = new_simulator_->CalculateMids(calculated_fluxes, in_jacobian);
+    const Eigen::VectorXd free_fluxes_eigen = GetEigenVectorFromAlgLibVector(free_fluxes);
+    const SimulatorResult& result = new_simulator_->CalculateMids(free_fluxes_eigen, in_jacobian);
 
     diff_results_ = result.diff_results;
 
@@ -223,28 +262,28 @@ void Solver::CalculateResidual(const alglib::real_1d_array &free_fluxes,
 }
 
 
-std::vector<Flux> Solver::CalculateAllFluxesFromFree(const alglib::real_1d_array &free_fluxes_alglib) {
-    Eigen::VectorXd free_fluxes = GetEigenVectorFromAlgLibVector(free_fluxes_alglib);
-    Matrix depended_fluxes_matrix = -nullspace_ * free_fluxes;
-    std::vector<Flux> all_fluxes(reactions_num_, -1);
-    // non metabolite balance reactions
-    const int depended_reactions_total = depended_fluxes_matrix.rows();
-    const int
-        isotopomer_balance_reactions_total = reactions_num_ - depended_reactions_total - free_fluxes_alglib.length();
-
-    for (int i = 0; i < isotopomer_balance_reactions_total; ++i) {
-        all_fluxes[reactions_.at(i).id] = 1;
-    }
+void Solver::CalculateResidual(const Eigen::VectorXd &free_fluxes, Eigen::VectorXd &residuals, Matrix *jacobian) {
+    FillResiduals(new_simulator_->CalculateMids(free_fluxes, jacobian != nullptr), measured_mids_, residuals, jacobian);
+}
 
-    for (int i = 0; i < depended_reactions_total; ++i) {
-        all_fluxes[reactions_.at(i + isotopomer_balance_reactions_total).id] = depended_fluxes_matrix(i, 0);
-    }
 
-    for (int i = 0; i < free_fluxes_alglib.length(); ++i) {
-        all_fluxes[reactions_.at(reactions_num_ - free_fluxes_alglib.length() + i).id] = free_fluxes[i];
+void FillResiduals(const SimulatorResult &result, const std::vector<Measurement> &measurements,
+                   Eigen::VectorXd &residuals, Matrix *jacobian) {
+    int total_residuals = 0;
+    for (size_t isotope = 0; isotope < result.simulated_mids.size(); ++isotope) {
+        const Measurement& measurement = measurements[isotope];
+        for (size_t mass_shift = 0; mass_shift < result.simulated_mids[isotope].mid.size(); ++mass_shift) {
+            const double error = measurement.errors[mass_shift];
+            residuals[total_residuals] = (result.simulated_mids[isotope].mid[mass_shift] - measurement.mid[mass_shift]) /
+                                         error;
+            if (jacobian) {
+                for (size_t flux = 0; flux < result.diff_results.size(); ++flux) {
+                    (*jacobian)(total_residuals, flux) = result.diff_results[flux][isotope].mid[mass_shift] / error;
+                }
+            }
+            ++total_residuals;
+        }
     }
-
-    return all_fluxes;
 }
 
 
@@ -270,20 +309,10 @@ double Solver::GetSSR(const alglib::real_1d_array &residuals) {
 }
 
 
-void Solver::PrintFinalMessage(const alglib::real_1d_array &free_fluxes) {
-    std::vector<Flux> final_all_fluxes = CalculateAllFluxesFromFree(free_fluxes);
-    SimulatorResult result = new_simulator_->CalculateMids(final_all_fluxes, false);
-    alglib::real_1d_array residuals;
-    residuals.setlength(measurements_count_);
-    Fillf0Array(residuals, result.simulated_mids);
-    double ssr = GetSSR(residuals);
-/*
-    std::cout << "Finish at: " << std::endl;
-
-    for (int i = 0; i < free_fluxes.length(); ++i) {
-        std::cout << reactions_[reactions_num_ - free_fluxes.length() + i].id + 1 <<
-                  " = " << free_fluxes[i] << std::endl;
-    } */
-    std::cout << " Finish with SSR: " << ssr << " in " << report_.iterationscount << " steps." << std::endl;
+void Solver::PrintFinalMessage(double ssr, int iterations) {
+    // one write, so the messages of concurrent solvers are not mixed
+    std::ostringstream message;
+    message << " Finish with SSR: " << ssr << " in " << iterations << " steps." << std::endl;
+    std::cout << message.str();
 }
 } // namespace khnum
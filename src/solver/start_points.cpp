@@ -0,0 +1,269 @@
+#include "solver/start_points.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <numeric>
+#include <optional>
+#include <random>
+#include <glpk/glpk.h>
+
+
+namespace khnum {
+namespace {
+// widths below it are fixed fluxes
+const double min_width = 1.e-12;
+// smaller radius of the inscribed ball means the polytope is flat
+const double min_radius = 1.e-9;
+const double epsilon = 1.e-12;
+// infeasible latin hypercube points are moved to this part of the way from the interior point to the boundary
+const double boundary_share = 0.9;
+
+// The polytope A * y <= b, 0 <= y <= 1 in the scaled coordinates y = (v - lower) / (upper - lower)
+// of the fluxes which aren't fixed
+class ScaledPolytope {
+public:
+    ScaledPolytope(const Matrix& nullspace, const std::vector<double>& lower_bounds,
+                   const std::vector<double>& upper_bounds) : lower_bounds_(lower_bounds) {
+        const int total_fluxes = nullspace.cols();
+        widths_.resize(total_fluxes);
+        for (int flux = 0; flux < total_fluxes; ++flux) {
+            widths_[flux] = upper_bounds[flux] - lower_bounds[flux];
+            if (widths_[flux] > min_width * std::max(1.0, std::abs(upper_bounds[flux]))) {
+                sampled_fluxes_.push_back(flux);
+            } else {
+                widths_[flux] = 0.0;
+            }
+        }
+
+        A_.resize(nullspace.rows(), sampled_fluxes_.size());
+        for (size_t i = 0; i < sampled_fluxes_.size(); ++i) {
+            A_.col(i) = nullspace.col(sampled_fluxes_[i]) * widths_[sampled_fluxes_[i]];
+        }
+        // the fixed fluxes stay at their lower bounds
+        b_ = -nullspace * Eigen::Map<const Eigen::VectorXd>(lower_bounds.data(), lower_bounds.size());
+    }
+
+    int GetDimension() const {
+        return sampled_fluxes_.size();
+    }
+
+    Eigen::VectorXd GetFluxes(const Eigen::VectorXd& scaled_point) const {
+        Eigen::VectorXd fluxes = Eigen::Map<const Eigen::VectorXd>(lower_bounds_.data(), lower_bounds_.size());
+        for (size_t i = 0; i < sampled_fluxes_.size(); ++i) {
+            fluxes[sampled_fluxes_[i]] += widths_[sampled_fluxes_[i]] * scaled_point[i];
+        }
+        return fluxes;
+    }
+
+    Eigen::VectorXd GetSlacks(const Eigen::VectorXd& point) const {
+        return b_ - A_ * point;
+    }
+
+    // Chebyshev center: maximize r subject to A_i * y + |A_i| * r <= b_i, r <= y_j <= 1 - r
+    std::optional<Eigen::VectorXd> FindInteriorPoint() const {
+        const int dimension = GetDimension();
+        glp_term_out(GLP_OFF);
+        glp_prob* linear_problem = glp_create_prob();
+        glp_set_obj_dir(linear_problem, GLP_MAX);
+        glp_add_cols(linear_problem, dimension + 1);
+        for (int column = 1; column <= dimension; ++column) {
+            glp_set_col_bnds(linear_problem, column, GLP_DB, 0.0, 1.0);
+        }
+        glp_set_col_bnds(linear_problem, dimension + 1, GLP_DB, 0.0, 0.5);
+        glp_set_obj_coef(linear_problem, dimension + 1, 1.0);
+
+        std::vector<int> row_index = {0};
+        std::vector<int> col_index = {0};
+        std::vector<double> coefficients = {0.0};
+        int row = 0;
+        auto add_coefficient = [&](int column, double coefficient) {
+            row_index.push_back(row);
+            col_index.push_back(column);
+            coefficients.push_back(coefficient);
+        };
+        for (int constraint = 0; constraint < A_.rows(); ++constraint) {
+            const double norm = A_.row(constraint).norm();
+            if (norm == 0.0) {
+                continue;
+            }
+            row = glp_add_rows(linear_problem, 1);
+            glp_set_row_bnds(linear_problem, row, GLP_UP, 0.0, b_[constraint]);
+            for (int column = 0; column < dimension; ++column) {
+                if (A_(constraint, column) != 0.0) {
+                    add_coefficient(column + 1, A_(constraint, column));
+                }
+            }
+            add_coefficient(dimension + 1, norm);
+        }
+        for (int column = 0; column < dimension; ++column) {
+            row = glp_add_rows(linear_problem, 1);
+            glp_set_row_bnds(linear_problem, row, GLP_LO, 0.0, 0.0);
+            add_coefficient(column + 1, 1.0);
+            add_coefficient(dimension + 1, -1.0);
+
+            row = glp_add_rows(linear_problem, 1);
+            glp_set_row_bnds(linear_problem, row, GLP_UP, 0.0, 1.0);
+            add_coefficient(column + 1, 1.0);
+            add_coefficient(dimension + 1, 1.0);
+        }
+        glp_load_matrix(linear_problem, coefficients.size() - 1, row_index.data(), col_index.data(),
+                        coefficients.data());
+
+        glp_smcp parameters;
+        glp_init_smcp(&parameters);
+        parameters.msg_lev = GLP_MSG_OFF;
+        std::optional<Eigen::VectorXd> interior_point;
+        if (glp_simplex(linear_problem, &parameters) == 0 && glp_get_status(linear_problem) == GLP_OPT &&
+            glp_get_obj_val(linear_problem) > min_radius) {
+            interior_point.emplace(dimension);
+            for (int column = 0; column < dimension; ++column) {
+                (*interior_point)[column] = glp_get_col_prim(linear_problem, column + 1);
+            }
+        }
+        glp_delete_prob(linear_problem);
+        return interior_point;
+    }
+
+    // The biggest step along the direction from the point which stays in the polytope
+    double GetMaxStep(const Eigen::VectorXd& point, const Eigen::VectorXd& direction) const {
+        const Eigen::VectorXd slacks = GetSlacks(point);
+        const Eigen::VectorXd change = A_ * direction;
+        double max_step = std::numeric_limits<double>::infinity();
+        for (int constraint = 0; constraint < A_.rows(); ++constraint) {
+            if (change[constraint] > epsilon) {
+                max_step = std::min(max_step, std::max(0.0, slacks[constraint]) / change[constraint]);
+            }
+        }
+        for (int i = 0; i < point.size(); ++i) {
+            if (direction[i] > epsilon) {
+                max_step = std::min(max_step, (1.0 - point[i]) / direction[i]);
+            } else if (direction[i] < -epsilon) {
+                max_step = std::min(max_step, -point[i] / direction[i]);
+            }
+        }
+        return max_step;
+    }
+
+    // Moves the point to a uniformly chosen point of the chord through it in a random direction
+    void MakeHitAndRunStep(Eigen::VectorXd& point, std::mt19937& random_source) const {
+        std::normal_distribution<double> normal(0.0, 1.0);
+        Eigen::VectorXd direction(point.size());
+        for (int i = 0; i < direction.size(); ++i) {
+            direction[i] = normal(random_source);
+        }
+        direction.normalize();
+
+        const double forward = GetMaxStep(point, direction);
+        const double backward = GetMaxStep(point, -direction);
+        std::uniform_real_distribution<double> step(-backward, forward);
+        point += step(random_source) * direction;
+    }
+
+    // Only the nullspace constraints, the box is satisfied by construction
+    bool IsFeasible(const Eigen::VectorXd& point) const {
+        return A_.rows() == 0 || GetSlacks(point).minCoeff() >= -epsilon;
+    }
+
+private:
+    std::vector<double> lower_bounds_;
+    std::vector<double> widths_;
+    std::vector<int> sampled_fluxes_;
+    Matrix A_;
+    Eigen::VectorXd b_;
+};
+
+std::vector<Eigen::VectorXd> GenerateUniformPoints(const std::vector<double>& lower_bounds,
+                                                   const std::vector<double>& upper_bounds,
+                                                   size_t total_points,
+                                                   unsigned int seed) {
+    std::vector<Eigen::VectorXd> points;
+    for (size_t point = 0; point < total_points; ++point) {
+        std::mt19937 random_source(seed + point);
+        std::uniform_real_distribution<> get_random_point(0.0, 1.0);
+        Eigen::VectorXd fluxes(lower_bounds.size());
+        for (size_t i = 0; i < lower_bounds.size(); ++i) {
+            fluxes[i] = lower_bounds[i] + get_random_point(random_source) * (upper_bounds[i] - lower_bounds[i]);
+        }
+        points.push_back(std::move(fluxes));
+    }
+    return points;
+}
+
+std::vector<Eigen::VectorXd> GenerateLatinHypercube(const ScaledPolytope& polytope,
+                                                    const Eigen::VectorXd& interior_point,
+                                                    size_t total_points,
+                                                    std::mt19937& random_source) {
+    const int dimension = polytope.GetDimension();
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    std::vector<Eigen::VectorXd> points(total_points, Eigen::VectorXd(dimension));
+    std::vector<size_t> strata(total_points);
+    for (int i = 0; i < dimension; ++i) {
+        std::iota(strata.begin(), strata.end(), 0);
+        std::shuffle(strata.begin(), strata.end(), random_source);
+        for (size_t point = 0; point < total_points; ++point) {
+            points[point][i] = (strata[point] + uniform(random_source)) / total_points;
+        }
+    }
+
+    for (Eigen::VectorXd& point : points) {
+        if (!polytope.IsFeasible(point)) {
+            const Eigen::VectorXd direction = point - interior_point;
+            point = interior_point + boundary_share * polytope.GetMaxStep(interior_point, direction) * direction;
+        }
+    }
+    return points;
+}
+
+// The chain makes as many steps between the points as there are dimensions, and the same before the first one
+std::vector<Eigen::VectorXd> GenerateHitAndRun(const ScaledPolytope& polytope,
+                                               const Eigen::VectorXd& interior_point,
+                                               size_t total_points,
+                                               std::mt19937& random_source) {
+    const int steps_per_point = std::max(polytope.GetDimension(), 10);
+    std::vector<Eigen::VectorXd> points;
+    Eigen::VectorXd point = interior_point;
+    for (int step = 0; step < steps_per_point; ++step) {
+        polytope.MakeHitAndRunStep(point, random_source);
+    }
+    while (points.size() < total_points) {
+        for (int step = 0; step < steps_per_point; ++step) {
+            polytope.MakeHitAndRunStep(point, random_source);
+        }
+        points.push_back(point);
+    }
+    return points;
+}
+}
+
+std::vector<Eigen::VectorXd> GenerateStartPoints(const Matrix& nullspace,
+                                                 const std::vector<double>& lower_bounds,
+                                                 const std::vector<double>& upper_bounds,
+                                                 size_t total_points,
+                                                 StartPointsMethod method,
+                                                 unsigned int seed) {
+    if (method == StartPointsMethod::uniform) {
+        return GenerateUniformPoints(lower_bounds, upper_bounds, total_points, seed);
+    }
+
+    const ScaledPolytope polytope(nullspace, lower_bounds, upper_bounds);
+    const std::optional<Eigen::VectorXd> interior_point = polytope.FindInteriorPoint();
+    if (!interior_point) {
+        std::cout << "The free fluxes polytope has no interior, the start points are uniform in the bounds"
+                  << std::endl;
+        return GenerateUniformPoints(lower_bounds, upper_bounds, total_points, seed);
+    }
+
+    std::mt19937 random_source(seed);
+    const std::vector<Eigen::VectorXd> scaled_points = method == StartPointsMethod::latin_hypercube ?
+        GenerateLatinHypercube(polytope, *interior_point, total_points, random_source) :
+        GenerateHitAndRun(polytope, *interior_point, total_points, random_source);
+
+    std::vector<Eigen::VectorXd> points;
+    for (const Eigen::VectorXd& scaled_point : scaled_points) {
+        points.push_back(polytope.GetFluxes(scaled_point));
+    }
+    return points;
+}
+} // namespace khnum
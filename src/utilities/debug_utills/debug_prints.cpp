@@ -34,10 +34,7 @@ void PrintEmuSubstrate(const EmuSubstrate& emu) {
 
 
 void PrintEmu(const Emu& emu) {
-    std::cout << emu.name << ":";
-    for (int atom_state : emu.atom_states) {
-        std::cout << atom_state;
-    }
+    std::cout << GetEmuName(emu);
 }
 
 
@@ -1,22 +1,102 @@
 #include "utilities/emu.h"
 
+#include <deque>
+#include <mutex>
+#include <stdexcept>
 #include <tuple>
+#include <unordered_map>
 
 
 namespace khnum {
+namespace {
+struct MetaboliteTable {
+    std::mutex mutex;
+    std::unordered_map<std::string, int> ids;
+    std::deque<std::string> names; // references to the names stay valid when new ones are added
+};
+
+MetaboliteTable& GetMetaboliteTable() {
+    static MetaboliteTable table;
+    return table;
+}
+}
+
+int GetMetaboliteId(const std::string& name) {
+    MetaboliteTable& table = GetMetaboliteTable();
+    std::lock_guard<std::mutex> lock(table.mutex);
+    auto inserted = table.ids.emplace(name, static_cast<int>(table.names.size()));
+    if (inserted.second) {
+        table.names.push_back(name);
+    }
+    return inserted.first->second;
+}
+
+const std::string& GetMetaboliteName(int metabolite) {
+    MetaboliteTable& table = GetMetaboliteTable();
+    std::lock_guard<std::mutex> lock(table.mutex);
+    return table.names.at(metabolite);
+}
+
+Emu CreateEmu(int metabolite, int total_atoms) {
+    if (total_atoms > static_cast<int>(max_metabolite_atoms)) {
+        throw std::runtime_error("Metabolites with more than " + std::to_string(max_metabolite_atoms) +
+                                 " atoms are not supported");
+    }
+    Emu emu;
+    emu.metabolite = metabolite;
+    emu.total_atoms = total_atoms;
+    return emu;
+}
+
+Emu CreateEmu(const std::string& name, const AtomStates& atom_states) {
+    Emu emu = CreateEmu(GetMetaboliteId(name), static_cast<int>(atom_states.size()));
+    for (int atom = 0; atom < emu.total_atoms; ++atom) {
+        if (atom_states[atom]) {
+            IncludeAtom(emu, atom);
+        }
+    }
+    return emu;
+}
+
+AtomStates GetAtomStates(const Emu& emu) {
+    AtomStates atom_states(emu.total_atoms, false);
+    for (int atom = 0; atom < emu.total_atoms; ++atom) {
+        atom_states[atom] = IsAtomIncluded(emu, atom);
+    }
+    return atom_states;
+}
+
+std::string GetEmuName(const Emu& emu) {
+    std::string name = GetMetaboliteName(emu.metabolite);
+    name += ":";
+    for (int atom = 0; atom < emu.total_atoms; ++atom) {
+        name += IsAtomIncluded(emu, atom) ? "1" : "0";
+    }
+    return name;
+}
+
+size_t EmuHash::operator()(const Emu& emu) const {
+    // the words are mixed so that the emus of one metabolite don't collide in the low bits
+    std::uint64_t hash = static_cast<std::uint64_t>(emu.metabolite);
+    for (std::uint64_t word : emu.atoms) {
+        hash ^= word * 0x9E3779B97F4A7C15ull + 0x632BE59BD9B4E019ull + (hash << 6) + (hash >> 2);
+    }
+    return static_cast<size_t>(hash);
+}
 
 // need this for std containers
 bool comparator(const Emu& lhs, const Emu& rhs) {
-    return tie(lhs.name, lhs.atom_states) < tie(rhs.name, rhs.atom_states);
+    return lhs < rhs;
 }
 
+// the emus of one metabolite have the same number of atoms, so it isn't compared
 bool operator<(const Emu &lhs, const Emu &rhs) {
-    return tie(lhs.name, lhs.atom_states) < tie(rhs.name, rhs.atom_states);
+    return std::tie(lhs.metabolite, lhs.atoms) < std::tie(rhs.metabolite, rhs.atoms);
 }
 
 
 bool operator==(const Emu &lhs, const Emu &rhs) {
-    return !(lhs < rhs) && !(rhs < lhs);
+    return lhs.metabolite == rhs.metabolite && lhs.atoms == rhs.atoms;
 }
 
 
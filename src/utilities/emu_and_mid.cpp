@@ -3,26 +3,75 @@
 #include <algorithm>
 #include <tuple>
 
+#include "utilities/matrix.h"
+
 
 namespace khnum {
-// convolution
-Mid operator*(const Mid &lhs, const Mid &rhs) {
-    Mid convolve_result(lhs.size() + rhs.size() - 1, 0.0);
-    for (size_t mass_shift = 0; mass_shift < convolve_result.size(); ++mass_shift) {
-        for (size_t lhs_mass_shift = 0; lhs_mass_shift < lhs.size(); ++lhs_mass_shift) {
-            if (mass_shift >= lhs_mass_shift) {
-                size_t rhs_mass_shift = mass_shift - lhs_mass_shift;
-                if (rhs_mass_shift < rhs.size()) {
-                    convolve_result[mass_shift] += lhs[lhs_mass_shift] * rhs[rhs_mass_shift];
-                }
-            }
+namespace {
+using Packet = Eigen::internal::packet_traits<double>::type;
+using HalfPacket = Eigen::internal::packet_traits<double>::half;
+
+// result[0, size) += factor * values[0, size) with the widest packets, then one half packet and the scalar tail.
+// The mids are short, so the half packet covers most of the tail of AVX-512 and AVX
+void AddScaled(double factor, const double *values, size_t size, double *__restrict result) {
+    namespace internal = Eigen::internal;
+    const size_t packet_size = sizeof(Packet) / sizeof(double);
+    const size_t half_packet_size = sizeof(HalfPacket) / sizeof(double);
+
+    size_t position = 0;
+    if (size >= packet_size) {
+        const Packet factor_packet = internal::pset1<Packet>(factor);
+        for (; position + packet_size <= size; position += packet_size) {
+            internal::pstoreu(result + position, internal::pmadd(factor_packet,
+                                                                 internal::ploadu<Packet>(values + position),
+                                                                 internal::ploadu<Packet>(result + position)));
         }
     }
+    if (half_packet_size < packet_size && position + half_packet_size <= size) {
+        internal::pstoreu(result + position, internal::pmadd(internal::pset1<HalfPacket>(factor),
+                                                             internal::ploadu<HalfPacket>(values + position),
+                                                             internal::ploadu<HalfPacket>(result + position)));
+        position += half_packet_size;
+    }
+    for (; position < size; ++position) {
+        result[position] += factor * values[position];
+    }
+}
+}
 
+// convolution
+Mid operator*(const Mid &lhs, const Mid &rhs) {
+    Mid convolve_result;
+    Convolve(lhs, rhs, convolve_result);
     return convolve_result;
 }
 
 
+void Convolve(const Mid &lhs, const Mid &rhs, Mid &result) {
+    Convolve(lhs, rhs.data(), rhs.size(), result);
+}
+
+
+void Convolve(const Mid &lhs, const double *rhs, size_t rhs_size, Mid &result) {
+    result.resize(lhs.size() + rhs_size - 1);
+    Convolve(lhs.data(), lhs.size(), rhs, rhs_size, result.data());
+}
+
+
+void Convolve(const double *lhs, size_t lhs_size, const double *rhs, size_t rhs_size, double *__restrict result) {
+    std::fill(result, result + lhs_size + rhs_size - 1, 0.0);
+    for (size_t lhs_mass_shift = 0; lhs_mass_shift < lhs_size; ++lhs_mass_shift) {
+        AddScaled(lhs[lhs_mass_shift], rhs, rhs_size, result + lhs_mass_shift);
+    }
+}
+
+
+void Convolve(const InlineMid &lhs, const double *rhs, size_t rhs_size, InlineMid &result) {
+    result.size = lhs.size + rhs_size - 1;
+    Convolve(lhs.masses.data(), lhs.size, rhs, rhs_size, result.masses.data());
+}
+
+
 bool operator==(const EmuAndMid &lhs, const EmuAndMid &rhs) {
     return std::tie(lhs.emu, lhs.mid) == std::tie(rhs.emu, rhs.mid);
 }
@@ -0,0 +1,207 @@
+#include "utilities/thread_pool.h"
+
+#include <algorithm>
+
+
+namespace khnum {
+namespace {
+// The pool and the queue of the current thread if it is a worker
+thread_local const ThreadPool* current_pool = nullptr;
+thread_local size_t current_worker = 0;
+}
+
+ThreadPool::TaskGroup::TaskGroup(ThreadPool& thread_pool) : thread_pool_{thread_pool} {
+}
+
+// The group may be destroyed as soon as its last task is counted, so only the pool is used after that
+void ThreadPool::TaskGroup::Submit(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(thread_pool_.state_mutex_);
+        ++unfinished_tasks_;
+    }
+    thread_pool_.Submit([this, &thread_pool = thread_pool_, task = std::move(task)] {
+        try {
+            task();
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(exception_mutex_);
+            if (!exception_) {
+                exception_ = std::current_exception();
+            }
+        }
+        bool all_finished = false;
+        {
+            std::lock_guard<std::mutex> lock(thread_pool.state_mutex_);
+            all_finished = --unfinished_tasks_ == 0;
+        }
+        if (all_finished) {
+            thread_pool.tasks_finished_.notify_all();
+        }
+    });
+}
+
+void ThreadPool::TaskGroup::Wait() {
+    const size_t queue = thread_pool_.GetCurrentQueue();
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(thread_pool_.state_mutex_);
+            if (unfinished_tasks_ == 0) {
+                break;
+            }
+        }
+        if (thread_pool_.RunPendingTask(queue)) {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(thread_pool_.state_mutex_);
+        thread_pool_.tasks_finished_.wait(lock, [this] {
+            return unfinished_tasks_ == 0 || thread_pool_.pending_tasks_ > 0;
+        });
+    }
+
+    std::exception_ptr exception;
+    {
+        std::lock_guard<std::mutex> lock(exception_mutex_);
+        std::swap(exception, exception_);
+    }
+    if (exception) {
+        std::rethrow_exception(exception);
+    }
+}
+
+// The thread calling Wait() also executes tasks, so one thread less is started
+ThreadPool::ThreadPool(size_t total_threads) {
+    const size_t total_workers = total_threads > 1 ? total_threads - 1 : 0;
+    const size_t total_queues = std::max<size_t>(total_workers, 1);
+    for (size_t queue = 0; queue < total_queues; ++queue) {
+        queues_.emplace_back(new TaskQueue);
+    }
+    for (size_t worker = 0; worker < total_workers; ++worker) {
+        workers_.emplace_back(&ThreadPool::RunWorker, this, worker);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(state_mutex_);
+        stop_ = true;
+    }
+    task_submitted_.notify_all();
+    for (std::thread& worker : workers_) {
+        worker.join();
+    }
+}
+
+// The counters are increased before the task is visible to the other threads,
+// otherwise it may be stolen and finished before it is counted
+void ThreadPool::Submit(std::function<void()> task) {
+    const size_t queue = current_pool == this ? current_worker : next_queue_++ % queues_.size();
+    {
+        std::lock_guard<std::mutex> lock(state_mutex_);
+        ++pending_tasks_;
+        ++unfinished_tasks_;
+    }
+    {
+        std::lock_guard<std::mutex> lock(queues_[queue]->mutex);
+        queues_[queue]->tasks.push_back(std::move(task));
+    }
+    task_submitted_.notify_one();
+    // the waiting groups and the waiting pool share tasks_finished_, any of them may run the task
+    tasks_finished_.notify_all();
+}
+
+void ThreadPool::Wait() {
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(state_mutex_);
+            if (unfinished_tasks_ == 0) {
+                break;
+            }
+        }
+        if (RunPendingTask(GetCurrentQueue())) {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(state_mutex_);
+        tasks_finished_.wait(lock, [this] { return unfinished_tasks_ == 0 || pending_tasks_ > 0; });
+    }
+
+    std::exception_ptr exception;
+    {
+        std::lock_guard<std::mutex> lock(state_mutex_);
+        std::swap(exception, exception_);
+    }
+    if (exception) {
+        std::rethrow_exception(exception);
+    }
+}
+
+size_t ThreadPool::GetThreadsCount() const {
+    return workers_.size() + 1;
+}
+
+size_t ThreadPool::GetCurrentQueue() const {
+    return current_pool == this ? current_worker : queues_.size();
+}
+
+void ThreadPool::RunWorker(size_t worker) {
+    current_pool = this;
+    current_worker = worker;
+    while (true) {
+        if (RunPendingTask(worker)) {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(state_mutex_);
+        task_submitted_.wait(lock, [this] { return stop_ || pending_tasks_ > 0; });
+        if (stop_ && pending_tasks_ == 0) {
+            return;
+        }
+    }
+}
+
+bool ThreadPool::RunPendingTask(size_t worker) {
+    std::function<void()> task;
+    if (worker < queues_.size()) {
+        TaskQueue& own_queue = *queues_[worker];
+        std::lock_guard<std::mutex> lock(own_queue.mutex);
+        if (!own_queue.tasks.empty()) {
+            task = std::move(own_queue.tasks.back());
+            own_queue.tasks.pop_back();
+        }
+    }
+    for (size_t i = 0; !task && i < queues_.size(); ++i) {
+        TaskQueue& other_queue = *queues_[(worker + i) % queues_.size()];
+        std::lock_guard<std::mutex> lock(other_queue.mutex);
+        if (!other_queue.tasks.empty()) {
+            task = std::move(other_queue.tasks.front());
+            other_queue.tasks.pop_front();
+        }
+    }
+    if (!task) {
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(state_mutex_);
+        --pending_tasks_;
+    }
+    try {
+        task();
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(state_mutex_);
+        if (!exception_) {
+            exception_ = std::current_exception();
+        }
+    }
+    FinishTask();
+    return true;
+}
+
+void ThreadPool::FinishTask() {
+    bool all_finished = false;
+    {
+        std::lock_guard<std::mutex> lock(state_mutex_);
+        all_finished = --unfinished_tasks_ == 0;
+    }
+    if (all_finished) {
+        tasks_finished_.notify_all();
+    }
+}
+} // namespace khnum
@@ -0,0 +1,150 @@
+#include "catch/catch.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "compiled_model/compiled_model.h"
+#include "parser/open_flux_parser/open_flux_parser.h"
+#include "simulator/simulator.h"
+#include "../simulator_test/simulator_test_utilities.h"
+
+using namespace khnum;
+
+TEST_CASE("Compiled model", "[CompiledModel]") {
+    const std::string model_path = "../modelTca";
+    const std::string path = (std::filesystem::temp_directory_path() / "khnum_compiled_model_test.bin").string();
+
+    ParserOpenFlux parser(model_path);
+    const CompiledModel model = CompileModel(parser);
+    const std::uint64_t input_hash = HashModelFiles(model_path);
+    SaveCompiledModel(path, model, input_hash);
+
+    SECTION("loaded model simulates the same mids") {
+        std::optional<CompiledModel> loaded_model = LoadCompiledModel(path, input_hash);
+        REQUIRE(loaded_model);
+        REQUIRE(loaded_model->problem.nullspace == model.problem.nullspace);
+        REQUIRE(loaded_model->problem.lower_bounds == model.problem.lower_bounds);
+        REQUIRE(loaded_model->problem.upper_bounds == model.problem.upper_bounds);
+        REQUIRE(loaded_model->problem.reversible_reactions.size() == model.problem.reversible_reactions.size());
+
+        const Eigen::VectorXd free_fluxes = CreateFreeFluxes(model.problem);
+        SimulatorGenerator generator = CreateSimulatorGenerator(model);
+        Simulator simulator = generator.Generate();
+        const SimulatorResult result = simulator.CalculateMids(free_fluxes, true);
+
+        SimulatorGenerator loaded_generator = CreateSimulatorGenerator(*loaded_model);
+        Simulator loaded_simulator = loaded_generator.Generate();
+        const SimulatorResult& loaded_result = loaded_simulator.CalculateMids(free_fluxes, true);
+
+        REQUIRE(loaded_result.simulated_mids == result.simulated_mids);
+        REQUIRE(loaded_result.diff_results == result.diff_results);
+    }
+
+    SECTION("stale model isn't loaded") {
+        REQUIRE(!LoadCompiledModel(path, input_hash + 1));
+        REQUIRE(!LoadCompiledModel(path + ".missing", input_hash));
+    }
+
+    SECTION("truncated model throws") {
+        std::filesystem::resize_file(path, std::filesystem::file_size(path) / 2);
+        REQUIRE_THROWS_AS(LoadCompiledModel(path, input_hash), std::runtime_error);
+    }
+
+    SECTION("model with the indices out of the simulator buffers throws") {
+        const std::vector<std::function<void(CompiledModel&)>> corruptions = {
+            [](CompiledModel& model) { model.networks.front().saved_mids_offset = model.mid_arena_layout.size; },
+            [](CompiledModel& model) { model.networks.front().dependencies.push_back(0); },
+            [](CompiledModel& model) { model.networks.front().Y_data.front().offset = model.mid_arena_layout.size; },
+            [](CompiledModel& model) { ++model.networks.front().B_cols; },
+            [](CompiledModel& model) { model.networks.front().A_operator.cols.front() = model.networks.front().A_cols; }
+        };
+        for (size_t corruption = 0; corruption < corruptions.size(); ++corruption) {
+            INFO("corruption " << corruption);
+            CompiledModel corrupted_model = model;
+            corruptions[corruption](corrupted_model);
+            SaveCompiledModel(path, corrupted_model, input_hash);
+            REQUIRE_THROWS_AS(LoadCompiledModel(path, input_hash), std::runtime_error);
+        }
+    }
+
+    SECTION("run settings aren't saved") {
+        CompiledModel other_run = model;
+        RunSettings settings;
+        settings.total_starts = 7;
+        settings.multistart_threads = 3;
+        settings.big_network_solver = BigNetworkSolver::iterative;
+        settings.total_threads = 2;
+        ApplyRunSettings(settings, other_run);
+        SaveCompiledModel(path, other_run, input_hash);
+
+        std::optional<CompiledModel> loaded_model = LoadCompiledModel(path, input_hash);
+        REQUIRE(loaded_model);
+        REQUIRE(loaded_model->problem.total_starts == RunSettings().total_starts);
+        REQUIRE(loaded_model->problem.multistart_threads == RunSettings().multistart_threads);
+        REQUIRE(loaded_model->problem.simulator_parameters_.big_network_solver == RunSettings().big_network_solver);
+        REQUIRE(loaded_model->problem.simulator_parameters_.total_threads == RunSettings().total_threads);
+    }
+
+    SECTION("model is saved into the cache directory") {
+        const std::filesystem::path cache_directory =
+            std::filesystem::temp_directory_path() / "khnum_compiled_model_test_cache";
+        std::filesystem::remove_all(cache_directory);
+        const std::string compiled_model_path = GetCompiledModelPath(model_path, cache_directory.string());
+        REQUIRE(std::filesystem::path(compiled_model_path).parent_path() == cache_directory);
+        REQUIRE(compiled_model_path == GetCompiledModelPath(model_path + "/", cache_directory.string()));
+        REQUIRE(compiled_model_path != GetCompiledModelPath("../modelTiny", cache_directory.string()));
+
+        ParserOpenFlux cache_parser(model_path);
+        LoadOrCompileModel(cache_parser, model_path, cache_directory.string());
+        REQUIRE(LoadCompiledModel(compiled_model_path, input_hash));
+        REQUIRE(HashModelFiles(model_path) == input_hash);
+        std::filesystem::remove_all(cache_directory);
+    }
+
+    SECTION("model isn't saved into an unwritable directory") {
+        const std::filesystem::path cache_directory =
+            std::filesystem::temp_directory_path() / "khnum_compiled_model_test_cache";
+        std::filesystem::remove_all(cache_directory);
+        const std::string compiled_model_path = GetCompiledModelPath(model_path, cache_directory.string());
+        // the temporary file of the model can't be created in place of a directory
+        std::filesystem::create_directories(compiled_model_path + ".tmp");
+
+        RunSettings settings;
+        settings.total_starts = 7;
+        ParserOpenFlux cache_parser(model_path);
+        const CompiledModel compiled_model =
+            LoadOrCompileModel(cache_parser, model_path, cache_directory.string(), settings);
+        REQUIRE(compiled_model.problem.nullspace == model.problem.nullspace);
+        REQUIRE(compiled_model.problem.total_starts == 7);
+        REQUIRE(!std::filesystem::exists(compiled_model_path));
+        std::filesystem::remove_all(cache_directory);
+    }
+
+    SECTION("corrupted model is compiled again") {
+        const std::filesystem::path cache_directory =
+            std::filesystem::temp_directory_path() / "khnum_compiled_model_test_cache";
+        std::filesystem::remove_all(cache_directory);
+        std::filesystem::create_directories(cache_directory);
+        const std::string compiled_model_path = GetCompiledModelPath(model_path, cache_directory.string());
+        CompiledModel corrupted_model = model;
+        corrupted_model.networks.front().saved_mids_offset = corrupted_model.mid_arena_layout.size;
+        SaveCompiledModel(compiled_model_path, corrupted_model, input_hash);
+
+        ParserOpenFlux cache_parser(model_path);
+        const CompiledModel compiled_model = LoadOrCompileModel(cache_parser, model_path, cache_directory.string());
+        REQUIRE(compiled_model.networks.front().saved_mids_offset == model.networks.front().saved_mids_offset);
+        REQUIRE(LoadCompiledModel(compiled_model_path, input_hash));
+        std::filesystem::remove_all(cache_directory);
+    }
+
+    SECTION("hash depends only on the model files") {
+        REQUIRE(HashModelFiles(model_path) == input_hash);
+        REQUIRE(HashModelFiles("../modelTiny") != input_hash);
+    }
+
+    std::filesystem::remove(path);
+}
@@ -0,0 +1,118 @@
+#include "catch/catch.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "parser/maranas_parser.h"
+
+using namespace khnum;
+
+namespace {
+const Reaction& FindReaction(const std::vector<Reaction>& reactions, const std::string& name, ReactionType type) {
+    auto reaction = std::find_if(reactions.begin(), reactions.end(), [&name, type](const Reaction& reaction) {
+        return reaction.name == name && reaction.type == type;
+    });
+    REQUIRE(reaction != reactions.end());
+    return *reaction;
+}
+
+void WriteFile(const std::filesystem::path& path, const std::string& content) {
+    std::ofstream output(path);
+    output << content;
+}
+}
+
+TEST_CASE("Maranas parser on modelMaranas", "[MaranasParser]") {
+    ParserMaranas parser("../modelMaranas/");
+    parser.Parse();
+    const ParserResults results = parser.GetResults();
+
+    REQUIRE(results.reactions.size() == 950);
+    REQUIRE(results.measurements.size() == 18);
+
+    SECTION("reversible reaction is split") {
+        const Reaction& forward = FindReaction(results.reactions, "ALATA_L", ReactionType::Forward);
+        REQUIRE(forward.chemical_equation.left.size() == 2);
+        REQUIRE(forward.chemical_equation.left[0].name == "akg[c]");
+        REQUIRE(forward.chemical_equation.left[0].size == 5);
+        REQUIRE(forward.chemical_equation.right[1].name == "pyr[c]");
+        REQUIRE(forward.chemical_equation.right[1].size == 3);
+        REQUIRE(forward.chemical_equation.atom_transitions.size() == 8);
+
+        const Reaction& backward = FindReaction(results.reactions, "ALATA_L", ReactionType::Backward);
+        REQUIRE(backward.chemical_equation.left[0].name == "glu-L[c]");
+        REQUIRE(backward.chemical_equation.right[0].name == "akg[c]");
+        for (size_t i = 0; i < forward.chemical_equation.atom_transitions.size(); ++i) {
+            const AtomTransition& forward_transition = forward.chemical_equation.atom_transitions[i];
+            const AtomTransition& backward_transition = backward.chemical_equation.atom_transitions[i];
+            REQUIRE(forward_transition.substrate_pos == backward_transition.product_pos);
+            REQUIRE(forward_transition.substrate_atom == backward_transition.product_atom);
+        }
+    }
+
+    SECTION("flux only reaction keeps coefficients") {
+        const Reaction& flux = FindReaction(results.reactions, "PPA_flux", ReactionType::Irreversible);
+        REQUIRE(flux.chemical_equation.atom_transitions.empty());
+        REQUIRE(flux.chemical_equation.right[1].name == "pi[c]");
+        REQUIRE(flux.chemical_equation.right[1].substrate_coefficient_ == 2.0);
+        REQUIRE(flux.chemical_equation.right[1].size == 0);
+    }
+}
+
+TEST_CASE("Maranas parser on a small model", "[MaranasParser]") {
+    const std::filesystem::path path = std::filesystem::temp_directory_path() / "khnum_maranas_parser_test";
+    std::filesystem::create_directories(path);
+    WriteFile(path / "measurements.csv", "header\n");
+    WriteFile(path / "substrate_input.csv", "header\n");
+    WriteFile(path / "flux_model.csv", "PPA,\"inorganic diphosphatase, cytosol\",[c] : h2o + ppi --> h + 2 pi\n"
+                                       "OTHER,not used,[c] : a --> b\n");
+
+    SECTION("atoms and copies of metabolites") {
+        WriteFile(path / "model.csv", "maps,startNodeSymbol,metabAbbreviation,ReactantProductFlag,"
+                                      "OriginalEquation,rxnAbbreviation,source\n"
+                                      "\"1,2\",C,a[c],reactant,[c] : a + 2 h --> 2 b,R1,x\n"
+                                      "\"1\",C,b[c],product,[c] : a + 2 h --> 2 b,R1,x\n"
+                                      "\"2\",C,b[c],product,[c] : a + 2 h --> 2 b,R1,x\n");
+        ParserMaranas parser(path.string());
+        parser.Parse();
+        const ParserResults results = parser.GetResults();
+        REQUIRE(results.reactions.size() == 2);
+
+        const Reaction& reaction = FindReaction(results.reactions, "R1", ReactionType::Irreversible);
+        const ChemicalEquation& equation = reaction.chemical_equation;
+        REQUIRE(equation.left.size() == 2);
+        REQUIRE(equation.left[0].size == 2);
+        REQUIRE(equation.left[1].name == "h[c]");
+        REQUIRE(equation.left[1].size == 0);
+        REQUIRE(equation.left[1].substrate_coefficient_ == 2.0);
+        REQUIRE(equation.right.size() == 2);
+        REQUIRE(equation.right[1].id == 1);
+        REQUIRE(equation.right[1].substrate_coefficient_ == 1.0);
+
+        REQUIRE(equation.atom_transitions.size() == 2);
+        REQUIRE(equation.atom_transitions[0].product_pos == 0);
+        REQUIRE(equation.atom_transitions[1].substrate_atom == 1);
+        REQUIRE(equation.atom_transitions[1].product_pos == 1);
+        REQUIRE(equation.atom_transitions[1].product_atom == 0);
+    }
+
+    SECTION("atom without a pair") {
+        WriteFile(path / "model.csv", "header\n"
+                                      "\"1,2\",C,a[c],reactant,[c] : a --> b,R1,x\n"
+                                      "\"1,3\",C,b[c],product,[c] : a --> b,R1,x\n");
+        ParserMaranas parser(path.string());
+        REQUIRE_THROWS_AS(parser.Parse(), std::runtime_error);
+    }
+
+    SECTION("reaction without arrow") {
+        WriteFile(path / "model.csv", "header\n"
+                                      "\"1\",C,a[c],reactant,[c] : a = b,R1,x\n");
+        ParserMaranas parser(path.string());
+        REQUIRE_THROWS_AS(parser.Parse(), std::runtime_error);
+    }
+
+    std::filesystem::remove_all(path);
+}
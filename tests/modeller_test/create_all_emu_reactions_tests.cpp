@@ -1,5 +1,8 @@
 #include <modeller/calculate_input_mid.h>
 #include "catch/catch.hpp"
+
+#include <string>
+#include <vector>
 #include "modeller/modeller.h"
 
 #include "modeller/create_emu_reactions.h"
@@ -7,6 +10,39 @@
 using namespace khnum;
 using namespace khnum::modelling_utills;
 
+namespace {
+// Sets the sizes of the substrates and the atom transitions by the atom formulas in the same way as the OpenFlux parser:
+// each substrate atom goes to the atom denoted by the same letter in every product
+void SetAtomTransitions(const std::vector<std::string> &left_formulas,
+                        const std::vector<std::string> &right_formulas,
+                        ChemicalEquation *equation) {
+    for (size_t position = 0; position < left_formulas.size(); ++position) {
+        equation->left[position].id = position;
+        equation->left[position].size = left_formulas[position].size();
+    }
+    for (size_t position = 0; position < right_formulas.size(); ++position) {
+        equation->right[position].id = position;
+        equation->right[position].size = right_formulas[position].size();
+    }
+
+    equation->atom_transitions.clear();
+    for (size_t substrate_pos = 0; substrate_pos < left_formulas.size(); ++substrate_pos) {
+        const std::string &substrate = left_formulas[substrate_pos];
+        for (size_t substrate_atom = 0; substrate_atom < substrate.size(); ++substrate_atom) {
+            for (size_t product_pos = 0; product_pos < right_formulas.size(); ++product_pos) {
+                const size_t product_atom = right_formulas[product_pos].find(substrate[substrate_atom]);
+                if (product_atom != std::string::npos) {
+                    equation->atom_transitions.push_back({static_cast<int>(substrate_pos),
+                                                          static_cast<int>(product_pos),
+                                                          static_cast<int>(substrate_atom),
+                                                          static_cast<int>(product_atom)});
+                }
+            }
+        }
+    }
+}
+}
+
 
 TEST_CASE("CreateOneEmuReaction", "[Modelling Utils]") {
     SECTION("Complicated use") {
@@ -15,22 +51,18 @@ TEST_CASE("CreateOneEmuReaction", "[Modelling Utils]") {
         ChemicalEquation equation; // "A + 2.0 B = 1.5 C + D, ab + cd = bda + c"
         Substrate A;
         A.name = "A";
-        A.formula = "ab";
         A.substrate_coefficient_ = 1.0;
 
         Substrate B;
         B.name = "B";
-        B.formula = "cd";
         B.substrate_coefficient_ = 2.0;
 
         Substrate C;
         C.name = "C";
-        C.formula = "bda";
         C.substrate_coefficient_ = 1.5;
 
         Substrate D;
         D.name = "D";
-        D.formula = "c";
         D.substrate_coefficient_ = 1.0;
 
         equation.left.push_back(A);
@@ -38,13 +70,12 @@ TEST_CASE("CreateOneEmuReaction", "[Modelling Utils]") {
         equation.right.push_back(C);
         equation.right.push_back(D);
 
+        SetAtomTransitions({"ab", "cd"}, {"bda", "c"}, &equation);
         reaction.chemical_equation = equation;
 
-        Emu C110;
-        C110.name = "C";
-        C110.atom_states = {1, 1, 0};
+        Emu C110 = CreateEmu("C", {1, 1, 0});
 
-        EmuReaction result = CreateOneEmuReaction(reaction, C, C110);
+        EmuReaction result = CreateOneEmuReaction(reaction, reaction.chemical_equation.right[0], C110);
         EmuReaction should_be; // A:01 + 2.0 B:01 = 1.5 C:110
         should_be.id = reaction.id;
         should_be.right.emu = C110;
@@ -52,14 +83,12 @@ TEST_CASE("CreateOneEmuReaction", "[Modelling Utils]") {
 
         EmuSubstrate A01;
         A01.coefficient = 1.0;
-        A01.emu.name = "A";
-        A01.emu.atom_states = {0, 1};
+        A01.emu = CreateEmu("A", {0, 1});
         should_be.left.push_back(A01);
 
         EmuSubstrate B01;
         B01.coefficient = 2.0;
-        B01.emu.name = "B";
-        B01.emu.atom_states = {0, 1};
+        B01.emu = CreateEmu("B", {0, 1});
         should_be.left.push_back(B01);
 
         REQUIRE(result == should_be);
@@ -71,66 +100,56 @@ TEST_CASE("CreateOneEmuReaction", "[Modelling Utils]") {
         ChemicalEquation equation; // A + B + C + D = E + F, ab + cd + ef + g = abcdef + g
         Substrate A;
         A.name = "A";
-        A.formula = "ab";
         A.substrate_coefficient_ = 1.0;
         equation.left.push_back(A);
 
         Substrate B;
         B.name = "B";
-        B.formula = "cd";
         B.substrate_coefficient_ = 1.0;
         equation.left.push_back(B);
 
         Substrate C;
         C.name = "C";
-        C.formula = "ef";
         C.substrate_coefficient_ = 1.0;
         equation.left.push_back(C);
 
         Substrate D;
         D.name = "D";
-        D.formula = "g";
         D.substrate_coefficient_ = 1.0;
         equation.left.push_back(D);
 
         Substrate E;
         E.name = "E";
-        E.formula = "abcdef";
         E.substrate_coefficient_ = 1.0;
         equation.right.push_back(E);
 
         Substrate F;
         F.name = "F";
-        F.formula = "g";
         F.substrate_coefficient_ = 1.0;
         equation.right.push_back(F);
 
+        SetAtomTransitions({"ab", "cd", "ef", "g"}, {"abcdef", "g"}, &equation);
         reaction.chemical_equation = equation;
 
-        Emu E100101;
-        E100101.name = "E";
-        E100101.atom_states = {1, 0, 0, 1, 0, 1};
+        Emu E100101 = CreateEmu("E", {1, 0, 0, 1, 0, 1});
 
-        EmuReaction result = CreateOneEmuReaction(reaction, E, E100101);
+        EmuReaction result = CreateOneEmuReaction(reaction, reaction.chemical_equation.right[0], E100101);
         EmuReaction should_be;
         should_be.id = 228;
 
         EmuSubstrate A10;
         A10.coefficient = 1.0;
-        A10.emu.name = "A";
-        A10.emu.atom_states = {1, 0};
+        A10.emu = CreateEmu("A", {1, 0});
         should_be.left.push_back(A10);
 
         EmuSubstrate B01;
         B01.coefficient = 1.0;
-        B01.emu.name = "B";
-        B01.emu.atom_states = {0, 1};
+        B01.emu = CreateEmu("B", {0, 1});
         should_be.left.push_back(B01);
 
         EmuSubstrate C01;
         C01.coefficient = 1.0;
-        C01.emu.name = "C";
-        C01.emu.atom_states = {0, 1};
+        C01.emu = CreateEmu("C", {0, 1});
         should_be.left.push_back(C01);
 
         should_be.right.coefficient = 1.0;
@@ -148,57 +167,43 @@ TEST_CASE("CreateNewEmuReactions()", "[Modelling Utils]") {
         Substrate Fum_first;
         Fum_first.substrate_coefficient_ = 0.5;
         Fum_first.name = "Fum";
-        Fum_first.formula = "abcd";
         equation.left.push_back(Fum_first);
 
         Substrate Fum_second;
         Fum_second.substrate_coefficient_ = 0.5;
         Fum_second.name = "Fum";
-        Fum_second.formula = "dcba";
         equation.left.push_back(Fum_second);
 
         Substrate OAC;
         OAC.substrate_coefficient_ = 1.0;
         OAC.name = "OAC";
-        OAC.formula = "abcd";
         equation.right.push_back(OAC);
+        SetAtomTransitions({"abcd", "dcba"}, {"abcd"}, &equation);
         reaction.chemical_equation = equation;
 
-        Emu OAC1100;
-        OAC1100.name = "OAC";
-        OAC1100.atom_states = {1, 1, 0, 0};
+        Emu OAC1100 = CreateEmu("OAC", {1, 1, 0, 0});
 
+        // the atoms of the product come from both precursors, so it is a convolution of their emus
         std::vector<EmuReaction> result = CreateNewEmuReactions(reaction, OAC1100);
-        REQUIRE(result.size() == 2);
+        REQUIRE(result.size() == 1);
 
-        EmuReaction should_be_first;
-        should_be_first.id = 1337;
+        EmuReaction should_be; // 0.5 Fum:1100 + 0.5 Fum:0011 = OAC:1100
+        should_be.id = 1337;
 
         EmuSubstrate Fum1100;
         Fum1100.coefficient = 0.5;
-        Fum1100.emu.name = "Fum";
-        Fum1100.emu.atom_states = {1, 1, 0, 0};
-        should_be_first.left.push_back(Fum1100);
-
-        should_be_first.right.emu = OAC1100;
-        should_be_first.right.coefficient = 1.0;
-
-        bool is_first_ok = (result[0] == should_be_first) || (result[1] == should_be_first);
-
-        EmuReaction should_be_second;
-        should_be_second.id = 1337;
+        Fum1100.emu = CreateEmu("Fum", {1, 1, 0, 0});
+        should_be.left.push_back(Fum1100);
 
         EmuSubstrate Fum0011;
         Fum0011.coefficient = 0.5;
-        Fum0011.emu.name = "Fum";
-        Fum0011.emu.atom_states = {0, 0, 1, 1};
-        should_be_second.left.push_back(Fum0011);
+        Fum0011.emu = CreateEmu("Fum", {0, 0, 1, 1});
+        should_be.left.push_back(Fum0011);
 
-        should_be_first.right.emu = OAC1100;
-        should_be_first.right.coefficient = 1.0;
+        should_be.right.emu = OAC1100;
+        should_be.right.coefficient = 1.0;
 
-        bool is_second_ok = (result[0] == should_be_second) || (result[1] == should_be_second);
-        REQUIRE( (is_first_ok && is_second_ok) );
+        REQUIRE(result.front() == should_be);
     }
 
     SECTION("Left symmetry second") {
@@ -208,37 +213,33 @@ TEST_CASE("CreateNewEmuReactions()", "[Modelling Utils]") {
         Substrate Fum_first;
         Fum_first.substrate_coefficient_ = 0.5;
         Fum_first.name = "Fum";
-        Fum_first.formula = "abcd";
         equation.left.push_back(Fum_first);
 
         Substrate Fum_second;
         Fum_second.substrate_coefficient_ = 0.5;
         Fum_second.name = "Fum";
-        Fum_second.formula = "dcba";
         equation.left.push_back(Fum_second);
 
         Substrate OAC;
         OAC.substrate_coefficient_ = 1.0;
         OAC.name = "OAC";
-        OAC.formula = "abcd";
         equation.right.push_back(OAC);
+        SetAtomTransitions({"abcd", "dcba"}, {"abcd"}, &equation);
         reaction.chemical_equation = equation;
 
-        Emu OAC1001;
-        OAC1001.name = "OAC";
-        OAC1001.atom_states = {1, 0, 0, 1};
+        Emu OAC1001 = CreateEmu("OAC", {1, 0, 0, 1});
 
         std::vector<EmuReaction> result = CreateNewEmuReactions(reaction, OAC1001);
         REQUIRE(result.size() == 1);
         EmuReaction reaction_result = result.front();
 
-        EmuReaction should_be;
+        EmuReaction should_be; // 0.5 Fum:1001 + 0.5 Fum:1001 = OAC:1001
         should_be.id = 1337;
 
         EmuSubstrate Fum1001;
-        Fum1001.coefficient = 1.0;
-        Fum1001.emu.name = "Fum";
-        Fum1001.emu.atom_states = {1, 0, 0, 1};
+        Fum1001.coefficient = 0.5;
+        Fum1001.emu = CreateEmu("Fum", {1, 0, 0, 1});
+        should_be.left.push_back(Fum1001);
         should_be.left.push_back(Fum1001);
 
         should_be.right.emu = OAC1001;
@@ -255,25 +256,21 @@ TEST_CASE("CreateNewEmuReactions()", "[Modelling Utils]") {
         Substrate OAC;
         OAC.substrate_coefficient_ = 1.0;
         OAC.name = "OAC";
-        OAC.formula = "abcd";
         equation.left.push_back(OAC);
 
         Substrate Fum_first;
         Fum_first.substrate_coefficient_ = 0.5;
         Fum_first.name = "Fum";
-        Fum_first.formula = "abcd";
         equation.right.push_back(Fum_first);
 
         Substrate Fum_second;
         Fum_second.substrate_coefficient_ = 0.5;
         Fum_second.name = "Fum";
-        Fum_second.formula = "dcba";
         equation.right.push_back(Fum_second);
+        SetAtomTransitions({"abcd"}, {"abcd", "dcba"}, &equation);
         reaction.chemical_equation = equation;
 
-        Emu Fum1100;
-        Fum1100.name = "Fum";
-        Fum1100.atom_states = {1, 1, 0, 0};
+        Emu Fum1100 = CreateEmu("Fum", {1, 1, 0, 0});
 
         std::vector<EmuReaction> result = CreateNewEmuReactions(reaction, Fum1100);
         REQUIRE(result.size() == 2);
@@ -283,8 +280,7 @@ TEST_CASE("CreateNewEmuReactions()", "[Modelling Utils]") {
 
         EmuSubstrate OAC1100;
         OAC1100.coefficient = 1.0;
-        OAC1100.emu.name = "OAC";
-        OAC1100.emu.atom_states = {1, 1, 0, 0};
+        OAC1100.emu = CreateEmu("OAC", {1, 1, 0, 0});
 
         should_be_first.left.push_back(OAC1100);
 
@@ -298,8 +294,7 @@ TEST_CASE("CreateNewEmuReactions()", "[Modelling Utils]") {
 
         EmuSubstrate OAC0011;
         OAC0011.coefficient = 1.0;
-        OAC0011.emu.name = "OAC";
-        OAC0011.emu.atom_states = {0, 0, 1, 1};
+        OAC0011.emu = CreateEmu("OAC", {0, 0, 1, 1});
 
         should_be_second.left.push_back(OAC0011);
 
@@ -319,43 +314,40 @@ TEST_CASE("CreateNewEmuReactions()", "[Modelling Utils]") {
         Substrate OAC;
         OAC.substrate_coefficient_ = 1.0;
         OAC.name = "OAC";
-        OAC.formula = "abcd";
         equation.left.push_back(OAC);
 
         Substrate Fum_first;
         Fum_first.substrate_coefficient_ = 0.5;
         Fum_first.name = "Fum";
-        Fum_first.formula = "abcd";
         equation.right.push_back(Fum_first);
 
         Substrate Fum_second;
         Fum_second.substrate_coefficient_ = 0.5;
         Fum_second.name = "Fum";
-        Fum_second.formula = "dcba";
         equation.right.push_back(Fum_second);
+        SetAtomTransitions({"abcd"}, {"abcd", "dcba"}, &equation);
         reaction.chemical_equation = equation;
 
-        Emu Fum1001;
-        Fum1001.name = "Fum";
-        Fum1001.atom_states = {1, 0, 0, 1};
+        Emu Fum1001 = CreateEmu("Fum", {1, 0, 0, 1});
 
         std::vector<EmuReaction> result = CreateNewEmuReactions(reaction, Fum1001);
         REQUIRE(result.size() == 1);
 
-        EmuReaction should_be; // OAC1001 = Fum1001
+        // both occurrences of the product give the same emu reaction, so their rates are summed
+        EmuReaction should_be; // OAC1001 = 0.5 Fum1001
         should_be.id = 666;
 
         EmuSubstrate OAC1001;
         OAC1001.coefficient = 1.0;
-        OAC1001.emu.name = "OAC";
-        OAC1001.emu.atom_states = {1, 0, 0, 1};
+        OAC1001.emu = CreateEmu("OAC", {1, 0, 0, 1});
 
         should_be.left.push_back(OAC1001);
 
-        should_be.right.coefficient = 1.0;
+        should_be.right.coefficient = 0.5;
         should_be.right.emu = Fum1001;
 
         REQUIRE(result.front() == should_be);
+        REQUIRE(result.front().rate == Approx(1.0));
     }
 
     SECTION("Symmetry first") {
@@ -366,61 +358,59 @@ TEST_CASE("CreateNewEmuReactions()", "[Modelling Utils]") {
         Substrate Suc_first;
         Suc_first.substrate_coefficient_ = 0.5;
         Suc_first.name = "Suc";
-        Suc_first.formula = "abcd";
         equation.left.push_back(Suc_first);
 
         Substrate Suc_second;
         Suc_second.substrate_coefficient_ = 0.5;
         Suc_second.name = "Suc";
-        Suc_second.formula = "dcba";
         equation.left.push_back(Suc_second);
 
         Substrate Fum_first;
         Fum_first.substrate_coefficient_ = 0.5;
         Fum_first.name = "Fum";
-        Fum_first.formula = "abcd";
         equation.right.push_back(Fum_first);
 
         Substrate Fum_second;
         Fum_second.substrate_coefficient_ = 0.5;
         Fum_second.name = "Fum";
-        Fum_second.formula = "dcba";
         equation.right.push_back(Fum_second);
 
-        Emu Fum1100;
-        Fum1100.name = "Fum";
-        Fum1100.atom_states = {1, 1, 0, 0};
+        SetAtomTransitions({"abcd", "dcba"}, {"abcd", "dcba"}, &equation);
+        reaction.chemical_equation = equation;
+
+        Emu Fum1100 = CreateEmu("Fum", {1, 1, 0, 0});
 
+        // every occurrence of the product is a convolution of both precursors
         std::vector<EmuReaction> result = CreateNewEmuReactions(reaction, Fum1100);
-        // 1.0 Suc1100 = 1.0 Fum1100
-        // 1.0 Suc0011 = 1.0 Fum1100
+        // 0.5 Suc1100 + 0.5 Suc0011 = 0.5 Fum1100
+        // 0.5 Suc0011 + 0.5 Suc1100 = 0.5 Fum1100
 
         REQUIRE(result.size() == 2);
 
+        EmuSubstrate Suc1100;
+        Suc1100.coefficient = 0.5;
+        Suc1100.emu = CreateEmu("Suc", {1, 1, 0, 0});
+
+        EmuSubstrate Suc0011;
+        Suc0011.coefficient = 0.5;
+        Suc0011.emu = CreateEmu("Suc", {0, 0, 1, 1});
+
         EmuReaction should_be_first;
         should_be_first.id = 1337;
-
-        EmuSubstrate Suc1100;
-        Suc1100.coefficient = 1.0;
-        Suc1100.emu.name = "Suc";
-        Suc1100.emu.atom_states = {1, 1, 0, 0};
         should_be_first.left.push_back(Suc1100);
+        should_be_first.left.push_back(Suc0011);
 
-        should_be_first.right.coefficient = 1.0;
+        should_be_first.right.coefficient = 0.5;
         should_be_first.right.emu = Fum1100;
 
         bool is_first_ok = (result[0] == should_be_first) || (result[1] == should_be_first);
 
         EmuReaction should_be_second;
         should_be_second.id = 1337;
-
-        EmuSubstrate Suc0011;
-        Suc0011.coefficient = 1.0;
-        Suc0011.emu.name = "Suc";
-        Suc0011.emu.atom_states = {0, 0, 1, 1};
         should_be_second.left.push_back(Suc0011);
+        should_be_second.left.push_back(Suc1100);
 
-        should_be_second.right.coefficient = 1.0;
+        should_be_second.right.coefficient = 0.5;
         should_be_second.right.emu = Fum1100;
 
         bool is_second_ok = (result[0] == should_be_second) || (result[1] == should_be_second);
@@ -436,48 +426,46 @@ TEST_CASE("CreateNewEmuReactions()", "[Modelling Utils]") {
         Substrate Suc_first;
         Suc_first.substrate_coefficient_ = 0.5;
         Suc_first.name = "Suc";
-        Suc_first.formula = "abcd";
         equation.left.push_back(Suc_first);
 
         Substrate Suc_second;
         Suc_second.substrate_coefficient_ = 0.5;
         Suc_second.name = "Suc";
-        Suc_second.formula = "dcba";
         equation.left.push_back(Suc_second);
 
         Substrate Fum_first;
         Fum_first.substrate_coefficient_ = 0.5;
         Fum_first.name = "Fum";
-        Fum_first.formula = "abcd";
         equation.right.push_back(Fum_first);
 
         Substrate Fum_second;
         Fum_second.substrate_coefficient_ = 0.5;
         Fum_second.name = "Fum";
-        Fum_second.formula = "dcba";
         equation.right.push_back(Fum_second);
 
-        Emu Fum1001;
-        Fum1001.name = "Fum";
-        Fum1001.atom_states = {1, 0, 0, 1};
+        SetAtomTransitions({"abcd", "dcba"}, {"abcd", "dcba"}, &equation);
+        reaction.chemical_equation = equation;
+
+        Emu Fum1001 = CreateEmu("Fum", {1, 0, 0, 1});
 
         std::vector<EmuReaction> result = CreateNewEmuReactions(reaction, Fum1001);
 
-        // 2.0 Suc1001 = 1.0 Fum1001
+        // 0.5 Suc1001 + 0.5 Suc1001 = 0.5 Fum1001 from both occurrences of the product
         REQUIRE(result.size() == 1);
 
         EmuReaction should_be;
         should_be.id = 1337;
 
         EmuSubstrate Suc1001;
-        Suc1001.coefficient = 2.0;
-        Suc1001.emu.name = "Suc";
-        Suc1001.emu.atom_states = {1, 0, 0, 1};
+        Suc1001.coefficient = 0.5;
+        Suc1001.emu = CreateEmu("Suc", {1, 0, 0, 1});
+        should_be.left.push_back(Suc1001);
         should_be.left.push_back(Suc1001);
 
-        should_be.right.coefficient = 1.0;
+        should_be.right.coefficient = 0.5;
         should_be.right.emu = Fum1001;
 
         REQUIRE(result.front() == should_be);
+        REQUIRE(result.front().rate == Approx(1.0));
     }
 }
\ No newline at end of file
@@ -0,0 +1,69 @@
+#include "catch/catch.hpp"
+
+#include <limits>
+#include <vector>
+
+#include "modeller/calculate_flux_bounds.h"
+
+using namespace khnum;
+using namespace khnum::modelling_utills;
+
+namespace {
+Reaction CreateReaction(int id, double basis = std::numeric_limits<double>::quiet_NaN()) {
+    Reaction reaction;
+    reaction.id = id;
+    reaction.basis = basis;
+    reaction.deviation = std::numeric_limits<double>::quiet_NaN();
+    reaction.is_set_free = false;
+    return reaction;
+}
+}
+
+TEST_CASE("Flux variability analysis", "[FluxBounds]") {
+    // v0 -> A, A -> B by v1 and v2, A -> C by v3, B -> by v4
+    Matrix dense_stoichiometry_matrix(2, 5);
+    dense_stoichiometry_matrix << 1, -1, -1, -1, 0,
+                                  0, 1, 1, 0, -1;
+    const SparseMatrix stoichiometry_matrix = dense_stoichiometry_matrix.sparseView();
+
+    SECTION("bounds are narrowed by the stoichiometry") {
+        std::vector<Reaction> reactions = {CreateReaction(0, 10.0), CreateReaction(1), CreateReaction(2),
+                                           CreateReaction(3), CreateReaction(4)};
+        reactions[4].setted_upper_bound = 4.0;
+
+        CalculateFluxBounds(reactions, stoichiometry_matrix);
+
+        REQUIRE(reactions[0].computed_lower_bound == 10.0);
+        REQUIRE(reactions[0].computed_upper_bound == 10.0);
+        REQUIRE(reactions[1].computed_lower_bound == 0.001);
+        REQUIRE(reactions[1].computed_upper_bound == Approx(4.0));
+        REQUIRE(reactions[3].computed_lower_bound == Approx(6.0));
+        REQUIRE(reactions[3].computed_upper_bound == Approx(10.0));
+        REQUIRE(reactions[4].computed_upper_bound == Approx(4.0));
+    }
+
+    SECTION("threads don't change the bounds") {
+        std::vector<Reaction> reactions = {CreateReaction(0, 10.0), CreateReaction(1), CreateReaction(2),
+                                           CreateReaction(3), CreateReaction(4)};
+        std::vector<Reaction> parallel_reactions = reactions;
+
+        CalculateFluxBounds(reactions, stoichiometry_matrix, 1);
+        CalculateFluxBounds(parallel_reactions, stoichiometry_matrix, 3);
+
+        for (size_t i = 0; i < reactions.size(); ++i) {
+            REQUIRE(parallel_reactions[i].computed_lower_bound == reactions[i].computed_lower_bound);
+            REQUIRE(parallel_reactions[i].computed_upper_bound == reactions[i].computed_upper_bound);
+        }
+    }
+
+    SECTION("infeasible problem keeps the default bounds") {
+        std::vector<Reaction> reactions = {CreateReaction(0, 500.0), CreateReaction(1), CreateReaction(2),
+                                           CreateReaction(3), CreateReaction(4)};
+
+        CalculateFluxBounds(reactions, stoichiometry_matrix, 2);
+
+        REQUIRE(reactions[0].computed_lower_bound == 500.0);
+        REQUIRE(reactions[1].computed_lower_bound == 0.001);
+        REQUIRE(reactions[1].computed_upper_bound == 125);
+    }
+}
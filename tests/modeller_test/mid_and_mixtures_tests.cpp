@@ -16,9 +16,7 @@ TEST_CASE("CalculateOneMid()", "[Modelling Utils]") {
         input_substrate.name = "my_emu";
         input_substrate.mixtures.push_back(mix);
 
-        Emu emu;
-        emu.name = "my_emu";
-        emu.atom_states = {1, 1};
+        Emu emu = CreateEmu("my_emu", {1, 1});
 
         auto result = CalculateOneMid(input_substrate, emu);
         Mid should_be = {0.63, 0.34, 0.03};
@@ -42,9 +40,7 @@ TEST_CASE("CalculateOneMid()", "[Modelling Utils]") {
         input_substrate.mixtures.push_back(mix);
         input_substrate.mixtures.push_back(second_mix);
 
-        Emu emu;
-        emu.name = "my_emu";
-        emu.atom_states = {0, 1};
+        Emu emu = CreateEmu("my_emu", {0, 1});
 
         auto result = CalculateOneMid(input_substrate, emu);
         Mid should_be = {0.83, 0.16};
@@ -0,0 +1,61 @@
+#include "catch/catch.hpp"
+
+#include <string>
+#include <vector>
+
+#include "modeller/create_network_components.h"
+
+using namespace khnum;
+using namespace khnum::modelling_utills;
+
+namespace {
+EmuReaction CreateReaction(int id, const std::vector<std::string>& precursors, const std::string& product) {
+    EmuReaction reaction;
+    reaction.id = id;
+    for (const std::string& precursor : precursors) {
+        reaction.left.push_back({CreateEmu(precursor, {1}), 1.0});
+    }
+    reaction.right = {CreateEmu(product, {1}), 1.0};
+    reaction.rate = 1.0;
+    return reaction;
+}
+
+std::vector<int> GetIds(const EmuNetwork& network) {
+    std::vector<int> ids;
+    for (const EmuReaction& reaction : network) {
+        ids.push_back(reaction.id);
+    }
+    return ids;
+}
+}
+
+TEST_CASE("CreateNetworkComponents()", "[Modelling Utils]") {
+    SECTION("components in topological order") {
+        // D = C, C = B, B = C, A = B, E + F = G, G = D
+        const EmuNetwork network = {CreateReaction(0, {"D"}, "C"), CreateReaction(1, {"C"}, "B"),
+                                    CreateReaction(2, {"B"}, "C"), CreateReaction(3, {"A"}, "B"),
+                                    CreateReaction(4, {"E", "F"}, "G"), CreateReaction(5, {"G"}, "D")};
+        const NetworkComponents result = CreateNetworkComponents(network);
+
+        REQUIRE(result.components.size() == 3);
+        REQUIRE(GetIds(result.components[0]) == std::vector<int>{4});
+        REQUIRE(GetIds(result.components[1]) == std::vector<int>{5});
+        REQUIRE(GetIds(result.components[2]) == std::vector<int>{0, 1, 2, 3});
+        REQUIRE(result.dependencies == std::vector<std::vector<int>>{{}, {0}, {1}});
+    }
+
+    SECTION("long chain") {
+        const int total_reactions = 200000;
+        EmuNetwork network;
+        for (int reaction = total_reactions - 1; reaction >= 0; --reaction) {
+            network.push_back(CreateReaction(reaction, {"M" + std::to_string(reaction)},
+                                             "M" + std::to_string(reaction + 1)));
+        }
+        const NetworkComponents result = CreateNetworkComponents(network);
+
+        REQUIRE(result.components.size() == total_reactions);
+        REQUIRE(result.components.front()[0].id == 0);
+        REQUIRE(result.components.back()[0].id == total_reactions - 1);
+        REQUIRE(result.dependencies.back() == std::vector<int>{total_reactions - 2});
+    }
+}
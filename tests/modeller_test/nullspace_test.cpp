@@ -0,0 +1,88 @@
+#include "catch/catch.hpp"
+
+#include <string>
+#include <vector>
+
+#include "modeller/create_nullspace.h"
+
+using namespace khnum;
+using namespace khnum::modelling_utills;
+
+namespace {
+// The first reaction is a metabolite balance one, it has no column in the matrix
+std::vector<Reaction> CreateReactions(int total) {
+    std::vector<Reaction> reactions(total + 1);
+    for (int i = 0; i <= total; ++i) {
+        reactions[i].id = i;
+        reactions[i].name = "v" + std::to_string(i);
+    }
+    return reactions;
+}
+
+// S * v = 0 for v = (-A * free, free) in the new order of the reactions
+void CheckNullspace(const Matrix& stoichiometry_matrix, const std::vector<Reaction>& reactions,
+                    const Matrix& nullspace) {
+    Matrix ordered_matrix(stoichiometry_matrix.rows(), stoichiometry_matrix.cols());
+    for (int column = 0; column < stoichiometry_matrix.cols(); ++column) {
+        ordered_matrix.col(column) = stoichiometry_matrix.col(reactions[column + 1].id - 1);
+    }
+    const Eigen::VectorXd free_fluxes = Eigen::VectorXd::LinSpaced(nullspace.cols(), 1.0, 2.0);
+    Eigen::VectorXd fluxes(stoichiometry_matrix.cols());
+    fluxes << -nullspace * free_fluxes, free_fluxes;
+    REQUIRE((ordered_matrix * fluxes).norm() < 1e-12);
+}
+}
+
+TEST_CASE("Nullspace of stoichiometry matrix", "[Nullspace]") {
+    SECTION("dependent column is exchanged with the first free one") {
+        Matrix stoichiometry_matrix(2, 4);
+        stoichiometry_matrix << 1, 2, 0, 1,
+                                0, 0, 1, 1;
+        std::vector<Reaction> reactions = CreateReactions(4);
+
+        const Matrix nullspace = GetNullspace(stoichiometry_matrix.sparseView(), reactions);
+
+        REQUIRE(reactions[0].name == "v0");
+        REQUIRE(reactions[1].name == "v1");
+        REQUIRE(reactions[2].name == "v3");
+        REQUIRE(reactions[3].name == "v2");
+        REQUIRE(reactions[4].name == "v4");
+        Matrix expected(2, 2);
+        expected << 2, 1,
+                    0, 1;
+        REQUIRE(nullspace.isApprox(expected));
+        CheckNullspace(stoichiometry_matrix, reactions, nullspace);
+    }
+
+    SECTION("redundant balances are dropped") {
+        Matrix stoichiometry_matrix(3, 5);
+        stoichiometry_matrix << 1, -1, 0, 0, 1,
+                                0, 1, -1, 0, 0,
+                                1, 0, -1, 0, 1;
+        std::vector<Reaction> reactions = CreateReactions(5);
+
+        const Matrix nullspace = GetNullspace(stoichiometry_matrix.sparseView(), reactions);
+
+        REQUIRE(nullspace.rows() == 2);
+        REQUIRE(nullspace.cols() == 3);
+        REQUIRE(reactions[1].name == "v1");
+        REQUIRE(reactions[2].name == "v2");
+        CheckNullspace(stoichiometry_matrix, reactions, nullspace);
+    }
+
+    SECTION("full rank matrix keeps the order") {
+        Matrix stoichiometry_matrix(3, 6);
+        stoichiometry_matrix << 2, 0, 1, 1, 0, -1,
+                                1, 3, 0, 0, 1, 0,
+                                0, 1, 4, -1, 1, 1;
+        std::vector<Reaction> reactions = CreateReactions(6);
+
+        const Matrix nullspace = GetNullspace(stoichiometry_matrix.sparseView(), reactions);
+
+        for (int i = 0; i <= 6; ++i) {
+            REQUIRE(reactions[i].id == i);
+        }
+        const Matrix dependent = stoichiometry_matrix.leftCols(3);
+        REQUIRE(nullspace.isApprox(dependent.inverse() * stoichiometry_matrix.rightCols(3)));
+    }
+}
@@ -0,0 +1,35 @@
+#include "catch/catch.hpp"
+
+#include <vector>
+
+#include "modeller/reversible_reactions.h"
+
+using namespace khnum;
+using namespace khnum::modelling_utills;
+
+namespace {
+Reaction CreateReaction(int id, ReactionType type, const ChemicalEquationSide& left, const ChemicalEquationSide& right) {
+    Reaction reaction;
+    reaction.id = id;
+    reaction.type = type;
+    reaction.chemical_equation = {left, right, {}};
+    return reaction;
+}
+}
+
+TEST_CASE("Reversible reactions", "[Modelling Utils]") {
+    // SUC = OAA, OAA = 0.5 SUC + 0.5 SUC, A = B, B = A
+    const std::vector<Reaction> reactions = {
+        CreateReaction(3, ReactionType::Backward, {{4, 0, "B", 1.0}}, {{4, 0, "A", 1.0}}),
+        CreateReaction(0, ReactionType::Forward, {{4, 0, "SUC", 1.0}}, {{4, 0, "OAA", 1.0}}),
+        CreateReaction(1, ReactionType::Backward, {{4, 0, "OAA", 1.0}}, {{4, 0, "SUC", 0.5}, {4, 1, "SUC", 0.5}}),
+        CreateReaction(2, ReactionType::Forward, {{4, 0, "A", 1.0}}, {{4, 0, "B", 1.0}}),
+        CreateReaction(4, ReactionType::Irreversible, {{4, 0, "A", 1.0}}, {{4, 0, "B", 1.0}})};
+
+    const std::vector<ReversibleReaction> result = FindReversibleReactions(reactions);
+    REQUIRE(result.size() == 2);
+    REQUIRE(result[0].forward == 3);
+    REQUIRE(result[0].backward == 0);
+    REQUIRE(result[1].forward == 1);
+    REQUIRE(result[1].backward == 2);
+}
@@ -0,0 +1,67 @@
+#include "catch/catch.hpp"
+
+#include <vector>
+
+#include "modeller/create_emu_reactions.h"
+
+using namespace khnum;
+using namespace khnum::modelling_utills;
+
+namespace {
+Reaction CreateReaction(int id, const ChemicalEquationSide& left, const ChemicalEquationSide& right,
+                        const std::vector<AtomTransition>& atom_transitions) {
+    Reaction reaction;
+    reaction.id = id;
+    reaction.type = ReactionType::Irreversible;
+    reaction.chemical_equation = {left, right, atom_transitions};
+    return reaction;
+}
+
+EmuSubstrate CreateEmuSubstrate(const std::string& name, const AtomStates& atom_states, double coefficient) {
+    return {CreateEmu(name, atom_states), coefficient};
+}
+}
+
+TEST_CASE("Synthesis index", "[Modelling Utils]") {
+    // A = B: abc -> cba, B + D = C: abc + d -> abcd
+    const std::vector<Reaction> reactions = {
+        CreateReaction(0, {{3, 0, "A", 1.0}}, {{3, 0, "B", 1.0}}, {{0, 0, 0, 2}, {0, 0, 1, 1}, {0, 0, 2, 0}}),
+        CreateReaction(1, {{3, 0, "B", 1.0}, {1, 1, "D", 1.0}}, {{4, 0, "C", 1.0}},
+                       {{0, 0, 0, 0}, {0, 0, 1, 1}, {0, 0, 2, 2}, {1, 0, 0, 3}})};
+
+    SECTION("groups the transitions by the product atoms") {
+        const SynthesisIndex index = CreateSynthesisIndex(reactions);
+        const std::vector<SynthesisReaction>& synthesis_reactions = index.at(GetMetaboliteId("C"));
+        REQUIRE(synthesis_reactions.size() == 1);
+        REQUIRE(synthesis_reactions[0].reaction == &reactions[1]);
+        REQUIRE(synthesis_reactions[0].precursors == std::vector<int>{GetMetaboliteId("B"), GetMetaboliteId("D")});
+
+        const ProductTransitions& product = synthesis_reactions[0].products.at(0);
+        REQUIRE(product.atom_offsets == std::vector<size_t>{0, 1, 2, 3, 4});
+        REQUIRE(product.transitions[3].substrate_pos == 1);
+        REQUIRE(index.count(GetMetaboliteId("A")) == 0);
+    }
+
+    SECTION("creates the emu reactions in the bfs order") {
+        const std::vector<EmuReaction> result = CreateAllEmuReactions(reactions, {CreateEmu("C", {1, 0, 0, 1})});
+        REQUIRE(result.size() == 2);
+
+        EmuReaction first{1, {CreateEmuSubstrate("B", {1, 0, 0}, 1.0), CreateEmuSubstrate("D", {1}, 1.0)},
+                          CreateEmuSubstrate("C", {1, 0, 0, 1}, 1.0), 1.0};
+        EmuReaction second{0, {CreateEmuSubstrate("A", {0, 0, 1}, 1.0)},
+                           CreateEmuSubstrate("B", {1, 0, 0}, 1.0), 1.0};
+        REQUIRE(result[0] == first);
+        REQUIRE(result[1] == second);
+    }
+
+    SECTION("merges the equal emu reactions") {
+        EmuReaction reaction{2, {CreateEmuSubstrate("A", {1, 0, 0}, 0.5)}, CreateEmuSubstrate("B", {1, 0, 0}, 1.0), 0.5};
+        EmuReaction other_reaction = reaction;
+        other_reaction.left[0].emu = CreateEmu("A", {0, 0, 1});
+
+        const std::vector<EmuReaction> result = SelectUniqueEmuReactions({reaction, other_reaction, reaction});
+        REQUIRE(result.size() == 2);
+        REQUIRE(result[0].rate == Approx(1.0));
+        REQUIRE(result[1].rate == Approx(0.5));
+    }
+}
@@ -46,16 +46,16 @@ TEST_CASE("GetLines()", "[OpenFluxParser]") {
 TEST_CASE("ParseMeasuredIsotopes()", "[OpenFluxParser]") {
     SECTION("with normal file") {
         std::vector<Emu> result = ParseMeasuredIsotopes({"Emu1:111", "OtherEmu2:1"});
-        REQUIRE(result[0].name == "Emu1");
-        REQUIRE(result[0].atom_states.size() == 3);
+        REQUIRE(GetMetaboliteName(result[0].metabolite) == "Emu1");
+        REQUIRE(result[0].total_atoms == 3);
         for (size_t i = 0; i < 3; ++i) {
-            REQUIRE(result[0].atom_states[i] == 1);
+            REQUIRE(IsAtomIncluded(result[0], i));
         }
 
-        REQUIRE(result[1].name == "OtherEmu2");
-        REQUIRE(result[1].atom_states.size() == 1);
-        for (size_t i = 0; i < 3; ++i) {
-            REQUIRE(result[1].atom_states[i] == 1);
+        REQUIRE(GetMetaboliteName(result[1].metabolite) == "OtherEmu2");
+        REQUIRE(result[1].total_atoms == 1);
+        for (int i = 0; i < result[1].total_atoms; ++i) {
+            REQUIRE(IsAtomIncluded(result[1], i));
         }
     }
 
@@ -74,10 +74,10 @@ TEST_CASE("ParseOneMeasuredIsotope()", "[OpenFluxParser]") {
     SECTION("with normal emu") {
         std::string line = "VALX:1111";
         Emu emu = ParseOneMeasuredIsotope(line);
-        REQUIRE(emu.name == "VALX");
-        REQUIRE(emu.atom_states.size() == 4);
+        REQUIRE(GetMetaboliteName(emu.metabolite) == "VALX");
+        REQUIRE(emu.total_atoms == 4);
         for (size_t i = 0; i < 4; ++i) {
-            REQUIRE(emu.atom_states[i] == 1);
+            REQUIRE(IsAtomIncluded(emu, i));
         }
     }
 
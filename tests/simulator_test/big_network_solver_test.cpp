@@ -0,0 +1,36 @@
+#include "catch/catch.hpp"
+
+#include <stdexcept>
+#include <vector>
+
+#include "simulator/generator.h"
+#include "simulator/simulator.h"
+#include "simulator_test_utilities.h"
+
+using namespace khnum;
+
+TEST_CASE("Direct solver of the big networks", "[Simulator]") {
+    Problem problem = CreateProblem("../modelTca");
+    problem.simulator_parameters_.max_small_network_size = 0;
+    problem.simulator_parameters_.big_network_solver = BigNetworkSolver::direct;
+    const SimulatorGenerator generator(problem.simulator_parameters_);
+    const Eigen::VectorXd free_fluxes = CreateFreeFluxes(problem);
+
+    SECTION("singular network throws") {
+        // A is zero, so the sparse LU fails
+        std::vector<SimulatorNetworkData> networks = generator.GetNetworkData();
+        REQUIRE(networks.front().size == NetworkSize::big);
+        networks.front().A_operator.coefficients.setZero();
+        networks.front().A_operator.offset.setZero();
+        const SimulatorGenerator singular_generator(problem.simulator_parameters_, networks,
+                                                    generator.GetMidArenaLayout());
+        Simulator simulator = singular_generator.Generate();
+        REQUIRE_THROWS_AS(simulator.CalculateMids(free_fluxes, false), std::runtime_error);
+    }
+
+    SECTION("regular networks are simulated") {
+        Simulator simulator = generator.Generate();
+        REQUIRE_NOTHROW(simulator.CalculateMids(free_fluxes, true));
+        REQUIRE_NOTHROW(simulator.CalculateSSRGradient(free_fluxes, problem.measurements));
+    }
+}
@@ -0,0 +1,46 @@
+#include "catch/catch.hpp"
+
+#include <vector>
+
+#include "simulator/generator_utilites.h"
+#include "simulator/simulator_utilities.h"
+
+using namespace khnum;
+
+TEST_CASE("Products of the other convolution elements", "[Simulator]") {
+    const std::vector<Mid> element_mids = {{0.5, 0.5}, {0.2, 0.3, 0.5}, {0.9, 0.1}, {0.1, 0.2, 0.3, 0.4}};
+    std::vector<double> mids;
+    SimulatorNetworkData network;
+    Convolution convolution;
+    for (const Mid& mid : element_mids) {
+        convolution.elements.push_back({0, static_cast<int>(convolution.elements.size()),
+                                        static_cast<int>(mids.size()), static_cast<int>(mid.size())});
+        mids.insert(mids.end(), mid.begin(), mid.end());
+    }
+
+    for (size_t total_elements = 1; total_elements <= element_mids.size(); ++total_elements) {
+        SECTION(std::to_string(total_elements) + " elements") {
+            convolution.elements.resize(total_elements);
+            network.convolutions = {convolution};
+            generator_utilites::PlaceConvolutionOthers(network);
+
+            std::vector<double> others(network.convolution_others_size, -1.0);
+            ConvolutionBuffers buffers;
+            simulator_utilities::FillConvolutionOthers(network.convolutions, mids.data(), buffers, others.data());
+
+            const Convolution& placed_convolution = network.convolutions[0];
+            for (size_t position = 0; position < total_elements; ++position) {
+                Mid expected_others = {1.0};
+                for (size_t other = 0; other < total_elements; ++other) {
+                    if (other != position) {
+                        expected_others = expected_others * element_mids[other];
+                    }
+                }
+                for (size_t mass_shift = 0; mass_shift < expected_others.size(); ++mass_shift) {
+                    REQUIRE(others[placed_convolution.others_offsets[position] + mass_shift] ==
+                            Approx(expected_others[mass_shift]).epsilon(1e-14));
+                }
+            }
+        }
+    }
+}
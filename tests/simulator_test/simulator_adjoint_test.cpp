@@ -0,0 +1,38 @@
+#include "catch/catch.hpp"
+
+#include <vector>
+
+#include "simulator/generator.h"
+#include "simulator/simulator.h"
+#include "simulator_test_utilities.h"
+
+using namespace khnum;
+
+TEST_CASE("Simulator adjoint gradient", "[Simulator]") {
+    for (const std::string model : {"../modelTiny", "../modelTca", "../modelLast"}) {
+        SECTION("equals the gradient from the forward derivatives for " + model) {
+            Problem problem = CreateProblem(model);
+            SimulatorGenerator generator(problem.simulator_parameters_);
+            Simulator simulator = generator.Generate();
+            const Eigen::VectorXd free_fluxes = CreateFreeFluxes(problem);
+
+            const SimulatorResult result = simulator.CalculateMids(free_fluxes, true);
+            Eigen::VectorXd forward_gradient = Eigen::VectorXd::Zero(free_fluxes.size());
+            for (size_t isotope = 0; isotope < result.simulated_mids.size(); ++isotope) {
+                const Measurement& measurement = problem.measurements[isotope];
+                const Mid& mid = result.simulated_mids[isotope].mid;
+                for (size_t mass_shift = 0; mass_shift < mid.size(); ++mass_shift) {
+                    const double error = measurement.errors[mass_shift];
+                    const double weight = 2.0 * (mid[mass_shift] - measurement.mid[mass_shift]) / (error * error);
+                    for (int flux = 0; flux < free_fluxes.size(); ++flux) {
+                        forward_gradient(flux) += weight * result.diff_results[flux][isotope].mid[mass_shift];
+                    }
+                }
+            }
+
+            const Eigen::VectorXd& adjoint_gradient = simulator.CalculateSSRGradient(free_fluxes, problem.measurements);
+            const double scale = std::max(1.0, forward_gradient.lpNorm<Eigen::Infinity>());
+            REQUIRE((adjoint_gradient - forward_gradient).lpNorm<Eigen::Infinity>() < 1e-8 * scale);
+        }
+    }
+}
@@ -0,0 +1,59 @@
+#include "catch/catch.hpp"
+
+#include "simulator/generator.h"
+#include "simulator/simulator.h"
+#include "simulator_test_utilities.h"
+
+using namespace khnum;
+
+TEST_CASE("Simulator parallel networks", "[Simulator]") {
+    for (const std::string model : {"../modelTca", "../modelLast"}) {
+        SECTION("gives the same result as the sequential one for " + model) {
+            Problem problem = CreateProblem(model);
+            const Eigen::VectorXd free_fluxes = CreateFreeFluxes(problem);
+
+            SimulatorGenerator sequential_generator(problem.simulator_parameters_);
+            Simulator sequential_simulator = sequential_generator.Generate();
+            const SimulatorResult& sequential_result = sequential_simulator.CalculateMids(free_fluxes, true);
+
+            problem.simulator_parameters_.total_threads = 4;
+            SimulatorGenerator parallel_generator(problem.simulator_parameters_);
+            Simulator parallel_simulator = parallel_generator.Generate();
+            for (int call = 0; call < 3; ++call) {
+                const SimulatorResult& parallel_result = parallel_simulator.CalculateMids(free_fluxes, true);
+                REQUIRE(parallel_result.simulated_mids == sequential_result.simulated_mids);
+                REQUIRE(parallel_result.diff_results == sequential_result.diff_results);
+            }
+        }
+    }
+}
+
+TEST_CASE("Simulator parallel jacobian", "[Simulator]") {
+    for (const std::string model : {"../modelTca", "../modelLast"}) {
+        SECTION("gives the same derivatives as the sequential one for " + model) {
+            Problem problem = CreateProblem(model);
+            const Eigen::VectorXd free_fluxes = CreateFreeFluxes(problem);
+            SimulatorGenerator generator(problem.simulator_parameters_);
+
+            Simulator sequential_simulator = generator.Generate();
+            const SimulatorResult& sequential_result = sequential_simulator.CalculateMids(free_fluxes, true);
+
+            Simulator parallel_simulator = generator.Generate();
+            parallel_simulator.SetJacobianThreads(4);
+            const SimulatorResult& parallel_result = parallel_simulator.CalculateMids(free_fluxes, true);
+
+            // the chunks are multiplied and solved separately, so only the rounding may differ
+            REQUIRE(parallel_result.simulated_mids == sequential_result.simulated_mids);
+            for (size_t flux = 0; flux < sequential_result.diff_results.size(); ++flux) {
+                for (size_t isotope = 0; isotope < sequential_result.diff_results[flux].size(); ++isotope) {
+                    const Mid& sequential_mid = sequential_result.diff_results[flux][isotope].mid;
+                    const Mid& parallel_mid = parallel_result.diff_results[flux][isotope].mid;
+                    REQUIRE(parallel_mid.size() == sequential_mid.size());
+                    for (size_t mass_shift = 0; mass_shift < sequential_mid.size(); ++mass_shift) {
+                        REQUIRE(parallel_mid[mass_shift] == Approx(sequential_mid[mass_shift]).epsilon(1e-10).margin(1e-10));
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+
+#include "parser/open_flux_parser/open_flux_parser.h"
+#include "modeller/modeller.h"
+#include "utilities/problem.h"
+
+namespace khnum {
+inline Problem CreateProblem(const std::string& path) {
+    ParserOpenFlux parser(path);
+    parser.Parse();
+
+    Modeller modeller(parser.GetResults());
+    modeller.CalculateInputSubstrateMids();
+    modeller.CreateEmuNetworks();
+    modeller.CreateNullspaceMatrix();
+    modeller.CalculateFluxBounds();
+    modeller.CalculateMeasurementsCount();
+    modeller.CheckModelForErrors();
+    return modeller.GetProblem();
+}
+
+// Middle of the free fluxes bounds
+inline Eigen::VectorXd CreateFreeFluxes(const Problem& problem) {
+    Eigen::VectorXd free_fluxes(problem.nullspace.cols());
+    for (int i = 0; i < free_fluxes.size(); ++i) {
+        free_fluxes(i) = (problem.lower_bounds[i] + problem.upper_bounds[i]) / 2;
+    }
+    return free_fluxes;
+}
+} // namespace khnum
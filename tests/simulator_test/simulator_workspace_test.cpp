@@ -0,0 +1,68 @@
+#include "catch/catch.hpp"
+
+#include <cstdlib>
+#include <vector>
+
+#include "simulator/generator.h"
+#include "simulator/simulator.h"
+#include "simulator_test_utilities.h"
+
+using namespace khnum;
+
+// Counts heap allocations of the whole test binary (std::vector and Eigen both end up in malloc)
+namespace {
+bool count_allocations = false;
+size_t total_allocations = 0;
+}
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* pointer, size_t size);
+
+void* malloc(size_t size) {
+    if (count_allocations) {
+        ++total_allocations;
+    }
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+    if (count_allocations) {
+        ++total_allocations;
+    }
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* pointer, size_t size) {
+    if (count_allocations) {
+        ++total_allocations;
+    }
+    return __libc_realloc(pointer, size);
+}
+}
+
+TEST_CASE("Simulator workspace", "[Simulator]") {
+    for (const std::string model : {"../modelTiny", "../modelTca"}) {
+        SECTION("no allocations in steady state for " + model) {
+            Problem problem = CreateProblem(model);
+            SimulatorGenerator generator(problem.simulator_parameters_);
+            Simulator simulator = generator.Generate();
+            const Eigen::VectorXd free_fluxes = CreateFreeFluxes(problem);
+
+            const SimulatorResult first_result = simulator.CalculateMids(free_fluxes, true);
+
+            total_allocations = 0;
+            count_allocations = true;
+            for (int call = 0; call < 10; ++call) {
+                simulator.CalculateMids(free_fluxes, call % 2 == 0);
+            }
+            count_allocations = false;
+            REQUIRE(total_allocations == 0);
+
+            const SimulatorResult& result = simulator.CalculateMids(free_fluxes, true);
+            REQUIRE(result.simulated_mids == first_result.simulated_mids);
+            REQUIRE(result.diff_results == first_result.diff_results);
+        }
+    }
+}
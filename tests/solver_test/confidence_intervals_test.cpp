@@ -0,0 +1,143 @@
+#include "catch/catch.hpp"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <glpk/glpk.h>
+
+#include "alglib/ap.h"
+#include "simulator/generator.h"
+#include "solver/confidence_intervals.h"
+#include "solver/multistart_solver.h"
+#include "../simulator_test/simulator_test_utilities.h"
+
+using namespace khnum;
+
+TEST_CASE("Confidence intervals", "[Solver]") {
+    Problem problem = CreateProblem("../modelTca");
+    problem.use_analytic_jacobian = true;
+    problem.total_starts = 4;
+    SimulatorGenerator generator(problem.simulator_parameters_);
+    const std::vector<alglib::real_1d_array> solutions = MultistartSolver(problem, generator).Solve();
+
+    ConfidenceIntervalsParameters parameters;
+    const std::vector<FluxConfidenceInterval> intervals =
+        ConfidenceIntervalsCalculator(problem, generator, parameters).Calculate(solutions);
+
+    SECTION("every flux has an interval around the best fit") {
+        REQUIRE(intervals.size() == static_cast<size_t>(problem.nullspace.rows() + problem.nullspace.cols()));
+        for (const FluxConfidenceInterval& interval : intervals) {
+            REQUIRE(interval.lower <= interval.best_value + 1e-9);
+            REQUIRE(interval.upper >= interval.best_value - 1e-9);
+            // fixed fluxes aren't fitted
+            REQUIRE((interval.total_fits > 0 || interval.lower == interval.upper));
+        }
+    }
+
+    SECTION("intervals don't depend on the threads count") {
+        parameters.total_threads = 3;
+        const std::vector<FluxConfidenceInterval> parallel_intervals =
+            ConfidenceIntervalsCalculator(problem, generator, parameters).Calculate(solutions);
+        REQUIRE(parallel_intervals.size() == intervals.size());
+        for (size_t flux = 0; flux < intervals.size(); ++flux) {
+            REQUIRE(parallel_intervals[flux].reaction_id == intervals[flux].reaction_id);
+            REQUIRE(parallel_intervals[flux].lower == intervals[flux].lower);
+            REQUIRE(parallel_intervals[flux].upper == intervals[flux].upper);
+        }
+    }
+
+    SECTION("the glpk problems of the caller survive the calculation on its thread") {
+        glp_prob* linear_problem = glp_create_prob();
+        glp_add_cols(linear_problem, 2);
+        ConfidenceIntervalsCalculator(problem, generator, parameters).Calculate(solutions);
+        REQUIRE(glp_get_num_cols(linear_problem) == 2);
+        glp_delete_prob(linear_problem);
+    }
+
+    auto find_interval = [&intervals](int reaction_id, ProfiledFluxType type) {
+        return std::find_if(intervals.begin(), intervals.end(), [reaction_id, type](const auto& interval) {
+            return interval.reaction_id == reaction_id && interval.type == type;
+        });
+    };
+
+    SECTION("free fluxes interval ends are in their bounds") {
+        const size_t first_free = problem.reactions.size() - problem.nullspace.cols();
+        for (int flux = 0; flux < problem.nullspace.cols(); ++flux) {
+            auto interval = find_interval(problem.reactions[first_free + flux].id, ProfiledFluxType::single);
+            if (interval == intervals.end()) {
+                continue; // a part of a reversible reaction
+            }
+            REQUIRE(interval->lower >= problem.lower_bounds[flux] - 1e-9);
+            REQUIRE(interval->upper <= problem.upper_bounds[flux] + 1e-9);
+        }
+    }
+
+    SECTION("reversible reactions are profiled as the net and the exchange fluxes") {
+        REQUIRE(!problem.reversible_reactions.empty());
+        for (const ReversibleReaction& reaction : problem.reversible_reactions) {
+            const int forward_id = problem.reactions[reaction.forward].id;
+            REQUIRE(find_interval(forward_id, ProfiledFluxType::net) != intervals.end());
+            REQUIRE(find_interval(forward_id, ProfiledFluxType::single) == intervals.end());
+            REQUIRE(find_interval(problem.reactions[reaction.backward].id, ProfiledFluxType::single) == intervals.end());
+
+            auto exchange = find_interval(forward_id, ProfiledFluxType::exchange);
+            REQUIRE(exchange != intervals.end());
+            REQUIRE(exchange->name == problem.reactions[reaction.forward].name);
+            REQUIRE(exchange->lower >= -1e-9);
+        }
+    }
+}
+
+TEST_CASE("Confidence intervals of the exchange flux when the net flux changes its sign", "[Solver]") {
+    Problem problem = CreateProblem("../modelTca");
+    problem.use_analytic_jacobian = true;
+    problem.total_starts = 4;
+    // with the loose measurements the net flux of V10 and V09 takes both signs in its interval
+    for (Measurement& measurement : problem.measurements) {
+        for (double& error : measurement.errors) {
+            error *= 100.0;
+        }
+    }
+    SimulatorGenerator generator(problem.simulator_parameters_);
+    const std::vector<alglib::real_1d_array> solutions = MultistartSolver(problem, generator).Solve();
+
+    ConfidenceIntervalsParameters parameters;
+    parameters.refinement_steps = 10;
+    const std::vector<FluxConfidenceInterval> single_intervals =
+        ConfidenceIntervalsCalculator(problem, generator, parameters).Calculate(solutions);
+
+    auto find_reaction = [&problem](const std::string& name) {
+        return static_cast<size_t>(std::find_if(problem.reactions.begin(), problem.reactions.end(),
+                                                [&name](const ReactionsName& reaction) { return reaction.name == name; }) -
+                                   problem.reactions.begin());
+    };
+    const size_t forward = find_reaction("V10");
+    const size_t backward = find_reaction("V09");
+    REQUIRE(forward < problem.reactions.size());
+    REQUIRE(backward < problem.reactions.size());
+    problem.reversible_reactions = {{forward, backward}};
+    const std::vector<FluxConfidenceInterval> intervals =
+        ConfidenceIntervalsCalculator(problem, generator, parameters).Calculate(solutions);
+
+    auto find_interval = [](const std::vector<FluxConfidenceInterval>& intervals, int reaction_id,
+                            ProfiledFluxType type) {
+        auto interval = std::find_if(intervals.begin(), intervals.end(), [reaction_id, type](const auto& interval) {
+            return interval.reaction_id == reaction_id && interval.type == type;
+        });
+        REQUIRE(interval != intervals.end());
+        return *interval;
+    };
+    const int forward_id = problem.reactions[forward].id;
+    const FluxConfidenceInterval net = find_interval(intervals, forward_id, ProfiledFluxType::net);
+    const FluxConfidenceInterval exchange = find_interval(intervals, forward_id, ProfiledFluxType::exchange);
+    const FluxConfidenceInterval forward_interval =
+        find_interval(single_intervals, forward_id, ProfiledFluxType::single);
+    const FluxConfidenceInterval backward_interval =
+        find_interval(single_intervals, problem.reactions[backward].id, ProfiledFluxType::single);
+
+    REQUIRE(net.lower < 0.0);
+    REQUIRE(net.upper > 0.0);
+    // min(forward, backward) reaches the lowest end of both directions and doesn't exceed the upper ones
+    REQUIRE(exchange.lower == Approx(std::min(forward_interval.lower, backward_interval.lower)).epsilon(0.01));
+    REQUIRE(exchange.upper <= std::min(forward_interval.upper, backward_interval.upper) * 1.01);
+}
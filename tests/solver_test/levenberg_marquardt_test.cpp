@@ -0,0 +1,141 @@
+#include "catch/catch.hpp"
+
+#include <vector>
+
+#include "alglib/ap.h"
+#include "simulator/generator.h"
+#include "solver/levenberg_marquardt.h"
+#include "solver/solver.h"
+#include "../simulator_test/simulator_test_utilities.h"
+
+using namespace khnum;
+
+namespace {
+// r = (10 * (y - x^2), 1 - x), the minimum is (1, 1)
+void Rosenbrock(const Eigen::VectorXd& x, Eigen::VectorXd& residuals, Matrix* jacobian) {
+    residuals << 10.0 * (x[1] - x[0] * x[0]), 1.0 - x[0];
+    if (jacobian) {
+        *jacobian << -20.0 * x[0], 10.0,
+                     -1.0, 0.0;
+    }
+}
+
+// r = x - (2, 2)
+void Distance(const Eigen::VectorXd& x, Eigen::VectorXd& residuals, Matrix*) {
+    residuals = x - Eigen::Vector2d(2.0, 2.0);
+}
+
+const Eigen::VectorXd no_inequality_bounds = Eigen::VectorXd::Zero(0);
+}
+
+TEST_CASE("Levenberg-Marquardt", "[Solver]") {
+    SECTION("unconstrained minimum") {
+        LevenbergMarquardtParameters parameters;
+        parameters.step_tolerance = 1e-10;
+        LevenbergMarquardt solver(2, Eigen::Vector2d(-10.0, -10.0), Eigen::Vector2d(10.0, 10.0),
+                                  Matrix::Zero(0, 2), no_inequality_bounds, parameters);
+        const Eigen::VectorXd solution = solver.Minimize(Rosenbrock, true, Eigen::Vector2d(-1.2, 1.0));
+        REQUIRE(solution[0] == Approx(1.0).margin(1e-6));
+        REQUIRE(solution[1] == Approx(1.0).margin(1e-6));
+        REQUIRE(solver.GetReport().final_ssr < 1e-12);
+        REQUIRE(solver.GetReport().final_ssr < solver.GetReport().initial_ssr);
+        REQUIRE(solver.GetReport().iterations > 0);
+    }
+
+    SECTION("minimum on the bound") {
+        LevenbergMarquardt solver(2, Eigen::Vector2d(-10.0, -10.0), Eigen::Vector2d(0.5, 10.0),
+                                  Matrix::Zero(0, 2), no_inequality_bounds);
+        const Eigen::VectorXd solution = solver.Minimize(Rosenbrock, true, Eigen::Vector2d(-1.2, 1.0));
+        REQUIRE(solution[0] == 0.5);
+        REQUIRE(solution[1] == Approx(0.25).margin(1e-6));
+    }
+
+    SECTION("minimum on the inequality with the differences jacobian") {
+        // x + y <= 1, the projection of (2, 2) is (0.5, 0.5)
+        Matrix inequalities(1, 2);
+        inequalities << 1.0, 1.0;
+        LevenbergMarquardt solver(2, Eigen::Vector2d(0.0, 0.0), Eigen::Vector2d(10.0, 10.0),
+                                  inequalities, Eigen::VectorXd::Constant(1, 1.0));
+        for (const Eigen::Vector2d start : {Eigen::Vector2d(0.1, 0.2), Eigen::Vector2d(3.0, 3.0)}) {
+            const Eigen::VectorXd solution = solver.Minimize(Distance, false, start);
+            REQUIRE(solution[0] == Approx(0.5).margin(1e-6));
+            REQUIRE(solution[1] == Approx(0.5).margin(1e-6));
+            REQUIRE(solution[0] + solution[1] <= 1.0 + 1e-9);
+            REQUIRE(solver.GetReport().status != LevenbergMarquardtStatus::max_iterations);
+            REQUIRE(solver.GetReport().status != LevenbergMarquardtStatus::no_progress);
+        }
+    }
+
+    SECTION("minimum on the equality") {
+        // x - y = 1, the projection of (2, 2) is (2.5, 1.5)
+        Matrix equalities(1, 2);
+        equalities << 1.0, -1.0;
+        LevenbergMarquardt solver(2, Eigen::Vector2d(0.0, 0.0), Eigen::Vector2d(10.0, 10.0),
+                                  Matrix::Zero(0, 2), no_inequality_bounds);
+        solver.SetEqualities(equalities, Eigen::VectorXd::Constant(1, 1.0));
+        const Eigen::VectorXd solution = solver.Minimize(Distance, false, Eigen::Vector2d(2.0, 2.0));
+        REQUIRE(solution[0] == Approx(2.5).margin(1e-6));
+        REQUIRE(solution[1] == Approx(1.5).margin(1e-6));
+        REQUIRE(solution[0] - solution[1] == Approx(1.0).margin(1e-9));
+    }
+
+    SECTION("zero equalities") {
+        // 0 = 0 holds everywhere, 0 = 1 nowhere
+        LevenbergMarquardt solver(2, Eigen::Vector2d(0.0, 0.0), Eigen::Vector2d(10.0, 10.0),
+                                  Matrix::Zero(0, 2), no_inequality_bounds);
+        solver.SetEqualities(Matrix::Zero(1, 2), Eigen::VectorXd::Zero(1));
+        const Eigen::VectorXd solution = solver.Minimize(Distance, false, Eigen::Vector2d(1.0, 1.0));
+        REQUIRE(solution[0] == Approx(2.0).margin(1e-6));
+        REQUIRE(solution[1] == Approx(2.0).margin(1e-6));
+
+        REQUIRE_THROWS_AS(solver.SetEqualities(Matrix::Zero(1, 2), Eigen::VectorXd::Constant(1, 1.0)),
+                          std::runtime_error);
+    }
+
+    SECTION("model fit is feasible and matches alglib") {
+        Problem problem = CreateProblem("../modelTca");
+        problem.use_analytic_jacobian = true;
+        const std::vector<Eigen::VectorXd> start_points = GenerateStartPoints(
+            problem.nullspace, problem.lower_bounds, problem.upper_bounds, 4,
+            StartPointsMethod::latin_hypercube, 0);
+        SimulatorGenerator generator(problem.simulator_parameters_);
+
+        problem.least_squares_solver = LeastSquaresSolver::alglib;
+        Solver alglib_solver(problem, generator);
+        problem.least_squares_solver = LeastSquaresSolver::native;
+        Solver native_solver(problem, generator);
+
+        Simulator simulator = generator.Generate();
+        auto get_ssr = [&](const alglib::real_1d_array& free_fluxes) {
+            Eigen::VectorXd fluxes(free_fluxes.length());
+            for (int i = 0; i < fluxes.size(); ++i) {
+                fluxes[i] = free_fluxes[i];
+            }
+            const SimulatorResult& result = simulator.CalculateMids(fluxes, false);
+            double ssr = 0.0;
+            for (size_t isotope = 0; isotope < result.simulated_mids.size(); ++isotope) {
+                const Measurement& measurement = problem.measurements[isotope];
+                for (size_t mass_shift = 0; mass_shift < measurement.mid.size(); ++mass_shift) {
+                    const double residual = (result.simulated_mids[isotope].mid[mass_shift] -
+                                             measurement.mid[mass_shift]) / measurement.errors[mass_shift];
+                    ssr += residual * residual;
+                }
+            }
+            REQUIRE((problem.nullspace * fluxes).maxCoeff() <= 1e-8);
+            return ssr;
+        };
+
+        double best_alglib_ssr = std::numeric_limits<double>::infinity();
+        double best_native_ssr = std::numeric_limits<double>::infinity();
+        for (const Eigen::VectorXd& start_point : start_points) {
+            best_alglib_ssr = std::min(best_alglib_ssr, get_ssr(alglib_solver.SolveFromPoint(start_point)));
+            const alglib::real_1d_array native_solution = native_solver.SolveFromPoint(start_point);
+            for (int flux = 0; flux < native_solution.length(); ++flux) {
+                REQUIRE(native_solution[flux] >= problem.lower_bounds[flux]);
+                REQUIRE(native_solution[flux] <= problem.upper_bounds[flux]);
+            }
+            best_native_ssr = std::min(best_native_ssr, get_ssr(native_solution));
+        }
+        REQUIRE(best_native_ssr <= best_alglib_ssr * (1.0 + 1e-3));
+    }
+}
@@ -0,0 +1,32 @@
+#include "catch/catch.hpp"
+
+#include <vector>
+
+#include "alglib/ap.h"
+#include "simulator/generator.h"
+#include "solver/multistart_solver.h"
+#include "../simulator_test/simulator_test_utilities.h"
+
+using namespace khnum;
+
+TEST_CASE("Multistart solver", "[Solver]") {
+    SECTION("solutions don't depend on the threads count") {
+        Problem problem = CreateProblem("../modelTca");
+        problem.total_starts = 4;
+        problem.starts_seed = 7;
+        SimulatorGenerator generator(problem.simulator_parameters_);
+
+        problem.multistart_threads = 1;
+        const std::vector<alglib::real_1d_array> sequential_solutions = MultistartSolver(problem, generator).Solve();
+        problem.multistart_threads = 3;
+        const std::vector<alglib::real_1d_array> parallel_solutions = MultistartSolver(problem, generator).Solve();
+
+        REQUIRE(parallel_solutions.size() == sequential_solutions.size());
+        for (size_t start = 0; start < sequential_solutions.size(); ++start) {
+            REQUIRE(parallel_solutions[start].length() == sequential_solutions[start].length());
+            for (int flux = 0; flux < sequential_solutions[start].length(); ++flux) {
+                REQUIRE(parallel_solutions[start][flux] == sequential_solutions[start][flux]);
+            }
+        }
+    }
+}
@@ -0,0 +1,87 @@
+#include "catch/catch.hpp"
+
+#include <random>
+#include <vector>
+
+#include "solver/start_points.h"
+#include "../simulator_test/simulator_test_utilities.h"
+
+using namespace khnum;
+
+namespace {
+const double tolerance = 1e-8;
+
+// Inside the bounds and the dependent fluxes are nonnegative
+bool IsFeasible(const Eigen::VectorXd& point, const Matrix& nullspace,
+                const std::vector<double>& lower_bounds, const std::vector<double>& upper_bounds) {
+    for (int i = 0; i < point.size(); ++i) {
+        if (point[i] < lower_bounds[i] - tolerance || point[i] > upper_bounds[i] + tolerance) {
+            return false;
+        }
+    }
+    return nullspace.rows() == 0 || (nullspace * point).maxCoeff() <= tolerance;
+}
+}
+
+TEST_CASE("Start points", "[Solver]") {
+    SECTION("uniform points are the old random points") {
+        const Matrix nullspace = Matrix::Zero(1, 2);
+        const std::vector<double> lower_bounds = {0.0, 1.0};
+        const std::vector<double> upper_bounds = {2.0, 5.0};
+        const std::vector<Eigen::VectorXd> points =
+            GenerateStartPoints(nullspace, lower_bounds, upper_bounds, 3, StartPointsMethod::uniform, 5);
+
+        REQUIRE(points.size() == 3);
+        for (size_t point = 0; point < points.size(); ++point) {
+            std::mt19937 random_source(5 + point);
+            std::uniform_real_distribution<> get_random_point(0.0, 1.0);
+            for (size_t i = 0; i < lower_bounds.size(); ++i) {
+                const double flux = lower_bounds[i] + get_random_point(random_source) * (upper_bounds[i] - lower_bounds[i]);
+                REQUIRE(points[point][i] == flux);
+            }
+        }
+    }
+
+    SECTION("points of a triangle are inside and spread") {
+        // v1 + v2 - 1 <= 0 in the unit square, the third flux is fixed at 0 and the fourth one at -1
+        Matrix nullspace(1, 4);
+        nullspace << 1.0, 1.0, 0.0, 1.0;
+        const std::vector<double> lower = {0.0, 0.0, 0.0, -1.0};
+        const std::vector<double> upper = {1.0, 1.0, 0.0, -1.0};
+
+        for (StartPointsMethod method : {StartPointsMethod::latin_hypercube, StartPointsMethod::hit_and_run}) {
+            const std::vector<Eigen::VectorXd> points = GenerateStartPoints(nullspace, lower, upper, 50, method, 1);
+            REQUIRE(points.size() == 50);
+            Eigen::VectorXd mean = Eigen::VectorXd::Zero(4);
+            for (const Eigen::VectorXd& point : points) {
+                REQUIRE(IsFeasible(point, nullspace, lower, upper));
+                REQUIRE(point[2] == 0.0);
+                REQUIRE(point[3] == -1.0);
+                mean += point / points.size();
+            }
+            // the centroid of the triangle is (1/3, 1/3)
+            REQUIRE(mean[0] > 0.2);
+            REQUIRE(mean[0] < 0.5);
+            REQUIRE(mean[1] > 0.2);
+            REQUIRE(mean[1] < 0.5);
+        }
+    }
+
+    SECTION("points of a model are feasible and reproducible") {
+        const Problem problem = CreateProblem("../modelTca");
+        for (StartPointsMethod method : {StartPointsMethod::latin_hypercube, StartPointsMethod::hit_and_run}) {
+            const std::vector<Eigen::VectorXd> points = GenerateStartPoints(
+                problem.nullspace, problem.lower_bounds, problem.upper_bounds, 20, method, 3);
+            REQUIRE(points.size() == 20);
+            for (const Eigen::VectorXd& point : points) {
+                REQUIRE(IsFeasible(point, problem.nullspace, problem.lower_bounds, problem.upper_bounds));
+            }
+
+            const std::vector<Eigen::VectorXd> same_points = GenerateStartPoints(
+                problem.nullspace, problem.lower_bounds, problem.upper_bounds, 20, method, 3);
+            for (size_t point = 0; point < points.size(); ++point) {
+                REQUIRE(points[point] == same_points[point]);
+            }
+        }
+    }
+}
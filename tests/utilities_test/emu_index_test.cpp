@@ -0,0 +1,39 @@
+#include "catch/catch.hpp"
+
+#include <vector>
+
+#include "utilities/emu_index.h"
+
+using namespace khnum;
+
+TEST_CASE("Emu index", "[EmuIndex]") {
+    EmuIndex<int> index;
+    index.Insert(CreateEmu("Glc", {1, 0, 1}), 0);
+    index.Insert(CreateEmu("Pyr", {1, 0, 1}), 1);
+    index.Insert(CreateEmu("Glc", {0, 1, 1}), 2);
+
+    SECTION("finds the inserted emus") {
+        REQUIRE(index.Size() == 3);
+        REQUIRE(*index.Find(CreateEmu("Glc", {1, 0, 1})) == 0);
+        REQUIRE(*index.Find(CreateEmu("Pyr", {1, 0, 1})) == 1);
+        REQUIRE(*index.Find(CreateEmu("Glc", {0, 1, 1})) == 2);
+        REQUIRE_FALSE(index.Contains(CreateEmu("Glc", {1, 1, 1})));
+        REQUIRE_FALSE(index.Contains(CreateEmu("Cit", {1, 0, 1})));
+    }
+
+    SECTION("keeps the old value") {
+        REQUIRE(index.Insert(CreateEmu("Glc", {1, 0, 1}), 5) == 0);
+        REQUIRE(index.Size() == 3);
+    }
+
+    SECTION("distinguishes atoms beyond the first word of the mask") {
+        AtomStates first(200, 0);
+        AtomStates second(200, 0);
+        first[70] = 1;
+        second[190] = 1;
+        index.Insert(CreateEmu("Big", first), 3);
+        index.Insert(CreateEmu("Big", second), 4);
+        REQUIRE(*index.Find(CreateEmu("Big", first)) == 3);
+        REQUIRE(*index.Find(CreateEmu("Big", second)) == 4);
+    }
+}
@@ -0,0 +1,43 @@
+#include "catch/catch.hpp"
+
+#include <stdexcept>
+
+#include "utilities/emu.h"
+
+using namespace khnum;
+
+TEST_CASE("Emu", "[Emu]") {
+    SECTION("keeps the atoms and the name") {
+        AtomStates atom_states(150, 0);
+        atom_states[0] = 1;
+        atom_states[63] = 1;
+        atom_states[64] = 1;
+        atom_states[149] = 1;
+        const Emu emu = CreateEmu("Big", atom_states);
+        REQUIRE(emu.total_atoms == 150);
+        REQUIRE(GetEmuSize(emu) == 4);
+        REQUIRE(GetAtomStates(emu) == atom_states);
+        REQUIRE(GetMetaboliteName(emu.metabolite) == "Big");
+        REQUIRE(GetEmuName(CreateEmu("Pyr", {1, 0, 1})) == "Pyr:101");
+    }
+
+    SECTION("interns the metabolites") {
+        REQUIRE(CreateEmu("Glc", {1, 0}).metabolite == CreateEmu("Glc", {0, 1}).metabolite);
+        REQUIRE(CreateEmu("Glc", {1, 0}).metabolite != CreateEmu("Pyr", {1, 0}).metabolite);
+        REQUIRE(GetMetaboliteId("Glc") == CreateEmu("Glc", {1, 0}).metabolite);
+    }
+
+    SECTION("includes atoms") {
+        Emu emu = CreateEmu(GetMetaboliteId("Cit"), 6);
+        REQUIRE(GetEmuSize(emu) == 0);
+        IncludeAtom(emu, 2);
+        IncludeAtom(emu, 5);
+        REQUIRE(emu == CreateEmu("Cit", {0, 0, 1, 0, 0, 1}));
+        REQUIRE_FALSE(IsAtomIncluded(emu, 0));
+        REQUIRE(IsAtomIncluded(emu, 5));
+    }
+
+    SECTION("throws for too big metabolites") {
+        REQUIRE_THROWS_AS(CreateEmu("Huge", AtomStates(max_metabolite_atoms + 1, 1)), std::runtime_error);
+    }
+}
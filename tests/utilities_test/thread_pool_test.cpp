@@ -0,0 +1,109 @@
+#include "catch/catch.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "utilities/thread_pool.h"
+
+using namespace khnum;
+
+TEST_CASE("Thread pool", "[ThreadPool]") {
+    for (size_t total_threads : {1, 2, 4}) {
+        ThreadPool thread_pool(total_threads);
+
+        SECTION("runs tasks submitted by tasks, " + std::to_string(total_threads) + " threads") {
+            std::atomic<int> total_runs{0};
+            for (int task = 0; task < 100; ++task) {
+                thread_pool.Submit([&thread_pool, &total_runs] {
+                    ++total_runs;
+                    thread_pool.Submit([&total_runs] { ++total_runs; });
+                });
+            }
+            thread_pool.Wait();
+            REQUIRE(total_runs == 200);
+        }
+
+        SECTION("waits for the parents of the finished children, " + std::to_string(total_threads) + " threads") {
+            for (int repeat = 0; repeat < 100; ++repeat) {
+                const int total_parents = 20;
+                std::vector<std::atomic<bool>> finished_parents(total_parents);
+                std::atomic<int> total_children{0};
+                for (int parent = 0; parent < total_parents; ++parent) {
+                    finished_parents[parent] = false;
+                    thread_pool.Submit([&thread_pool, &finished_parents, &total_children, parent] {
+                        thread_pool.Submit([&total_children] { ++total_children; });
+                        // the parent keeps working after its child may be stolen and finished
+                        std::this_thread::yield();
+                        finished_parents[parent] = true;
+                    });
+                }
+                // Wait() runs concurrently with the workers executing the parents
+                thread_pool.Wait();
+                REQUIRE(total_children == total_parents);
+                for (int parent = 0; parent < total_parents; ++parent) {
+                    REQUIRE(finished_parents[parent]);
+                }
+            }
+        }
+
+        SECTION("rethrows exceptions of tasks, " + std::to_string(total_threads) + " threads") {
+            std::atomic<int> total_runs{0};
+            thread_pool.Submit([] { throw std::runtime_error("task failed"); });
+            for (int task = 0; task < 10; ++task) {
+                thread_pool.Submit([&total_runs] { ++total_runs; });
+            }
+            REQUIRE_THROWS_AS(thread_pool.Wait(), std::runtime_error);
+            REQUIRE(total_runs == 10);
+
+            thread_pool.Submit([&total_runs] { ++total_runs; });
+            thread_pool.Wait();
+            REQUIRE(total_runs == 11);
+        }
+    }
+}
+
+TEST_CASE("Task groups of the thread pool", "[ThreadPool]") {
+    for (size_t total_threads : {1, 2, 4}) {
+        ThreadPool thread_pool(total_threads);
+
+        SECTION("waits for the groups of the tasks, " + std::to_string(total_threads) + " threads") {
+            std::atomic<int> total_runs{0};
+            ThreadPool::TaskGroup parents(thread_pool);
+            for (int parent = 0; parent < 20; ++parent) {
+                parents.Submit([&thread_pool, &total_runs] {
+                    ThreadPool::TaskGroup children(thread_pool);
+                    for (int child = 0; child < 10; ++child) {
+                        children.Submit([&total_runs] { ++total_runs; });
+                    }
+                    children.Wait();
+                    ++total_runs;
+                });
+            }
+            parents.Wait();
+            REQUIRE(total_runs == 220);
+        }
+    }
+
+    SECTION("the waiting thread sleeps while a worker runs the task") {
+        ThreadPool thread_pool(2);
+        ThreadPool::TaskGroup task_group(thread_pool);
+        std::atomic<bool> started{false};
+        task_group.Submit([&started] {
+            started = true;
+            std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        });
+        while (!started) {
+            std::this_thread::yield();
+        }
+
+        // the worker sleeps, so the process only spends the time of the waiting thread
+        const std::clock_t start = std::clock();
+        task_group.Wait();
+        const double seconds = static_cast<double>(std::clock() - start) / CLOCKS_PER_SEC;
+        REQUIRE(seconds < 0.1);
+    }
+}